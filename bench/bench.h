@@ -0,0 +1,48 @@
+#ifndef WCRON_BENCH_H
+#define WCRON_BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Monotonic clock in nanoseconds
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Keeps the optimizer from discarding a computed value
+static inline void bench_consume(uint64_t value) {
+    static volatile uint64_t sink;
+    sink += value;
+}
+
+/**
+ * Append one result to the JSON Lines file named by $WCRON_BENCH_JSON, one
+ * object per line, tagged with $WCRON_BENCH_REV when set. Results of two
+ * releases can then be joined on (bench, case, n, metric). No-op when unset.
+ */
+static inline void bench_report(const char *bench, const char *name, long long n, const char *metric, double value) {
+    const char *path = getenv("WCRON_BENCH_JSON");
+    if (!path || !*path) {
+        return;
+    }
+
+    FILE *fp = fopen(path, "a");
+    if (!fp) {
+        return;
+    }
+
+    const char *rev = getenv("WCRON_BENCH_REV");
+    fprintf(fp, "{\"bench\":\"%s\",\"case\":\"%s\",\"n\":%lld,\"metric\":\"%s\",\"value\":%.3f", bench, name, n,
+            metric, value);
+    if (rev && *rev) {
+        fprintf(fp, ",\"rev\":\"%s\"", rev);
+    }
+    fprintf(fp, ",\"time\":%lld}\n", (long long)time(NULL));
+    fclose(fp);
+}
+
+#endif // WCRON_BENCH_H
@@ -0,0 +1,165 @@
+/**
+ * Logger stress benchmark: many threads calling log_msg() at once, against the
+ * previous open/append/close per message. Reports the producer-side cost per
+ * call (what a job thread pays) and checks that every message either reached
+ * the file or was counted as dropped.
+ */
+#include "bench.h"
+#include "wcron/log.h"
+#include "wcron/platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_FILE "build/bench_log.log"
+#define MESSAGES_PER_THREAD 20000
+#define LEGACY_MESSAGES_PER_THREAD 500
+#define MAX_THREADS 16
+
+typedef struct {
+    int id;
+    int messages;
+    int legacy;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} producer;
+
+// log_msg() as it was: resolve, open, append and close for every message
+static void legacy_log_msg(const char *msg) {
+    FILE *f = fopen(LOG_FILE, "a");
+    if (!f)
+        return;
+
+    time_t t = time(NULL);
+    struct tm tm;
+    localtime_r(&t, &tm);
+    fprintf(f, "[%04d-%02d-%02d %02d:%02d:%02d] %s\n", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
+            tm.tm_min, tm.tm_sec, msg);
+    fclose(f);
+}
+
+static void producer_thread(void *param) {
+    producer *p = (producer *)param;
+    char msg[128];
+
+    for (int i = 0; i < p->messages; i++) {
+        snprintf(msg, sizeof(msg), "Job #%d completed in %d ms", p->id, i);
+
+        uint64_t t0 = bench_now_ns();
+        if (p->legacy) {
+            legacy_log_msg(msg);
+        } else {
+            log_msg(msg);
+        }
+        uint64_t ns = bench_now_ns() - t0;
+
+        p->total_ns += ns;
+        if (ns > p->max_ns) {
+            p->max_ns = ns;
+        }
+    }
+}
+
+// Lines written and messages reported as dropped
+static void count_log(unsigned long *lines, unsigned long *dropped) {
+    *lines = 0;
+    *dropped = 0;
+
+    FILE *f = fopen(LOG_FILE, "r");
+    if (!f) {
+        return;
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long n;
+        const char *marker = strstr(line, "dropped ");
+        if (marker && sscanf(marker, "dropped %lu", &n) == 1) {
+            *dropped += n;
+        } else {
+            (*lines)++;
+        }
+    }
+    fclose(f);
+}
+
+static int run(int threads, int legacy, const log_config *config) {
+    producer producers[MAX_THREADS];
+    wcron_thread handles[MAX_THREADS];
+    int per_thread = legacy ? LEGACY_MESSAGES_PER_THREAD : MESSAGES_PER_THREAD;
+
+    remove(LOG_FILE);
+    if (!legacy && log_start(config) != 0) {
+        fprintf(stderr, "failed to start log writer\n");
+        return 1;
+    }
+
+    uint64_t t0 = bench_now_ns();
+    for (int i = 0; i < threads; i++) {
+        memset(&producers[i], 0, sizeof(producer));
+        producers[i].id = i;
+        producers[i].messages = per_thread;
+        producers[i].legacy = legacy;
+        wcron_thread_start(&handles[i], producer_thread, &producers[i]);
+    }
+    for (int i = 0; i < threads; i++) {
+        wcron_thread_join(handles[i]);
+    }
+    uint64_t produce_ns = bench_now_ns() - t0;
+
+    if (!legacy) {
+        log_stop();
+    }
+    uint64_t drain_ns = bench_now_ns() - t0;
+
+    uint64_t total_ns = 0, max_ns = 0;
+    for (int i = 0; i < threads; i++) {
+        total_ns += producers[i].total_ns;
+        if (producers[i].max_ns > max_ns) {
+            max_ns = producers[i].max_ns;
+        }
+    }
+
+    unsigned long sent = (unsigned long)threads * (unsigned long)per_thread;
+    unsigned long lines, dropped;
+    count_log(&lines, &dropped);
+    if (lines + dropped != sent) {
+        fprintf(stderr, "lost messages: sent=%lu written=%lu dropped=%lu\n", sent, lines, dropped);
+        return 1;
+    }
+
+    printf("%-8s %8d %10lu %12.0f %12.1f %14.0f %10lu\n", legacy ? "legacy" : "ring", threads, sent,
+           (double)total_ns / sent, (double)max_ns / 1000.0, sent / ((double)drain_ns / 1e9), dropped);
+    (void)produce_ns;
+
+    char label[32];
+    snprintf(label, sizeof(label), "%s_%d_threads", legacy ? "legacy" : "ring", threads);
+    bench_report("log", label, (long long)sent, "ns_per_call", (double)total_ns / sent);
+    bench_report("log", label, (long long)sent, "max_us", (double)max_ns / 1000.0);
+    bench_report("log", label, (long long)sent, "dropped", (double)dropped);
+    return 0;
+}
+
+int main(void) {
+    static const int THREADS[] = {1, 4, 16};
+
+    log_config config;
+    log_config_defaults(&config);
+    if (log_set_path(LOG_FILE) != 0) {
+        return 1;
+    }
+
+    printf("flush interval %u ms, ring %u records, fsync %s\n", config.flush_interval_ms, config.ring_records,
+           config.fsync_policy == LOG_FSYNC_FLUSH ? "flush" : "never");
+    printf("%-8s %8s %10s %12s %12s %14s %10s\n", "logger", "threads", "messages", "ns/call", "max us/call",
+           "msgs/s", "dropped");
+
+    for (size_t i = 0; i < sizeof(THREADS) / sizeof(THREADS[0]); i++) {
+        if (run(THREADS[i], 1, &config) != 0 || run(THREADS[i], 0, &config) != 0) {
+            return 1;
+        }
+    }
+
+    remove(LOG_FILE);
+    return 0;
+}
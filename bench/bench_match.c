@@ -0,0 +1,231 @@
+/**
+ * Micro-benchmark for time_matches(): bit-packed cron_job against the previous
+ * int-array layout, over the same generated crontab and the same probe minutes.
+ * Then the per-kind matchers and next_fire_time() routines against the generic
+ * ones, i.e. the same jobs with their kind reset to CRON_KIND_GENERIC.
+ */
+#include "bench.h"
+#include "crontab_gen.h"
+#include "wcron/parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JOB_COUNT 4096
+#define PROBE_COUNT 2048
+#define NEXT_PROBES 64
+
+// Layout and matcher as they were before the schedule was bit-packed
+typedef struct {
+    int minutes[60];
+    int hours[24];
+    int days[31];
+    int months[12];
+    int daysofweek[7];
+    char command[512];
+
+    volatile int is_running;
+    time_t last_run;
+} legacy_job;
+
+static int legacy_time_matches(const legacy_job *job, const struct tm *tm) {
+    if (!job->minutes[tm->tm_min] || !job->hours[tm->tm_hour] || !job->months[tm->tm_mon]) {
+        return 0;
+    }
+
+    int day_match = job->days[tm->tm_mday - 1];
+    int weekday_match = job->daysofweek[tm->tm_wday];
+
+    int day_is_wildcard = 1;
+    for (int i = 0; i < 31; i++) {
+        if (!job->days[i]) {
+            day_is_wildcard = 0;
+            break;
+        }
+    }
+
+    int weekday_is_wildcard = 1;
+    for (int i = 0; i < 7; i++) {
+        if (!job->daysofweek[i]) {
+            weekday_is_wildcard = 0;
+            break;
+        }
+    }
+
+    if (day_is_wildcard && weekday_is_wildcard) {
+        return 1;
+    } else if (day_is_wildcard) {
+        return weekday_match;
+    } else if (weekday_is_wildcard) {
+        return day_match;
+    }
+    return day_match || weekday_match;
+}
+
+static void to_legacy(const cron_job *job, legacy_job *out) {
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < 60; i++)
+        out->minutes[i] = (int)(job->minutes >> i & 1);
+    for (int i = 0; i < 24; i++)
+        out->hours[i] = (int)(job->hours >> i & 1);
+    for (int i = 0; i < 31; i++)
+        out->days[i] = (int)(job->days >> (i + 1) & 1);
+    for (int i = 0; i < 12; i++)
+        out->months[i] = (int)(job->months >> i & 1);
+    for (int i = 0; i < 7; i++)
+        out->daysofweek[i] = (int)(job->daysofweek >> i & 1);
+}
+
+void log_msg(const char *msg) {
+    fprintf(stderr, "parse: %s\n", msg);
+}
+
+static uint64_t match_all(const cron_job *jobs, const struct tm *probes, uint64_t *hits) {
+    uint64_t start = bench_now_ns();
+    for (int p = 0; p < PROBE_COUNT; p++) {
+        for (int i = 0; i < JOB_COUNT; i++) {
+            *hits += (uint64_t)time_matches(&jobs[i], &probes[p]);
+        }
+    }
+    return bench_now_ns() - start;
+}
+
+// Chains of next_fire_time() calls from each start, as the run queue makes them
+static uint64_t next_all(const cron_job *jobs, const time_t *starts, uint64_t *sum) {
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < JOB_COUNT; i++) {
+        time_t t = starts[i % PROBE_COUNT];
+        for (int p = 0; p < NEXT_PROBES && t != CRON_NEVER; p++) {
+            t = next_fire_time(&jobs[i], t);
+            *sum += (uint64_t)t;
+        }
+    }
+    return bench_now_ns() - start;
+}
+
+// Leap days around century years: 2000 and 2400 have one, 2100 has not
+static int check_leap_days(void) {
+    static const int cases[][2] = {{1999, 2000}, {2096, 2104}, {2396, 2400}};
+    cron_job job;
+    const char *line = "0 0 29 2 * leap";
+    if (parse_cron_span(line, strlen(line), &job, NULL) != 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        struct tm from = {0};
+        from.tm_year = cases[i][0] - 1900;
+        from.tm_mon = 2;
+        from.tm_mday = 1;
+        from.tm_isdst = -1;
+        time_t t = next_fire_time(&job, mktime(&from));
+        struct tm tm;
+        localtime_r(&t, &tm);
+        if (tm.tm_year != cases[i][1] - 1900 || tm.tm_mon != 1 || tm.tm_mday != 29) {
+            fprintf(stderr, "mismatch: 0 0 29 2 * after %d-03-01 fires %04d-%02d-%02d, expected %d-02-29\n",
+                    cases[i][0], tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, cases[i][1]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void) {
+    cron_job *jobs = calloc(JOB_COUNT, sizeof(cron_job));
+    cron_job *generic = calloc(JOB_COUNT, sizeof(cron_job));
+    legacy_job *legacy = calloc(JOB_COUNT, sizeof(legacy_job));
+    struct tm *probes = calloc(PROBE_COUNT, sizeof(struct tm));
+    time_t *starts = calloc(PROBE_COUNT, sizeof(time_t));
+    if (!jobs || !generic || !legacy || !probes || !starts) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    crontab_gen gen;
+    crontab_gen_init(&gen, 42);
+    for (int i = 0; i < JOB_COUNT; i++) {
+        // Comments and blank lines are not jobs; draw again
+        char line[256];
+        do {
+            crontab_gen_line(&gen, line, sizeof(line));
+        } while (parse_cron_span(line, strlen(line), &jobs[i], NULL) != 0);
+        to_legacy(&jobs[i], &legacy[i]);
+        generic[i] = jobs[i];
+        generic[i].kind = CRON_KIND_GENERIC;
+    }
+
+    // Probe minutes spread over a year so every field varies
+    time_t base = 1767225600; // 2026-01-01 00:00 UTC
+    srand(42);
+    for (int i = 0; i < PROBE_COUNT; i++) {
+        time_t t = base + (time_t)(rand() % (365 * 24 * 60)) * 60;
+        struct tm *tm = gmtime(&t);
+        probes[i] = *tm;
+        starts[i] = t;
+    }
+
+    uint64_t kind_hits = 0, legacy_hits = 0, generic_hits = 0;
+
+    uint64_t start = bench_now_ns();
+    for (int p = 0; p < PROBE_COUNT; p++) {
+        for (int i = 0; i < JOB_COUNT; i++) {
+            legacy_hits += (uint64_t)legacy_time_matches(&legacy[i], &probes[p]);
+        }
+    }
+    uint64_t legacy_ns = bench_now_ns() - start;
+
+    uint64_t generic_ns = match_all(generic, probes, &generic_hits);
+    uint64_t kind_ns = match_all(jobs, probes, &kind_hits);
+
+    uint64_t next_sum = 0, generic_next_sum = 0;
+    uint64_t generic_next_ns = next_all(generic, starts, &generic_next_sum);
+    uint64_t next_ns = next_all(jobs, starts, &next_sum);
+
+    bench_consume(kind_hits + legacy_hits + generic_hits + next_sum + generic_next_sum);
+
+    if (kind_hits != legacy_hits || kind_hits != generic_hits) {
+        fprintf(stderr, "mismatch: by kind=%llu legacy=%llu generic=%llu\n", (unsigned long long)kind_hits,
+                (unsigned long long)legacy_hits, (unsigned long long)generic_hits);
+        return 1;
+    }
+    if (next_sum != generic_next_sum) {
+        fprintf(stderr, "mismatch: next_fire_time differs from the generic search\n");
+        return 1;
+    }
+
+    if (check_leap_days() != 0) {
+        return 1;
+    }
+
+    int kinds[5] = {0};
+    for (int i = 0; i < JOB_COUNT; i++) {
+        kinds[jobs[i].kind]++;
+    }
+
+    double calls = (double)JOB_COUNT * PROBE_COUNT;
+    printf("time_matches: %d jobs x %d probes, %llu matches\n", JOB_COUNT, PROBE_COUNT,
+           (unsigned long long)kind_hits);
+    printf("  int arrays  %7.2f ns/match  (%zu bytes/job)\n", legacy_ns / calls, sizeof(legacy_job));
+    printf("  bit-packed  %7.2f ns/match  (%zu bytes/job)\n", generic_ns / calls, sizeof(cron_job));
+    printf("  by kind     %7.2f ns/match\n", kind_ns / calls);
+
+    double next_calls = (double)JOB_COUNT * NEXT_PROBES;
+    printf("next_fire_time: %d jobs x %d fires\n", JOB_COUNT, NEXT_PROBES);
+    printf("  generic     %7.1f ns/call\n", generic_next_ns / next_calls);
+    printf("  by kind     %7.1f ns/call\n", next_ns / next_calls);
+    printf("kinds: generic %d, every minute %d, hourly %d, daily %d, weekdays %d\n", kinds[CRON_KIND_GENERIC],
+           kinds[CRON_KIND_EVERY_MINUTE], kinds[CRON_KIND_HOURLY], kinds[CRON_KIND_DAILY], kinds[CRON_KIND_WEEKDAYS]);
+
+    bench_report("match", "int_arrays", JOB_COUNT, "ns_per_match", legacy_ns / calls);
+    bench_report("match", "bit_packed", JOB_COUNT, "ns_per_match", generic_ns / calls);
+    bench_report("match", "by_kind", JOB_COUNT, "ns_per_match", kind_ns / calls);
+    bench_report("next_fire", "generic", JOB_COUNT, "ns_per_call", generic_next_ns / next_calls);
+    bench_report("next_fire", "by_kind", JOB_COUNT, "ns_per_call", next_ns / next_calls);
+
+    free(starts);
+    free(probes);
+    free(legacy);
+    free(generic);
+    free(jobs);
+    return 0;
+}
@@ -0,0 +1,143 @@
+/**
+ * Parser benchmarks: parse_cron_span() per line, and job_table_load() on
+ * generated crontabs with 1, 2, 4... parser threads. Every parallel load is
+ * checked against the serial one: same jobs in the same order, and the same
+ * problems reported at the same lines.
+ */
+#include "bench.h"
+#include "crontab_gen.h"
+#include "wcron/jobtable.h"
+#include "wcron/platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CRONTAB_FILE "build/bench_parse.txt"
+#define RUNS 3
+#define MAX_MESSAGES 16
+
+static char messages[MAX_MESSAGES][160];
+static int message_count;
+
+void log_msg(const char *msg) {
+    if (message_count < MAX_MESSAGES) {
+        snprintf(messages[message_count], sizeof(messages[0]), "%s", msg);
+    }
+    message_count++;
+}
+
+static int same_tables(const job_table *a, const job_table *b) {
+    if (a->count != b->count) {
+        return 0;
+    }
+    for (int i = 0; i < a->count; i++) {
+        const cron_job *x = &a->jobs[i];
+        const cron_job *y = &b->jobs[i];
+        if (x->minutes != y->minutes || x->hours != y->hours || x->days != y->days || x->months != y->months ||
+            x->daysofweek != y->daysofweek || x->flags != y->flags || x->command_len != y->command_len ||
+            strcmp(x->command, y->command) != 0 || a->hashes[i] != b->hashes[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Single-line parse cost over a generated mix, comments and blank lines included
+static void bench_lines(void) {
+    enum { LINES = 100000 };
+    static char text[LINES][128];
+    crontab_gen gen;
+    crontab_gen_init(&gen, 3);
+    for (int i = 0; i < LINES; i++) {
+        crontab_gen_line(&gen, text[i], sizeof(text[i]));
+    }
+
+    double best_ns = 0;
+    for (int run = 0; run < RUNS; run++) {
+        int parsed = 0;
+        cron_job job;
+        uint64_t t0 = bench_now_ns();
+        for (int i = 0; i < LINES; i++) {
+            parsed += parse_cron_span(text[i], strlen(text[i]), &job, NULL) == 0;
+        }
+        double ns = (double)(bench_now_ns() - t0) / LINES;
+        bench_consume((uint64_t)parsed);
+        if (run == 0 || ns < best_ns) {
+            best_ns = ns;
+        }
+    }
+
+    printf("parse_cron_span: %.1f ns/line\n", best_ns);
+    bench_report("parse", "line", LINES, "ns_per_line", best_ns);
+}
+
+int main(void) {
+    static const int SIZES[] = {100, 1000, 10000, 100000, 1000000};
+    int cpus = wcron_cpu_count();
+    int max_threads = cpus < 4 ? 4 : cpus;
+
+    bench_lines();
+
+    printf("job_table_load, %d CPUs\n", cpus);
+    printf("%10s %8s %10s %8s\n", "lines", "threads", "ms", "speedup");
+
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+        crontab_gen gen;
+        crontab_gen_init(&gen, 11);
+        gen.broken_every = 20011;
+        if (crontab_gen_file(&gen, CRONTAB_FILE, SIZES[s]) != 0) {
+            fprintf(stderr, "cannot write %s\n", CRONTAB_FILE);
+            return 1;
+        }
+
+        job_table *serial = NULL;
+        char serial_messages[MAX_MESSAGES][160];
+        int serial_message_count = 0;
+        double serial_ms = 0;
+
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+            job_table_set_threads(threads);
+
+            double best_ms = 0;
+            for (int run = 0; run < RUNS; run++) {
+                message_count = 0;
+                uint64_t t0 = bench_now_ns();
+                job_table *table = job_table_load(CRONTAB_FILE, NULL);
+                double ms = (double)(bench_now_ns() - t0) / 1e6;
+                if (!table) {
+                    fprintf(stderr, "load failed\n");
+                    return 1;
+                }
+                if (run == 0 || ms < best_ms) {
+                    best_ms = ms;
+                }
+
+                if (!serial) {
+                    serial = table;
+                    memcpy(serial_messages, messages, sizeof(messages));
+                    serial_message_count = message_count;
+                    continue;
+                }
+                if (!same_tables(serial, table) || message_count != serial_message_count ||
+                    memcmp(serial_messages, messages, sizeof(messages)) != 0) {
+                    fprintf(stderr, "%d threads: result differs from the serial parse\n", threads);
+                    return 1;
+                }
+                job_table_release(table);
+            }
+
+            if (threads == 1) {
+                serial_ms = best_ms;
+            }
+            printf("%10d %8d %10.1f %7.2fx\n", SIZES[s], threads, best_ms, serial_ms / best_ms);
+
+            char label[32];
+            snprintf(label, sizeof(label), "load_%d_threads", threads);
+            bench_report("parse", label, SIZES[s], "ms", best_ms);
+        }
+        job_table_release(serial);
+    }
+
+    remove(CRONTAB_FILE);
+    return 0;
+}
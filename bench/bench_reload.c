@@ -0,0 +1,176 @@
+/**
+ * Reload benchmark: the steps of a crontab reload after 1% of the lines were
+ * edited, at 10^2 to 10^6 lines. parse, match and schedule run on the reload
+ * thread; only publish (carry queued times over, rebuild the run queue) runs
+ * on the scheduler thread. "same" is a reload of an untouched file, which
+ * stops at the content hash.
+ */
+#include "bench.h"
+#include "crontab_gen.h"
+#include "wcron/jobtable.h"
+#include "wcron/runqueue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BASE_FILE "build/bench_reload_a.txt"
+#define EDITED_FILE "build/bench_reload_b.txt"
+#define EDIT_EVERY 100
+
+void log_msg(const char *msg) {
+    (void)msg;
+}
+
+static double elapsed_ms(uint64_t t0) {
+    return (double)(bench_now_ns() - t0) / 1e6;
+}
+
+// The same crontab twice, the second with every EDIT_EVERY-th line replaced
+static int write_crontabs(int lines) {
+    FILE *a = fopen(BASE_FILE, "w");
+    FILE *b = fopen(EDITED_FILE, "w");
+    if (!a || !b) {
+        if (a)
+            fclose(a);
+        if (b)
+            fclose(b);
+        return -1;
+    }
+
+    crontab_gen gen, edits;
+    crontab_gen_init(&gen, 5);
+    crontab_gen_init(&edits, 6);
+    edits.line = lines;
+
+    char line[256];
+    for (int i = 0; i < lines; i++) {
+        crontab_gen_line(&gen, line, sizeof(line));
+        fprintf(a, "%s\n", line);
+        if (i % EDIT_EVERY == EDIT_EVERY / 2) {
+            crontab_gen_line(&edits, line, sizeof(line));
+        }
+        fprintf(b, "%s\n", line);
+    }
+
+    int r = fclose(a);
+    return fclose(b) == 0 && r == 0 ? 0 : -1;
+}
+
+static int schedule(runqueue *q, const job_table *table, time_t now) {
+    runqueue_entry *entries = malloc(sizeof(runqueue_entry) * (size_t)(table->count + 1));
+    if (!entries) {
+        return -1;
+    }
+    int queued = 0;
+    for (int i = 0; i < table->count; i++) {
+        time_t when = next_fire_time(&table->jobs[i], now);
+        if (when != CRON_NEVER) {
+            entries[queued].when = when;
+            entries[queued].job = i;
+            queued++;
+        }
+    }
+    int r = runqueue_build(q, entries, queued);
+    free(entries);
+    return r;
+}
+
+int main(void) {
+    static const int SIZES[] = {100, 1000, 10000, 100000, 1000000};
+    time_t now = 1773133200; // 2026-03-10 09:00 UTC
+
+    printf("%10s %9s %9s %9s %9s %9s %9s %9s\n", "lines", "same ms", "parse ms", "match ms", "sched ms", "publish",
+           "total ms", "kept");
+
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+        int n = SIZES[s];
+        if (write_crontabs(n) != 0) {
+            fprintf(stderr, "cannot write crontabs\n");
+            return 1;
+        }
+
+        runqueue q;
+        job_table *base = job_table_load(BASE_FILE, NULL);
+        if (!base || runqueue_init(&q, 0) != 0 || schedule(&q, base, now) != 0) {
+            fprintf(stderr, "setup failed\n");
+            return 1;
+        }
+
+        uint64_t t0 = bench_now_ns();
+        job_table *same = job_table_load(BASE_FILE, base);
+        double same_ms = elapsed_ms(t0);
+        if (same != base) {
+            fprintf(stderr, "unchanged file was parsed again\n");
+            return 1;
+        }
+        job_table_release(same);
+
+        t0 = bench_now_ns();
+        job_table *next = job_table_load(EDITED_FILE, base);
+        double parse_ms = elapsed_ms(t0);
+
+        int *map = malloc(sizeof(int) * (size_t)(next ? next->count + 1 : 1));
+        time_t *fire = malloc(sizeof(time_t) * (size_t)(next ? next->count + 1 : 1));
+        runqueue_entry *entries = malloc(sizeof(runqueue_entry) * (size_t)(next ? next->count + 1 : 1));
+        if (!next || !map || !fire || !entries) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+
+        t0 = bench_now_ns();
+        int kept = job_table_match(base, next, map);
+        double match_ms = elapsed_ms(t0);
+
+        t0 = bench_now_ns();
+        for (int i = 0; i < next->count; i++) {
+            if (map[i] < 0) {
+                fire[i] = next_fire_time(&next->jobs[i], now);
+            }
+        }
+        double sched_ms = elapsed_ms(t0);
+
+        // What the scheduler thread does in publish_reload()
+        t0 = bench_now_ns();
+        int queued = 0;
+        for (int i = 0; i < next->count; i++) {
+            time_t when = CRON_NEVER;
+            if (map[i] >= 0) {
+                next->jobs[i].last_run = base->jobs[map[i]].last_run;
+                if (!runqueue_get(&q, map[i], &when)) {
+                    when = CRON_NEVER;
+                }
+            } else {
+                when = fire[i];
+            }
+            if (when != CRON_NEVER) {
+                entries[queued].when = when;
+                entries[queued].job = i;
+                queued++;
+            }
+        }
+        runqueue_build(&q, entries, queued);
+        double publish_ms = elapsed_ms(t0);
+
+        double total_ms = parse_ms + match_ms + sched_ms + publish_ms;
+        printf("%10d %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %8.1f%%\n", n, same_ms, parse_ms, match_ms, sched_ms,
+               publish_ms, total_ms, 100.0 * kept / (next->count ? next->count : 1));
+
+        bench_report("reload", "unchanged", n, "ms", same_ms);
+        bench_report("reload", "parse", n, "ms", parse_ms);
+        bench_report("reload", "match", n, "ms", match_ms);
+        bench_report("reload", "schedule", n, "ms", sched_ms);
+        bench_report("reload", "publish", n, "ms", publish_ms);
+        bench_report("reload", "total", n, "ms", total_ms);
+
+        free(entries);
+        free(fire);
+        free(map);
+        runqueue_free(&q);
+        job_table_release(next);
+        job_table_release(base);
+    }
+
+    remove(BASE_FILE);
+    remove(EDITED_FILE);
+    return 0;
+}
@@ -0,0 +1,178 @@
+/**
+ * Scheduler tick benchmark: run-queue pop/re-arm against the old linear
+ * time_matches() scan, i.e. the cost of finding the due set each minute.
+ *
+ * "idle": every crontab size has the same 100 every-minute jobs and the rest
+ * fire once a year outside the simulated hour, so a flat tick cost means the
+ * queue does not pay for idle jobs. "mixed": generated crontabs.
+ * The index columns evaluate the whole table each minute from the bitset index.
+ */
+#include "bench.h"
+#include "crontab_gen.h"
+#include "wcron/dueindex.h"
+#include "wcron/parser.h"
+#include "wcron/runqueue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DUE_PER_TICK 100
+#define TICKS 60
+#define IDLE_TEMPLATES 1440
+
+void log_msg(const char *msg) {
+    fprintf(stderr, "parse: %s\n", msg);
+}
+
+static cron_job every_minute;
+static cron_job idle_templates[IDLE_TEMPLATES];
+
+static const cron_job *idle_job_at(int i) {
+    return i < DUE_PER_TICK ? &every_minute : &idle_templates[i % IDLE_TEMPLATES];
+}
+
+static cron_job *mixed_jobs;
+
+static const cron_job *mixed_job_at(int i) {
+    return &mixed_jobs[i];
+}
+
+static int run_case(const char *name, int n, const cron_job *(*job_at)(int), time_t start) {
+    runqueue q;
+    if (runqueue_init(&q, n) != 0) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        runqueue_update(&q, i, next_fire_time(job_at(i), start - 1));
+    }
+
+    uint64_t due = 0;
+    uint64_t queue_ns = 0;
+    for (int t = 0; t < TICKS; t++) {
+        time_t now = start + (time_t)t * 60;
+        uint64_t t0 = bench_now_ns();
+
+        runqueue_entry entry;
+        while (runqueue_peek(&q, &entry) && entry.when <= now) {
+            runqueue_pop(&q, &entry);
+            due++;
+            runqueue_update(&q, entry.job, next_fire_time(job_at(entry.job), entry.when));
+        }
+        queue_ns += bench_now_ns() - t0;
+    }
+
+    uint64_t matched = 0;
+    uint64_t scan_ns = 0;
+    for (int t = 0; t < TICKS; t++) {
+        time_t now = start + (time_t)t * 60;
+        struct tm tm;
+        localtime_r(&now, &tm);
+        uint64_t t0 = bench_now_ns();
+
+        for (int i = 0; i < n; i++) {
+            matched += (uint64_t)time_matches(job_at(i), &tm);
+        }
+        scan_ns += bench_now_ns() - t0;
+    }
+    bench_consume(matched);
+    runqueue_free(&q);
+
+    due_index index;
+    if (due_index_init(&index, n) != 0) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < n; i++) {
+        due_index_add(&index, job_at(i), i);
+    }
+
+    uint64_t indexed = 0;
+    uint64_t index_ns = 0;
+    for (int t = 0; t < TICKS; t++) {
+        time_t now = start + (time_t)t * 60;
+        struct tm tm;
+        localtime_r(&now, &tm);
+        uint64_t t0 = bench_now_ns();
+
+        indexed += (uint64_t)due_index_eval(&index, &tm);
+        index_ns += bench_now_ns() - t0;
+    }
+    due_index_free(&index);
+
+    if (matched != due || indexed != due) {
+        fprintf(stderr, "%s: mismatch at %d jobs: queue=%llu scan=%llu index=%llu\n", name, n,
+                (unsigned long long)due, (unsigned long long)matched, (unsigned long long)indexed);
+        return 1;
+    }
+
+    printf("%-7s %10d %14.0f %14.0f %14.0f %12.1f\n", name, n, (double)queue_ns / TICKS, (double)scan_ns / TICKS,
+           (double)index_ns / TICKS, (double)due / TICKS);
+
+    char label[32];
+    snprintf(label, sizeof(label), "%s_queue", name);
+    bench_report("tick", label, n, "ns_per_tick", (double)queue_ns / TICKS);
+    snprintf(label, sizeof(label), "%s_scan", name);
+    bench_report("tick", label, n, "ns_per_tick", (double)scan_ns / TICKS);
+    snprintf(label, sizeof(label), "%s_index", name);
+    bench_report("tick", label, n, "ns_per_tick", (double)index_ns / TICKS);
+    return 0;
+}
+
+int main(void) {
+    static const int SIZES[] = {100, 1000, 10000, 100000, 1000000};
+    static const int MAX_SIZE = 1000000;
+
+    if (parse_cron_line("* * * * * cmd", &every_minute) != 0) {
+        return 1;
+    }
+    for (int i = 0; i < IDLE_TEMPLATES; i++) {
+        char line[64];
+        snprintf(line, sizeof(line), "%d %d 1 1 * cmd", i % 60, i / 60);
+        if (parse_cron_line(line, &idle_templates[i]) != 0) {
+            return 1;
+        }
+    }
+
+    // Only the schedules matter here, so commands are left pointing nowhere useful
+    mixed_jobs = calloc(MAX_SIZE, sizeof(cron_job));
+    if (!mixed_jobs) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    crontab_gen gen;
+    crontab_gen_init(&gen, 7);
+    for (int i = 0; i < MAX_SIZE; i++) {
+        char line[256];
+        do {
+            crontab_gen_line(&gen, line, sizeof(line));
+        } while (parse_cron_span(line, strlen(line), &mixed_jobs[i], NULL) != 0);
+        mixed_jobs[i].command = NULL;
+    }
+
+    struct tm start_tm = {0};
+    start_tm.tm_year = 2026 - 1900;
+    start_tm.tm_mon = 2;
+    start_tm.tm_mday = 10;
+    start_tm.tm_hour = 9;
+    start_tm.tm_isdst = -1;
+    time_t start = mktime(&start_tm);
+
+    printf("%-7s %10s %14s %14s %14s %12s\n", "crontab", "jobs", "queue ns/tick", "scan ns/tick", "index ns/tick",
+           "due/tick");
+
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+        if (run_case("idle", SIZES[s], idle_job_at, start) != 0) {
+            return 1;
+        }
+    }
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+        if (run_case("mixed", SIZES[s], mixed_job_at, start) != 0) {
+            return 1;
+        }
+    }
+
+    free(mixed_jobs);
+    return 0;
+}
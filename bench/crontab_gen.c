@@ -0,0 +1,82 @@
+#include "crontab_gen.h"
+#include <stdio.h>
+
+static const int MINUTE_STEPS[] = {1, 2, 5, 10, 15, 20, 30};
+
+static uint32_t next_random(crontab_gen *gen) {
+    // xorshift64*
+    gen->state ^= gen->state >> 12;
+    gen->state ^= gen->state << 25;
+    gen->state ^= gen->state >> 27;
+    return (uint32_t)((gen->state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+static int pick(crontab_gen *gen, int n) {
+    return (int)(next_random(gen) % (uint32_t)n);
+}
+
+void crontab_gen_init(crontab_gen *gen, uint64_t seed) {
+    gen->state = seed ? seed : 0x9E3779B97F4A7C15ull;
+    gen->broken_every = 0;
+    gen->line = 0;
+}
+
+int crontab_gen_line(crontab_gen *gen, char *buf, size_t size) {
+    int id = gen->line++;
+    int m = pick(gen, 60);
+    int h = pick(gen, 24);
+    int r;
+
+    if (gen->broken_every > 0 && id % gen->broken_every == gen->broken_every - 1) {
+        return snprintf(buf, size, "60 %d * * * /usr/local/bin/broken-%d", h, id);
+    }
+
+    // Weights in percent: the mix a generated fleet crontab tends to have
+    int kind = pick(gen, 100);
+    if (kind < 3) {
+        r = snprintf(buf, size, "# owner: team-%d", pick(gen, 40));
+    } else if (kind < 5) {
+        r = snprintf(buf, size, "%s", "");
+    } else if (kind < 33) {
+        r = snprintf(buf, size, "%d %d * * * /usr/local/bin/daily-%d --quiet", m, h, id);
+    } else if (kind < 48) {
+        int step = MINUTE_STEPS[pick(gen, (int)(sizeof(MINUTE_STEPS) / sizeof(MINUTE_STEPS[0])))];
+        r = snprintf(buf, size, "*/%d * * * * /usr/local/bin/poll-%d", step, id);
+    } else if (kind < 63) {
+        int from = 6 + pick(gen, 4);
+        r = snprintf(buf, size, "%d %d-%d * * 1-5 /usr/local/bin/office-%d", m, from, from + 8 + pick(gen, 3), id);
+    } else if (kind < 73) {
+        r = snprintf(buf, size, "%d,%d %d,%d,%d * * * /usr/local/bin/report-%d > /dev/null 2>&1", m % 30,
+                     m % 30 + 30, h % 8, h % 8 + 8, h % 8 + 16, id);
+    } else if (kind < 83) {
+        // Both day fields restricted: fires on either
+        r = snprintf(buf, size, "%d %d %d,%d * %d /usr/local/bin/cycle-%d", m, h, 1 + pick(gen, 14),
+                     15 + pick(gen, 14), pick(gen, 7), id);
+    } else if (kind < 91) {
+        r = snprintf(buf, size, "%d %d %d * * /usr/local/bin/monthly-%d", m, h, 1 + pick(gen, 28), id);
+    } else if (kind < 95) {
+        r = snprintf(buf, size, "%d %d 1 %d-12/3 * /usr/local/bin/quarterly-%d", m, h, 1 + pick(gen, 3), id);
+    } else if (kind < 98) {
+        r = snprintf(buf, size, "%d %d-%d/%d */2 * * /usr/local/bin/batch-%d", m, h % 12, h % 12 + 12,
+                     2 + pick(gen, 3), id);
+    } else {
+        r = snprintf(buf, size, "%d %d %d %d * /usr/local/bin/yearly-%d", m, h, 1 + pick(gen, 28), 1 + pick(gen, 12),
+                     id);
+    }
+    return r;
+}
+
+int crontab_gen_file(crontab_gen *gen, const char *path, int lines) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        return -1;
+    }
+
+    char line[256];
+    for (int i = 0; i < lines; i++) {
+        crontab_gen_line(gen, line, sizeof(line));
+        fputs(line, fp);
+        fputc('\n', fp);
+    }
+    return fclose(fp) == 0 ? 0 : -1;
+}
@@ -0,0 +1,25 @@
+#ifndef WCRON_CRONTAB_GEN_H
+#define WCRON_CRONTAB_GEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Deterministic generator of realistic crontabs for the benchmarks: fixed
+ * daily jobs, every-N-minutes jobs, working-hour ranges, lists, restricted
+ * day-of-month and day-of-week together (the OR rule), monthly and yearly
+ * schedules, with comments and blank lines in between.
+ */
+typedef struct {
+    uint64_t state;
+    int broken_every; // every Nth line is invalid (minute 60); 0 for none
+    int line;
+} crontab_gen;
+
+void crontab_gen_init(crontab_gen *gen, uint64_t seed);
+// Next line, without newline; returns its length
+int crontab_gen_line(crontab_gen *gen, char *buf, size_t size);
+// Write `lines` lines to path; returns 0 on success
+int crontab_gen_file(crontab_gen *gen, const char *path, int lines);
+
+#endif // WCRON_CRONTAB_GEN_H
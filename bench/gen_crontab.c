@@ -0,0 +1,27 @@
+/**
+ * Write a generated crontab to stdout, for trying the daemon or the benchmarks
+ * on big inputs: gen_crontab LINES [SEED]
+ */
+#include "crontab_gen.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: gen_crontab LINES [SEED]\n");
+        return 1;
+    }
+
+    int lines = atoi(argv[1]);
+    uint64_t seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+
+    crontab_gen gen;
+    crontab_gen_init(&gen, seed);
+
+    char line[256];
+    for (int i = 0; i < lines; i++) {
+        crontab_gen_line(&gen, line, sizeof(line));
+        puts(line);
+    }
+    return 0;
+}
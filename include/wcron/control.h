@@ -0,0 +1,31 @@
+#ifndef WCRON_CONTROL_H
+#define WCRON_CONTROL_H
+
+/**
+ * Local control socket: a Unix domain socket next to the executable that only
+ * its owner may connect to. A client sends one request line and reads the
+ * reply until the daemon closes the connection: "ok" or "error <reason>" on
+ * the first line, the details on the following ones. Requests are served on
+ * the scheduler loop from state it already holds; none of them waits for
+ * anything but `reload`, which is answered once the reload has ended.
+ *
+ *   status        state of the daemon and of its last reload
+ *   reload        reload the crontab and report the parse result and diff counts
+ *   pause         stop starting jobs
+ *   resume
+ *   run-now N     start job N now, outside its schedule
+ *   list-running  runs alive: held back, queued or running
+ */
+
+// Listen at path on the scheduler loop; call after init_job_system()
+int control_start(const char *path);
+// Drop every connection and remove the socket; call before shutdown_job_system()
+void control_stop(void);
+
+/**
+ * Client side: send request to the daemon listening at path and print its reply
+ * @return 0 for an "ok" reply, 1 for an error reply, -1 if the daemon could not be reached
+ */
+int control_request(const char *path, const char *request);
+
+#endif // WCRON_CONTROL_H
@@ -0,0 +1,65 @@
+#ifndef WCRON_DUEINDEX_H
+#define WCRON_DUEINDEX_H
+
+#include "parser.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Column-oriented index of job schedules: for every value of every field
+ * (minute 0-59, hour, day of month, month, weekday) a bitset of the jobs that
+ * allow it. The jobs due in a minute are then a few ANDs and ORs per 64 jobs
+ * instead of a time_matches() call per job.
+ *
+ * Jobs live in slots rather than at their table index, so a reload that keeps
+ * a job keeps its bits and only renumbers it with due_index_move().
+ */
+
+// Bitsets per index: 60 minutes, 24 hours, 31 days of month, 12 months, 7 weekdays, both-restricted
+#define DUE_INDEX_SETS (60 + 24 + 31 + 12 + 7 + 1)
+
+typedef struct {
+    size_t words;  // 64-bit words per bitset
+    int capacity;  // slots, words * 64
+    uint64_t *bits; // DUE_INDEX_SETS bitsets of `words` words each, in one allocation
+    uint64_t *due;  // result of the last due_index_eval()
+
+    int *slot_job; // table index of the job in each slot, -1 if free
+    int *free_slots;
+    int free_count;
+    int used; // slots ever handed out
+    int members;
+
+    // Members allowing each value, to keep the summary schedule exact on removal
+    int minute_refs[60];
+    int hour_refs[24];
+    int mday_refs[31];
+    int month_refs[12];
+    int wday_refs[7];
+} due_index;
+
+int due_index_init(due_index *index, int capacity);
+void due_index_free(due_index *index);
+void due_index_clear(due_index *index);
+
+// Worth indexing: follows the clock (CRON_TIME_WILDCARD) and fires about hourly or more on the days it runs.
+// Rarer jobs cost less in the run queue.
+int due_index_wants(const cron_job *job);
+// Index a job under its table index; returns its slot, or -1 if out of memory
+int due_index_add(due_index *index, const cron_job *job, int job_index);
+// Drop the job in slot; job must be the one it was added with
+void due_index_remove(due_index *index, int slot, const cron_job *job);
+// Record the job's new table index after a reload
+void due_index_move(due_index *index, int slot, int job_index);
+
+/**
+ * Compute the slots due at local time tm into index->due
+ * @return how many are due
+ */
+int due_index_eval(due_index *index, const struct tm *tm);
+
+// Earliest minute after `after` at which any member may be due, or CRON_NEVER; never later than the real one
+time_t due_index_next(const due_index *index, time_t after);
+
+#endif // WCRON_DUEINDEX_H
@@ -0,0 +1,58 @@
+#ifndef WCRON_JOBTABLE_H
+#define WCRON_JOBTABLE_H
+
+#include "parser.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Jobs loaded from one crontab file. The job array, the per-line hashes and
+ * the command string arena share a single allocation, so a table costs one
+ * malloc to load and one free to drop, and its size follows the file instead
+ * of a fixed limit.
+ *
+ * Tables are reference counted: the live table is owned by the scheduler,
+ * and a reload or a running job keeps the table it started from alive. When a
+ * reload replaces a table, forward[] maps its jobs into the successor so
+ * late completions can find the job they belong to.
+ */
+typedef struct job_table {
+    cron_job *jobs;
+    int count;
+    int problems; // lines rejected as invalid or never firing
+
+    uint64_t *hashes;    // FNV-1a of each job's crontab line
+    char *strings;       // interned, NUL-terminated commands
+    size_t strings_size; // size of the arena; commands sit in it in file order
+    void *block;         // the single allocation behind jobs, hashes and strings
+
+    uint64_t content_hash; // FNV-1a of the whole file as read, to skip reloads of an unchanged file
+    size_t content_size;
+
+    int refs;
+    int *forward;                // index of each job in successor, -1 if it was removed
+    struct job_table *successor; // table that replaced this one, referenced
+} job_table;
+
+/**
+ * Load every valid line of the crontab at path (a missing file yields an empty table).
+ * Large files are parsed on several threads; jobs keep their file order.
+ * @param current Table to compare against, or NULL. When the file still has
+ *                exactly its content, current is returned instead of parsing.
+ * @return a table holding one reference, or NULL on failure
+ */
+job_table *job_table_load(const char *path, job_table *current);
+// Threads job_table_load() may parse with; 0 (the default) means one per CPU
+void job_table_set_threads(int threads);
+void job_table_acquire(job_table *table);
+// Drop a reference; the last one frees the table and its reference on the successor
+void job_table_release(job_table *table);
+
+/**
+ * Pair the jobs of next with identical jobs (same line content) of prev.
+ * @param map Receives, for each job of next, its index in prev or -1
+ * @return number of jobs matched
+ */
+int job_table_match(const job_table *prev, const job_table *next, int *map);
+
+#endif // WCRON_JOBTABLE_H
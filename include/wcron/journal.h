@@ -0,0 +1,56 @@
+#ifndef WCRON_JOURNAL_H
+#define WCRON_JOURNAL_H
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Run history: an append-only file of fixed-size records (wcron.journal) plus
+ * a sparse index (wcron.journal.idx) with one entry per JOURNAL_INDEX_STRIDE
+ * records. An entry holds the latest end time seen so far, so a --since query
+ * skips everything older with a binary search, and a summary of its block:
+ * the number of failed runs and a bitmap of the job hashes that ran in it, so
+ * --job and --failed skip the blocks that cannot match.
+ */
+
+#define JOURNAL_INDEX_STRIDE 1024
+#define JOURNAL_JOB_BITS 1024 // per index entry; a job sets bit hash % JOURNAL_JOB_BITS
+
+#define JOURNAL_RUN_STARTED 0x01 // the process was created
+#define JOURNAL_RUN_FAILED 0x02  // could not start, or exited non-zero
+#define JOURNAL_RUN_CATCHUP 0x04 // made up for a fire time missed while paused, suspended or behind a clock jump
+#define JOURNAL_RUN_MANUAL 0x08  // started on request (`wcrontab ctl run-now`), not by the schedule
+
+typedef struct {
+    uint64_t job_hash;    // line hash of the job, as output files, metrics and status use; edits elsewhere keep it
+    int32_t job;          // index of the job in the crontab when it ran
+    int32_t exit_code;    // -1 when the process could not be started
+    int64_t scheduled;    // fire time the run belongs to (seconds)
+    int64_t start_ms;     // wall clock, milliseconds since the epoch
+    int64_t end_ms;       // start_ms + duration_ms
+    uint32_t duration_ms; // measured on the monotonic clock
+    uint32_t flags;       // JOURNAL_RUN_*
+    uint32_t queue_ms;    // from coming due to the start: jitter, admission wait and launch
+    uint32_t wait_ms;     // part of queue_ms spent waiting for a WCRON_MAX_RUNNING slot
+} journal_record;
+
+typedef struct {
+    int by_job;
+    uint64_t job_hash; // with by_job
+    int64_t since_ms; // runs that started at or after this time, 0 for all
+    int failed_only;
+    long tail; // last N matching runs, 0 for all
+} journal_query;
+
+// Open (or create) the journal for appending; repairs a missing index tail
+int journal_open(const char *path);
+int journal_append(const journal_record *record);
+void journal_close(void);
+
+/**
+ * Print the runs matching query, oldest first.
+ * @return number of runs printed, -1 if the journal cannot be read
+ */
+long journal_print(const char *path, const journal_query *query);
+
+#endif // WCRON_JOURNAL_H
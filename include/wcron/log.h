@@ -0,0 +1,43 @@
+#ifndef WCRON_LOG_H
+#define WCRON_LOG_H
+
+#include <stddef.h>
+
+typedef enum {
+    LOG_FSYNC_NEVER, // leave write-back to the OS
+    LOG_FSYNC_FLUSH  // fsync after every batch written
+} log_fsync_policy;
+
+typedef struct {
+    unsigned flush_interval_ms; // how long the writer lets records pile up before a batch write
+    log_fsync_policy fsync_policy;
+    unsigned ring_records; // ring capacity, rounded up to a power of two
+} log_config;
+
+/**
+ * Fill config with defaults, overridden by WCRON_LOG_FLUSH_MS,
+ * WCRON_LOG_FSYNC (never|flush) and WCRON_LOG_RING from the environment.
+ */
+void log_config_defaults(log_config *config);
+
+/**
+ * Set the log file. Until log_start() runs, messages are appended synchronously.
+ * @return 0 on success, -1 if the path does not fit
+ */
+int log_set_path(const char *path);
+
+/**
+ * Start the background writer. From then on log_msg() only copies the message
+ * into a lock-free ring and never waits for the disk; records are dropped
+ * (and counted) when the ring is full.
+ * @return 0 on success, -1 on failure (logging stays synchronous)
+ */
+int log_start(const log_config *config);
+
+// Write out every pending record and stop the writer
+void log_stop(void);
+
+// Append a timestamped line to wcron.log
+void log_msg(const char *msg);
+
+#endif // WCRON_LOG_H
@@ -0,0 +1,65 @@
+#ifndef WCRON_METRICS_H
+#define WCRON_METRICS_H
+
+#include <stdint.h>
+
+/**
+ * Scheduler and job metrics, written every WCRON_METRICS_INTERVAL seconds
+ * (default 15, 0 disables) to a file in the Prometheus text format, ready
+ * for the node_exporter textfile collector. The file is replaced by rename,
+ * so readers never see half of it.
+ *
+ * Recording is a relaxed atomic add and never takes a lock: counters and
+ * gauges can be updated from any thread. Per-job series are keyed by the
+ * job's line hash, the name of its output file, and dropped once a reload
+ * removes the line; WCRON_METRICS_JOBS=0 leaves them out.
+ */
+
+typedef enum {
+    METRIC_RUNS_OK,
+    METRIC_RUNS_FAILED,
+    METRIC_RUNS_NOT_STARTED,
+    METRIC_CATCHUP_RUNS,
+    METRIC_OUTPUT_TRUNCATED,
+    METRIC_RELOADS,
+    METRIC_WAKEUPS,
+    METRIC_CLOCK_JUMPS,
+    METRIC_COUNTERS
+} metrics_counter;
+
+typedef enum {
+    METRIC_JOBS,    // jobs in the live crontab
+    METRIC_RUNNING, // job processes alive
+    METRIC_QUEUED,  // runs created but not started: jitter, admission queue, launcher queue
+    METRIC_PAUSED,
+    METRIC_GAUGES
+} metrics_gauge;
+
+typedef enum {
+    METRIC_DRIFT, // scheduled minute to process start
+    METRIC_SPAWN, // creating the process
+    METRIC_TICK,  // handling one scheduler deadline
+    METRIC_HISTOGRAMS
+} metrics_histogram;
+
+void metrics_count(metrics_counter counter);
+void metrics_gauge_add(metrics_gauge gauge, int64_t delta);
+void metrics_gauge_set(metrics_gauge gauge, int64_t value);
+void metrics_observe(metrics_histogram histogram, uint64_t us);
+uint64_t metrics_counter_value(metrics_counter counter);
+int64_t metrics_gauge_value(metrics_gauge gauge);
+// Record one finished run of a job; scheduler thread only, it owns the per-job index
+void metrics_observe_job(uint64_t hash, uint64_t duration_us, int failed);
+// A reload was installed: retire the series of every job whose hash is not among hashes; scheduler thread only
+void metrics_keep_jobs(const uint64_t *hashes, int count);
+
+/**
+ * Start the thread that rewrites dir/wcron.prom, creating dir. The file has a
+ * directory of its own so that rewriting it does not look like a crontab edit.
+ * @return 0 on success, -1 if it is disabled or could not start (recording still works)
+ */
+int metrics_start(const char *dir);
+// Write the file one last time, stop the thread and free the per-job series
+void metrics_stop(void);
+
+#endif // WCRON_METRICS_H
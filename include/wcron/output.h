@@ -0,0 +1,65 @@
+#ifndef WCRON_OUTPUT_H
+#define WCRON_OUTPUT_H
+
+#include "platform.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Job output capture. A job's stdout and stderr go to a pipe that the
+ * scheduler loop drains without blocking; the bytes are spliced into the
+ * job's log file (<dir>/<line hash>.log) and the last few KB of every job
+ * are kept in memory. Each run may write at most WCRON_OUTPUT_MAX KB to the
+ * file, then a truncation marker is written and the rest is read and
+ * dropped; a file that has grown past the cap is moved to .log.1 before the
+ * next run. Where pipes cannot be watched (Windows) the child writes to the
+ * file itself and the cap is applied when it exits.
+ */
+
+typedef struct {
+    wcron_handle pipe;  // read end of the capture pipe, WCRON_NO_HANDLE if there is none
+    wcron_handle child; // what the child writes to: the pipe's write end or the file
+    wcron_handle file;  // the job's log file, WCRON_NO_HANDLE if it could not be opened
+    uint64_t hash;
+    int64_t start;    // file size when the run began, after its header
+    uint64_t written; // bytes of this run in the file, marker included
+    uint64_t dropped; // bytes read past the cap
+    int truncated;
+    int ended; // the pipe reached end of output; it stays open until output_end()
+} job_output;
+
+/**
+ * Start capturing into dir, created if missing. Reads WCRON_OUTPUT_MAX (KB a
+ * run may write to its log file, default 1024, 0 keeps no files) and
+ * WCRON_OUTPUT_KEEP (KB of recent output held in memory per job, default 4).
+ * @return 0 on success, -1 if capture stays off
+ */
+int output_init(const char *dir);
+// Drop the in-memory output of every job
+void output_shutdown(void);
+
+/**
+ * Prepare to capture a run: open the job's log file, write the run header
+ * and create the pipe. out->child is then the handle to spawn the job with
+ * (WCRON_NO_HANDLE when capture is off or failed).
+ */
+void output_begin(job_output *out, uint64_t hash, time_t scheduled);
+// The child is started (or failed to start): close our copy of its end
+void output_spawned(job_output *out);
+
+/**
+ * Move what the pipe holds into the log file, never blocking
+ * @return 1 once the output ended, 0 while it may still produce more
+ */
+int output_drain(job_output *out);
+// Last drain after the child exited, apply the cap, keep the tail in memory and close everything
+void output_end(job_output *out);
+
+/**
+ * Copy the job's most recent output, oldest byte first
+ * @return bytes copied (0 if the job has none)
+ */
+size_t output_tail(uint64_t hash, char *buffer, size_t size);
+
+#endif // WCRON_OUTPUT_H
@@ -1,22 +1,71 @@
 #ifndef CRONTAB_PARSER_H
 #define CRONTAB_PARSER_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <time.h>
 
+// cron_job.flags
+#define CRON_DOM_WILDCARD 0x01  // day-of-month field allows every day
+#define CRON_DOW_WILDCARD 0x02  // day-of-week field allows every weekday
+#define CRON_NEVER_FIRES 0x04   // no calendar date satisfies the schedule (e.g. 0 0 31 2 *)
+#define CRON_CATCHUP_ONCE 0x08  // fire times missed in a gap are made up by one run
+#define CRON_CATCHUP_ALL 0x10   // ... by one run each, at most catchup_max
+#define CRON_TIME_WILDCARD 0x20 // minute or hour field starts with *: the job follows the clock across DST
+
+// Catch-up policy bits, set by the job table from WCRON_CATCHUP; neither: missed fire times are skipped
+#define CRON_CATCHUP_MASK (CRON_CATCHUP_ONCE | CRON_CATCHUP_ALL)
+
+// cron_job.kind: the shape of the schedule, picks the matcher in time_matches() and next_fire_time()
+#define CRON_KIND_GENERIC 0      // anything else
+#define CRON_KIND_EVERY_MINUTE 1 // * * * * *
+#define CRON_KIND_HOURLY 2       // only the minute restricted, hour written with *: M * * * *, */N * * * *
+#define CRON_KIND_DAILY 3        // minute and hour restricted: M H * * *
+#define CRON_KIND_WEEKDAYS 4     // minute, hour and weekday restricted: M H * * D
+
+// next_fire_time() result for schedules that never fire
+#define CRON_NEVER ((time_t)-1)
+
 typedef struct {
-    int minutes[60];   // 0-59, 1 if allowed
-    int hours[24];     // 0-23
-    int days[31];      // 1-31
-    int months[12];    // 0-11 (Jan=0)
-    int daysofweek[7]; // 0-6 (Sun=0)
-    char command[512]; // the command to run limit to 256 characters
+    uint64_t minutes;    // bit N set: minute N allowed (0-59)
+    uint32_t hours;      // bit N set: hour N allowed (0-23)
+    uint32_t days;       // bit N set: day N allowed (1-31, bit 0 unused)
+    uint32_t months;     // bit N set: month N allowed (0-11, Jan=0)
+    uint8_t daysofweek;  // bit N set: weekday N allowed (0-6, Sun=0)
+    uint8_t flags;       // CRON_* flags, fixed at parse time
+    uint8_t kind;        // CRON_KIND_*, fixed at parse time
+    uint8_t catchup_max; // runs CRON_CATCHUP_ALL makes up for one gap, set by the job table
+
+    const char *command;  // the command to run, NUL-terminated once interned by the job table
+    uint32_t command_len; // length of command in bytes
 
     volatile int is_running; // 1 if the job is running, 0 otherwise
     time_t last_run;         // last time the job was run
 } cron_job;
 
+// Why parse_cron_span() rejected a line
+typedef struct {
+    const char *reason; // static string
+    size_t column;      // byte offset in the line where parsing stopped
+} cron_parse_error;
+
+/**
+ * Parse the crontab line in line[0..len) in a single pass, without copying or
+ * allocating. Lines can be of any length and need not be NUL-terminated; a
+ * trailing "\r\n" is ignored. job->command points into `line`.
+ * @param error receives the reason on failure, may be NULL
+ * @return 0 on success, -1 if the line is not a valid cron entry
+ */
+int parse_cron_span(const char *line, size_t len, cron_job *job, cron_parse_error *error);
+
+// Parse a NUL-terminated line, logging why it was rejected. job->command is not NUL-terminated.
 int parse_cron_line(const char *line, cron_job *job);
 
 int time_matches(const cron_job *job, const struct tm *tm);
 
+// First local time strictly after `after` (at a minute boundary) that matches the job, or CRON_NEVER
+time_t next_fire_time(const cron_job *job, time_t after);
+
+void print_cron_job(const cron_job *job);
+
 #endif // CRONTAB_PARSER_H
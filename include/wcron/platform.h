@@ -0,0 +1,204 @@
+#ifndef WCRON_PLATFORM_H
+#define WCRON_PLATFORM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * Thin OS layer for the scheduler: threads, locks, waitable events and timers,
+ * an event loop, file change notification and child processes. platform_win32.c
+ * implements it with Win32 handles, platform_posix.c with pthreads, eventfd,
+ * timerfd, epoll, inotify and posix_spawn.
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef CRITICAL_SECTION wcron_mutex;
+typedef HANDLE wcron_sem;
+typedef HANDLE wcron_thread;
+typedef HANDLE wcron_handle; // anything a wcron_loop can wait on
+#define WCRON_NO_HANDLE NULL
+
+typedef struct {
+    HANDLE process;
+    unsigned long pid;
+} wcron_process;
+
+typedef struct {
+    void *data;
+    size_t size;
+    HANDLE file;
+    HANDLE mapping;
+} wcron_mapping;
+#else
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/types.h>
+
+typedef pthread_mutex_t wcron_mutex;
+typedef sem_t wcron_sem;
+typedef pthread_t wcron_thread;
+typedef int wcron_handle; // file descriptor
+#define WCRON_NO_HANDLE (-1)
+
+typedef struct {
+    pid_t pid;
+    int fd; // pidfd, -1 when the kernel has none
+} wcron_process;
+
+typedef struct {
+    void *data;
+    size_t size;
+} wcron_mapping;
+#endif
+
+typedef wcron_handle wcron_event; // manual-reset: stays signaled until wcron_event_reset()
+typedef wcron_handle wcron_timer;
+
+typedef void (*wcron_thread_fn)(void *arg);
+
+// Set of handles waited on together (epoll on POSIX; WaitForMultipleObjects on Windows, past 63 handles with a
+// helper thread for each further 63)
+typedef struct wcron_loop wcron_loop;
+
+// Change notification for one file (inotify on Linux, ReadDirectoryChangesW on Windows)
+typedef struct wcron_file_watch wcron_file_watch;
+
+void wcron_mutex_init(wcron_mutex *mutex);
+void wcron_mutex_lock(wcron_mutex *mutex);
+void wcron_mutex_unlock(wcron_mutex *mutex);
+void wcron_mutex_destroy(wcron_mutex *mutex);
+
+int wcron_sem_init(wcron_sem *sem, unsigned initial);
+void wcron_sem_post(wcron_sem *sem);
+void wcron_sem_wait(wcron_sem *sem);
+void wcron_sem_destroy(wcron_sem *sem);
+
+int wcron_thread_start(wcron_thread *thread, wcron_thread_fn fn, void *arg);
+int wcron_thread_start_detached(wcron_thread_fn fn, void *arg);
+void wcron_thread_join(wcron_thread thread);
+
+int wcron_event_create(wcron_event *event);
+void wcron_event_set(wcron_event event);
+void wcron_event_reset(wcron_event event);
+void wcron_event_destroy(wcron_event event);
+
+// One-shot timer on the wall clock, so it also fires on time across suspend
+int wcron_timer_create(wcron_timer *timer);
+// Fire at the absolute time `when` (immediately if it already passed)
+int wcron_timer_set_at(wcron_timer timer, time_t when);
+void wcron_timer_cancel(wcron_timer timer);
+// Fire once, ms milliseconds from now
+int wcron_timer_set_after(wcron_timer timer, unsigned ms);
+// Consume the expiry; returns 1 when the wall clock was set while the timer was armed
+int wcron_timer_ack(wcron_timer timer);
+void wcron_timer_destroy(wcron_timer timer);
+
+wcron_loop *wcron_loop_create(void);
+void wcron_loop_destroy(wcron_loop *loop);
+// Watch a handle for readiness; tag is handed back by wcron_loop_wait()
+int wcron_loop_add(wcron_loop *loop, wcron_handle handle, void *tag);
+void wcron_loop_remove(wcron_loop *loop, wcron_handle handle);
+// Block until one handle is ready: 1 with its tag, 0 on timeout, -1 on error; timeout_ms < 0 waits forever
+int wcron_loop_wait(wcron_loop *loop, int timeout_ms, void **tag);
+
+/**
+ * Watch path for writes, creation, deletion and renames onto it. The parent
+ * directory is watched, so an editor replacing the file by rename is seen too.
+ * @return the watch, or NULL if the platform refused it
+ */
+wcron_file_watch *wcron_file_watch_create(const char *path);
+// Handle that becomes ready when the directory changed
+wcron_handle wcron_file_watch_handle(const wcron_file_watch *watch);
+// Consume pending notifications; returns 1 if any of them was about the watched file
+int wcron_file_watch_ack(wcron_file_watch *watch);
+void wcron_file_watch_destroy(wcron_file_watch *watch);
+
+/**
+ * Start a command the way the platform runs cron jobs (CreateProcess on Windows, /bin/sh -c on POSIX)
+ * @param output Pipe or file the child's stdout and stderr go to, or WCRON_NO_HANDLE to leave them to the daemon's
+ */
+int wcron_spawn(const char *command, wcron_process *process, wcron_handle output);
+// Handle that becomes ready when the process exits (pidfd on Linux); -1 when there is none
+int wcron_process_handle(const wcron_process *process, wcron_handle *handle);
+// Block until the process exits and release it; exit_code gets 128+signal for killed POSIX children
+int wcron_process_wait(wcron_process *process, int *exit_code);
+// Release a process already reaped by wcron_child_reap(), without waiting
+void wcron_process_release(wcron_process *process);
+
+/**
+ * Exit notices for children that cannot be watched by their process handle (no pidfd before Linux 5.3): a handle
+ * that becomes ready when some child of the daemon may have exited. A SIGCHLD signalfd on POSIX, so SIGCHLD must be
+ * blocked in every thread; -1 on Windows, where every process has a handle.
+ */
+int wcron_child_watch_create(wcron_handle *watch);
+// Consume the pending notices, before reaping
+void wcron_child_watch_ack(wcron_handle watch);
+// Reap any one exited child without blocking: 1 with its pid and exit code (as wcron_process_wait()), 0 if none
+int wcron_child_reap(long *pid, int *exit_code);
+
+// Pipe for a child's output; the read end never blocks and can be watched by a wcron_loop.
+// -1 where pipes cannot be watched (Windows): give the child a file instead.
+int wcron_pipe_create(wcron_handle *read_end, wcron_handle *write_end);
+// Read what the pipe holds: bytes read, 0 at end of output (or on error), -1 when nothing is ready yet
+long wcron_pipe_read(wcron_handle pipe, void *buffer, size_t size);
+// Move up to size bytes from the pipe to the file's position, without a copy through user space where the
+// kernel can (splice on Linux); returns as wcron_pipe_read(), or -2 when writing the file failed
+long wcron_pipe_splice(wcron_handle pipe, wcron_handle file, size_t size);
+void wcron_handle_close(wcron_handle handle);
+
+// Open a file for reading and writing at its end, created if missing; the handle can be given to wcron_spawn()
+int wcron_file_open_append(const char *path, wcron_handle *file);
+int64_t wcron_file_size(wcron_handle file);
+// Read from offset, leaving the position alone: bytes read, -1 on error
+long wcron_file_read_at(wcron_handle file, int64_t offset, void *buffer, size_t size);
+// Write at the file's position: bytes written, -1 on error
+long wcron_file_write(wcron_handle file, const void *buffer, size_t size);
+// Cut the file to size and move the position there
+int wcron_file_truncate(wcron_handle file, int64_t size);
+// Create a directory; an existing one is fine
+int wcron_make_dir(const char *path);
+// Rename from over to, replacing it in one step where the platform can
+int wcron_file_replace(const char *from, const char *to);
+
+// Local control socket: a Unix domain socket on POSIX. Every call fails with -1 where there is none (Windows).
+// Listen at path, replacing a stale socket file there; only the owner may connect. The handle can be watched.
+// Fails with EADDRINUSE while another process accepts connections at path.
+int wcron_socket_listen(const char *path, wcron_handle *listener);
+// Take a pending connection without blocking: 0 with a non-blocking connection, -1 when there is none
+int wcron_socket_accept(wcron_handle listener, wcron_handle *conn);
+// Connect to the socket at path; the connection blocks
+int wcron_socket_connect(const char *path, wcron_handle *conn);
+// Returns as wcron_pipe_read()
+long wcron_socket_recv(wcron_handle conn, void *buffer, size_t size);
+// Send without blocking and without raising SIGPIPE: bytes sent, -1 on error or when the peer's buffer is full
+long wcron_socket_send(wcron_handle conn, const void *buffer, size_t size);
+
+int wcron_executable_path(char *buffer, size_t length);
+// Processors available to this process, at least 1
+int wcron_cpu_count(void);
+// Flush stdio buffers and force the file contents to disk
+int wcron_file_sync(FILE *fp);
+// Map a whole file read-only; an empty file maps to data == NULL, size == 0
+int wcron_map_file(const char *path, wcron_mapping *mapping);
+/**
+ * Map a file read-write and shared with every process mapping it, created if
+ * missing and grown to at least size bytes; it is never shrunk, so a reader
+ * holding an older, larger mapping cannot fault. Release with wcron_unmap_file().
+ */
+int wcron_map_shared(const char *path, size_t size, wcron_mapping *mapping);
+void wcron_unmap_file(wcron_mapping *mapping);
+long wcron_current_pid(void);
+uint64_t wcron_monotonic_ms(void);
+// Monotonic microseconds, for timing short operations
+uint64_t wcron_monotonic_us(void);
+// Milliseconds since boot, counting time suspended; never set, so the wall clock's drift from it shows clock changes
+uint64_t wcron_boot_ms(void);
+// Wall clock in milliseconds since the Unix epoch
+int64_t wcron_realtime_ms(void);
+void wcron_sleep_ms(unsigned ms);
+
+#endif // WCRON_PLATFORM_H
@@ -0,0 +1,22 @@
+#ifndef WCRON_PREVIEW_H
+#define WCRON_PREVIEW_H
+
+/**
+ * Schedule preview (`wcrontab next`): what the crontab will do, computed from
+ * the schedules alone. Fire times come from next_fire_time(), which jumps from
+ * match to match, never from probing minute by minute.
+ *
+ *   wcrontab next [--count N] [--job J] [--from TIME]
+ *       the next N (default 3) fire times of every job, or of job J
+ *   wcrontab next --histogram [--window 24h|7d] [--top K | --all] [--from TIME]
+ *       how many jobs fire in each minute of the window (default 24h): the K
+ *       busiest minutes (default 10), or every minute something fires
+ *
+ * TIME is local time, YYYY-MM-DD[ HH:MM[:SS]]; fire times after it count
+ * (default: now). --crontab FILE previews another file than the service's.
+ */
+
+// `next` with its options; returns the process exit code
+int preview_command(int argc, char *argv[]);
+
+#endif // WCRON_PREVIEW_H
@@ -1,12 +1,106 @@
 #ifndef WCRON_RUNNER_H
 #define WCRON_RUNNER_H
 
-#include <windows.h>
+#include "jobtable.h"
+#include "platform.h"
 
-extern HANDLE stop_event;
+extern wcron_event stop_event;
 
+// Called on the scheduler thread when a watched handle becomes ready
+typedef void (*scheduler_watch_fn)(wcron_handle handle, void *arg);
+
+typedef enum {
+    SCHEDULER_RELOAD_LOADED,    // the file's jobs are live
+    SCHEDULER_RELOAD_UNCHANGED, // the file still had the live table's content
+    SCHEDULER_RELOAD_FAILED     // the file could not be loaded, the jobs stay as they were
+} scheduler_reload_result;
+
+typedef struct {
+    unsigned seq; // number of the reload, counting from 1; 0 until the first one ends
+    scheduler_reload_result result;
+    int jobs;     // jobs live afterwards
+    int problems; // invalid or never firing lines in the live table's file
+    int unchanged;
+    int added;
+    int removed;
+} scheduler_reload_report;
+
+typedef void (*scheduler_reload_fn)(const scheduler_reload_report *report);
+
+typedef struct {
+    int paused;
+    time_t next_fire; // next deadline of the scheduler, CRON_NEVER if none
+    int runs;         // runs alive: held back, queued, starting or running
+} scheduler_status;
+
+typedef struct {
+    int job;             // index in the live table, -1 if a reload removed the job
+    uint64_t hash;       // line hash, the name of the job's output file
+    const char *command; // valid during the callback only
+    time_t scheduled;
+    int64_t started_ms; // wall clock, 0 until the process exists
+    long pid;
+    int catch_up;
+    int manual;
+} scheduler_run_info;
+
+typedef void (*scheduler_run_fn)(const scheduler_run_info *run, void *arg);
+
+// stop_event must exist before this is called
 void init_job_system(void);
-void __cdecl scheduler_thread(void *param);
+// Install a freshly loaded job table (taking its reference), keeping the state of unchanged jobs
+void replace_job_table(job_table *table);
+// Run the scheduler event loop until stop_event is set
+void scheduler_thread(void *param);
+
+// Add a handle to the scheduler loop; call before the loop starts or from the scheduler thread
+int scheduler_watch(wcron_handle handle, scheduler_watch_fn fn, void *arg);
+void scheduler_unwatch(wcron_handle handle);
+
+// Control channel, safe to call from any thread
+void scheduler_request_reload(void);
+void scheduler_pause(int pause);
+
+// The calls below are for handlers running on the scheduler thread (the control socket)
+
+// Reload now, or once the running reload ends; returns the seq of the reload whose report answers the request
+unsigned scheduler_reload(void);
+void scheduler_last_reload(scheduler_reload_report *report);
+// Called on the scheduler thread after every reload, however it was started
+void scheduler_on_reload(scheduler_reload_fn fn);
+// Pause or resume at once, not on the next loop turn like scheduler_pause()
+void scheduler_set_paused(int pause);
+// Start a run of job now, outside its schedule: 0 when it is queued, 1 if the job is running, -1 if there is none
+int scheduler_run_now(int job);
+void scheduler_get_status(scheduler_status *status);
+// Call fn for every run alive
+void scheduler_list_runs(scheduler_run_fn fn, void *arg);
 void shutdown_job_system(void);
 
+/**
+ * Simulation: the scheduling logic of the daemon driven by hand against a
+ * virtual clock, with no event loop, threads or processes. The driver installs
+ * its clock, calls scheduler_sim_init() instead of init_job_system(), loads a
+ * table with replace_job_table(), then moves its clock from deadline to
+ * deadline and calls scheduler_sim_tick() at each; admitted runs go to its
+ * spawn function and last until it calls scheduler_sim_finish().
+ */
+
+struct job_run;
+
+// Wall clock in milliseconds since the epoch
+typedef int64_t (*scheduler_clock_fn)(void);
+// A run starts at the clock's current time. Called with the job lock held: it must not call back into the scheduler.
+typedef void (*scheduler_spawn_fn)(struct job_run *run, const scheduler_run_info *info, void *arg);
+
+// Read the wall clock from clock instead of the system; call before anything else
+void scheduler_set_clock(scheduler_clock_fn clock);
+void scheduler_sim_init(scheduler_spawn_fn spawn, void *arg);
+// Next time the scheduler has work: a fire time, an indexed minute or a jitter release; CRON_NEVER if none
+time_t scheduler_next_deadline(void);
+// What the deadline timer does when it fires, at the clock's current time
+void scheduler_sim_tick(void);
+// The spawned run ended with exit_code at the clock's current time
+void scheduler_sim_finish(struct job_run *run, int exit_code);
+
 #endif // WCRON_RUNNER_H
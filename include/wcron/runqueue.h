@@ -0,0 +1,40 @@
+#ifndef WCRON_RUNQUEUE_H
+#define WCRON_RUNQUEUE_H
+
+#include <time.h>
+
+typedef struct {
+    time_t when; // next fire time
+    int job;     // index into the job table
+} runqueue_entry;
+
+/**
+ * Binary min-heap of jobs keyed by next fire time. pos[] maps a job index to
+ * its heap slot so a single job can be re-armed or removed in O(log n).
+ */
+typedef struct {
+    runqueue_entry *heap;
+    int count;
+    int capacity;
+
+    int *pos;         // heap slot per job index, -1 when not queued
+    int pos_capacity; // number of job indexes pos[] can hold
+} runqueue;
+
+int runqueue_init(runqueue *q, int job_capacity);
+void runqueue_free(runqueue *q);
+void runqueue_clear(runqueue *q);
+
+// Replace the whole queue with entries (one per job) in O(n)
+int runqueue_build(runqueue *q, const runqueue_entry *entries, int count);
+// Insert the job or move it to its new fire time
+int runqueue_update(runqueue *q, int job, time_t when);
+void runqueue_remove(runqueue *q, int job);
+
+// Fire time the job is queued for; 0 when it is not queued
+int runqueue_get(const runqueue *q, int job, time_t *when);
+// Earliest entry without removing it; 0 when the queue is empty
+int runqueue_peek(const runqueue *q, runqueue_entry *out);
+int runqueue_pop(runqueue *q, runqueue_entry *out);
+
+#endif // WCRON_RUNQUEUE_H
@@ -1,18 +1,21 @@
 #ifndef WCRON_SERVICE_H
 #define WCRON_SERVICE_H
 
-#include "parser.h"
-#include <windows.h>
+#include "jobtable.h"
+#include "log.h"
+#include <stddef.h>
+#include <time.h>
 
 #define WCRON_SERVICE_NAME "CronService"
-#define WCRON_MAX_JOBS 100
 #define WCRON_PATH_MAX_SIZE 1024
 #define WCRON_VERSION "0.0.2"
 
 #ifdef _WIN32
 #define DIRECTORY_SEPARATOR "\\"
+#define DIRECTORY_SEPARATOR_CHAR '\\'
 #else
 #define DIRECTORY_SEPARATOR "/"
+#define DIRECTORY_SEPARATOR_CHAR '/'
 #endif // DIRECTORY_SEPARATOR
 
 #define WCRON_SERVICE_SUFFIX " service"
@@ -21,18 +24,37 @@
 // Template when creating a new crontab file
 extern const char *DEFAULT_CRONTAB_TEMPLATE;
 
-void log_msg(const char *msg);
 void show_logs();
+// `logs` with filters: --job N, --since TIME, --failed, --tail N over the run journal
+int show_run_history(int argc, char *argv[]);
+// `output N`: print what job N wrote in its recent runs
+int show_job_output(int job);
 int __dirname(char *buffer, size_t length);
 int __filename(char *buffer, size_t length);
 int get_crontab_path(char *buffer, size_t size);
+int get_log_path(char *buffer, size_t size);
+int get_journal_path(char *buffer, size_t size);
+// Directory of the per-job output logs
+int get_output_dir(char *buffer, size_t size);
+// Directory of the Prometheus text file with the metrics
+int get_metrics_dir(char *buffer, size_t size);
+// Control socket of the running daemon
+int get_control_path(char *buffer, size_t size);
+// Shared-memory job status table
+int get_status_path(char *buffer, size_t size);
+/**
+ * Parse a local time: YYYY-MM-DD or YYYY-MM-DD HH:MM[:SS], 'T' also accepted as separator
+ * @return 1 if parsed, 0 otherwise
+ */
+int parse_local_time(const char *value, time_t *t);
+// Parse crontab.txt and install it as the live job table
+void load_jobs(void);
 
 // For edit cron expression in crontab file (secure)
 int open_editor_safely(const char *crontab_path);
 int create_default_crontab(const char *path);
 
-extern cron_job jobs[WCRON_MAX_JOBS];
-extern int job_count;
+extern job_table *crontab;
 extern int paused;
 
 void InstallService();
@@ -43,7 +65,7 @@ void PauseCronService();
 void ResumeCronService();
 void ReloadCronService();
 
-// The ServiceMain function is responsible for initializing the service and handling service control requests.
-void WINAPI ServiceMain(DWORD dwArgc, LPTSTR *lpszArgv);
+// Service entry point ("wcrontab service"): the SCM dispatcher on Windows, a foreground daemon on POSIX
+int run_service(void);
 
 #endif // WCRON_SERVICE_H
@@ -0,0 +1,30 @@
+#ifndef WCRON_SIMULATE_H
+#define WCRON_SIMULATE_H
+
+/**
+ * Scheduler simulation (`wcrontab simulate`): the daemon's scheduling logic
+ * run over a span of virtual time. The clock jumps from one deadline to the
+ * next instead of sleeping and no process is started, so a year of a large
+ * crontab takes seconds. Jitter and the running cap come from WCRON_JITTER and
+ * WCRON_MAX_RUNNING as in the daemon, local time (and so DST) from TZ.
+ *
+ * Every run start is printed on its own line, in the order the daemon would
+ * start them:
+ *
+ *   2026-03-29 03:00:00 #4 catch-up 2026-03-29 02:30 /usr/bin/backup
+ *
+ * i.e. start time, job number, scheduled or catch-up, the fire time the run
+ * belongs to, command. A summary with the tick cost goes to stderr.
+ *
+ *   --from TIME, --to TIME   span to simulate: fire times after --from, up to and including --to
+ *                            (local time, YYYY-MM-DD[ HH:MM[:SS]])
+ *   --crontab FILE           crontab to load instead of the service's
+ *   --run-time SECONDS       how long every run lasts (default 0)
+ *   --suspend FROM UNTIL     the scheduler sleeps through this span (repeatable), so catch-up kicks in
+ *   --quiet                  only the summary
+ */
+
+// `simulate` with its options; returns the process exit code
+int simulate_command(int argc, char *argv[]);
+
+#endif // WCRON_SIMULATE_H
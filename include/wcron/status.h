@@ -0,0 +1,91 @@
+#ifndef WCRON_STATUS_H
+#define WCRON_STATUS_H
+
+#include "jobtable.h"
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Live job status in shared memory: wcron.status, next to the executable,
+ * mapped by the daemon and by any reader. It holds one record per job of the
+ * live table, in crontab order, mirroring the cron_job fields (is_running,
+ * last_run) plus the next fire time and the outcome of the last run.
+ *
+ * Only the scheduler thread writes. Every record, and the header for changes
+ * of the layout, is guarded by a seqlock: the writer makes seq odd, updates,
+ * and makes it even again, so readers copy a record and retry when seq moved
+ * or was odd. Readers never block the scheduler and never wake it.
+ */
+
+#define STATUS_MAGIC 0x54534357u // "WCST"
+#define STATUS_VERSION 2
+#define STATUS_COMMAND_SIZE 64
+
+#define STATUS_STOPPED 0x01 // the daemon shut down; records show its last state
+#define STATUS_PAUSED 0x02
+
+#define STATUS_JOB_RUNNING 0x01 // cron_job.is_running: a run is queued or going
+#define STATUS_JOB_RAN 0x02     // last_exit and last_duration_ms hold a run
+
+// next_fire of jobs the scheduler evaluates minute by minute from its index instead of queueing them by fire time:
+// readers work it out from the record's copy of the schedule
+#define STATUS_NEXT_FROM_SCHEDULE (-2)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size; // offset of the first record
+    uint32_t record_size;
+    uint32_t seq;      // odd while the layout changes (a reload)
+    uint32_t flags;    // STATUS_STOPPED, STATUS_PAUSED
+    uint32_t capacity; // records the file has room for
+    uint32_t count;    // jobs in the live table
+    int64_t pid;
+    int64_t started_ms; // wall clock when the daemon started
+    int64_t reload_ms;  // wall clock when the live table was installed
+} status_header;
+
+typedef struct {
+    uint32_t seq; // odd while the record is written
+    uint32_t flags;
+    uint64_t hash;     // line hash, the name of the job's output file
+    int64_t last_run;  // fire time of the last finished run (cron_job.last_run), 0 if none
+    int64_t next_fire; // -1 if the schedule never fires again, or STATUS_NEXT_FROM_SCHEDULE
+    int64_t last_start_ms;
+    int32_t last_exit; // -1 if the last run could not start
+    uint32_t last_duration_ms;
+    uint64_t minutes; // the schedule, as in cron_job
+    uint32_t hours;
+    uint32_t days;
+    uint32_t months;
+    uint8_t daysofweek;
+    uint8_t schedule_flags;
+    char command[STATUS_COMMAND_SIZE]; // NUL-terminated, cut to fit
+} status_record;
+
+// Map the status file (creating or reusing it) and mark the daemon as started; -1 leaves status off
+int status_open(const char *path);
+// Mark the daemon as stopped and unmap
+void status_close(void);
+
+/**
+ * Lay the records out for a newly installed table. Jobs carried over keep the
+ * outcome of their last run and their next fire time from the previous layout.
+ * @param map For each job of table, its index in the previous table or -1; NULL if nothing is carried
+ */
+void status_reload(const job_table *table, const int *map);
+// Next fire time of a queued job, or STATUS_NEXT_FROM_SCHEDULE for an indexed one
+void status_set_next(int job, time_t next);
+void status_set_running(int job, int running);
+// A run of job ended: it no longer runs, last_run is the job's new value
+void status_run_finished(int job, time_t last_run, int exit_code, int64_t start_ms, uint32_t duration_ms);
+void status_set_paused(int paused);
+
+/**
+ * Reader side: print the status file at path as a table
+ * @return 0 on success, -1 if there is no usable status file, -2 if it kept
+ *         changing while being read
+ */
+int status_print(const char *path);
+
+#endif // WCRON_STATUS_H
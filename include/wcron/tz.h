@@ -0,0 +1,39 @@
+#ifndef WCRON_TZ_H
+#define WCRON_TZ_H
+
+#include <time.h>
+
+/**
+ * Local time service. The UTC offset of the local zone only changes at DST
+ * transitions, so instead of going through the C library's zone conversion
+ * (which serializes its callers on a lock) for every timestamp, conversions
+ * come from a small cache of spans of constant offset. A span is probed around
+ * the instant that missed the cache, up to four days either way, down to the
+ * exact second of a transition inside that range. Converting within a span is
+ * arithmetic, so the zone rules are consulted a few times every few days, plus
+ * a few dozen times around each transition.
+ *
+ * Safe to call from any thread: the spans are seqlocked, and a thread that
+ * finds one being written converts without the cache.
+ *
+ * Assumes, like cron daemons generally do, that no zone changes its offset
+ * twice within two days.
+ */
+
+// Broken-down local time of t; the replacement for localtime()
+void tz_localtime(time_t t, struct tm *out);
+// UTC offset at t in seconds, local time = t + offset
+long tz_offset(time_t t);
+
+/**
+ * Instants at which the local clock reads `civil` (local calendar fields
+ * counted as seconds since 1970-01-01 00:00, as if the zone were UTC)
+ * @param when Receives them in order. In a DST gap, when[0] is the instant the clock jumped past civil.
+ * @return 1 normally, 2 inside a DST overlap (the time happens twice), 0 inside a gap (it never happens)
+ */
+int tz_resolve(time_t civil, time_t when[2]);
+
+// First instant in (from, to] with another UTC offset than at from; (time_t)-1 if the offset does not change
+time_t tz_transition(time_t from, time_t to);
+
+#endif // WCRON_TZ_H
@@ -0,0 +1,444 @@
+#include "wcron/control.h"
+#include "wcron/log.h"
+#include "wcron/metrics.h"
+#include "wcron/platform.h"
+#include "wcron/runner.h"
+#include "wcron/service.h"
+#include "wcron/tz.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONTROL_PATH_MAX 1024
+#define CONTROL_CLIENTS 8
+#define CONTROL_REQUEST_MAX 256
+// A reply is built whole and sent at once; it fits the socket buffer, so sending never waits for the client
+#define CONTROL_REPLY_MAX (64 * 1024)
+// list-running stops listing when less than this is left of the reply
+#define CONTROL_LINE_ROOM 1024
+// A client that has not sent a whole request by then is hung up on, so idle connections cannot hold every slot
+#define CONTROL_IDLE_MS 5000
+
+typedef struct {
+    wcron_handle conn;
+    int used;
+    int waiting; // for the end of reload number reload_seq
+    unsigned reload_seq;
+    uint64_t accepted_ms; // monotonic
+    size_t len;
+    char request[CONTROL_REQUEST_MAX];
+} control_client;
+
+// Everything here belongs to the scheduler thread
+static control_client clients[CONTROL_CLIENTS];
+static wcron_handle listener = WCRON_NO_HANDLE;
+static wcron_timer idle_timer = WCRON_NO_HANDLE;
+static char socket_path[CONTROL_PATH_MAX];
+static uint64_t started_ms;
+
+static char reply[CONTROL_REPLY_MAX];
+static size_t reply_len;
+static int reply_full;
+
+static void reply_add(const char *format, ...) {
+    if (reply_full) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(reply + reply_len, sizeof(reply) - reply_len, format, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= sizeof(reply) - reply_len) {
+        reply[reply_len] = '\0'; // drop the part that fit
+        reply_full = 1;
+        return;
+    }
+    reply_len += (size_t)n;
+}
+
+static void reply_start(const char *status) {
+    reply_len = 0;
+    reply_full = 0;
+    reply_add("%s\n", status);
+}
+
+static void client_close(control_client *client) {
+    scheduler_unwatch(client->conn);
+    wcron_handle_close(client->conn);
+    client->used = 0;
+}
+
+// Send the reply built so far and hang up
+static void client_reply(control_client *client) {
+    if (wcron_socket_send(client->conn, reply, reply_len) != (long)reply_len) {
+        log_msg("Control client did not take its whole reply");
+    }
+    client_close(client);
+}
+
+static void format_time(time_t t, char *buffer, size_t size) {
+    struct tm tm;
+    tz_localtime(t, &tm);
+    strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+static void add_reload_report(const scheduler_reload_report *report) {
+    if (report->result == SCHEDULER_RELOAD_LOADED) {
+        reply_add("loaded %d jobs: %d unchanged, %d new, %d removed\n", report->jobs, report->unchanged,
+                  report->added, report->removed);
+    } else if (report->result == SCHEDULER_RELOAD_UNCHANGED) {
+        reply_add("crontab unchanged, %d jobs\n", report->jobs);
+    } else {
+        reply_add("crontab could not be loaded, keeping %d jobs\n", report->jobs);
+    }
+    if (report->problems > 0) {
+        reply_add("%d invalid or never firing line%s, see wcron.log\n", report->problems,
+                  report->problems == 1 ? "" : "s");
+    }
+}
+
+static void reply_reload(control_client *client, const scheduler_reload_report *report) {
+    reply_start(report->result == SCHEDULER_RELOAD_FAILED ? "error crontab could not be loaded" : "ok");
+    add_reload_report(report);
+    client_reply(client);
+}
+
+static void on_reload(const scheduler_reload_report *report) {
+    for (int i = 0; i < CONTROL_CLIENTS; i++) {
+        if (clients[i].used && clients[i].waiting && report->seq >= clients[i].reload_seq) {
+            reply_reload(&clients[i], report);
+        }
+    }
+}
+
+static void do_status(void) {
+    scheduler_status status;
+    scheduler_reload_report reload;
+    scheduler_get_status(&status);
+    scheduler_last_reload(&reload);
+
+    uint64_t up = (wcron_monotonic_ms() - started_ms) / 1000;
+    char next[32] = "none";
+    if (status.next_fire != CRON_NEVER) {
+        format_time(status.next_fire, next, sizeof(next));
+    }
+
+    reply_start("ok");
+    reply_add("version: %s\n", WCRON_VERSION);
+    reply_add("uptime: %llud %02lluh %02llum %02llus\n", (unsigned long long)(up / 86400),
+              (unsigned long long)(up / 3600 % 24), (unsigned long long)(up / 60 % 60), (unsigned long long)(up % 60));
+    reply_add("state: %s\n", status.paused ? "paused" : "running");
+    reply_add("jobs: %lld\n", (long long)metrics_gauge_value(METRIC_JOBS));
+    reply_add("running: %lld\n", (long long)metrics_gauge_value(METRIC_RUNNING));
+    reply_add("queued: %lld\n", (long long)metrics_gauge_value(METRIC_QUEUED));
+    reply_add("next deadline: %s\n", next);
+    reply_add("runs: %llu ok, %llu failed, %llu not started\n",
+              (unsigned long long)metrics_counter_value(METRIC_RUNS_OK),
+              (unsigned long long)metrics_counter_value(METRIC_RUNS_FAILED),
+              (unsigned long long)metrics_counter_value(METRIC_RUNS_NOT_STARTED));
+    reply_add("wakeups: %llu\n", (unsigned long long)metrics_counter_value(METRIC_WAKEUPS));
+    if (reload.seq == 0) {
+        reply_add("last reload: none\n");
+    } else {
+        reply_add("last reload: ");
+        add_reload_report(&reload);
+    }
+}
+
+typedef struct {
+    int listed;
+    int more; // past the size of a reply
+} run_list;
+
+static void add_run(const scheduler_run_info *run, void *arg) {
+    run_list *list = (run_list *)arg;
+    if (reply_len > sizeof(reply) - CONTROL_LINE_ROOM) {
+        list->more++;
+        return;
+    }
+
+    char scheduled[32];
+    format_time(run->scheduled, scheduled, sizeof(scheduled));
+    const char *kind = run->catch_up ? " (catch-up)" : run->manual ? " (manual)" : "";
+
+    if (run->job >= 0) {
+        reply_add("#%-5d ", run->job);
+    } else {
+        reply_add("%-6s ", "-");
+    }
+    if (run->started_ms) {
+        int64_t elapsed = (wcron_realtime_ms() - run->started_ms) / 1000;
+        reply_add("running for %llds, pid %ld, scheduled %s%s: %s\n", (long long)(elapsed > 0 ? elapsed : 0),
+                  run->pid, scheduled, kind, run->command);
+    } else {
+        reply_add("waiting to start, scheduled %s%s: %s\n", scheduled, kind, run->command);
+    }
+    list->listed++;
+}
+
+static void do_run_now(const char *arg) {
+    char *end;
+    long job = arg ? strtol(arg, &end, 10) : -1;
+    if (!arg || end == arg || *end != '\0') {
+        reply_start("error usage: run-now N");
+        return;
+    }
+
+    int r = scheduler_run_now(job < 0 || job > 0x7fffffff ? -1 : (int)job);
+    if (r < 0) {
+        reply_start("error no such job");
+    } else if (r > 0) {
+        reply_start("error the job is already running");
+    } else {
+        scheduler_status status;
+        scheduler_get_status(&status);
+        reply_start("ok");
+        reply_add("job #%ld %s\n", job, status.paused ? "starts when the service resumes" : "starting");
+    }
+}
+
+static void handle_request(control_client *client) {
+    char *line = client->request;
+    line[strcspn(line, "\r\n")] = '\0';
+    char *arg = strchr(line, ' ');
+    if (arg) {
+        *arg++ = '\0';
+    }
+
+    if (strcmp(line, "status") == 0) {
+        do_status();
+    } else if (strcmp(line, "reload") == 0) {
+        scheduler_reload_report report;
+        client->reload_seq = scheduler_reload();
+        scheduler_last_reload(&report);
+        if (report.seq < client->reload_seq) {
+            client->waiting = 1;
+            return;
+        }
+        reply_reload(client, &report);
+        return;
+    } else if (strcmp(line, "pause") == 0 || strcmp(line, "resume") == 0) {
+        scheduler_set_paused(line[0] == 'p');
+        reply_start("ok");
+        reply_add(line[0] == 'p' ? "paused\n" : "resumed\n");
+    } else if (strcmp(line, "run-now") == 0) {
+        do_run_now(arg);
+    } else if (strcmp(line, "list-running") == 0) {
+        run_list list = {0, 0};
+        reply_start("ok");
+        scheduler_list_runs(add_run, &list);
+        if (list.more > 0) {
+            reply_add("%d more runs not listed\n", list.more);
+        } else if (list.listed == 0) {
+            reply_add("no runs\n");
+        }
+    } else {
+        reply_start("error unknown request");
+    }
+    client_reply(client);
+}
+
+static void on_client(wcron_handle handle, void *arg) {
+    (void)handle;
+    control_client *client = (control_client *)arg;
+
+    if (client->waiting) {
+        // Only the end of the reload is expected; input now is junk, end of input a client that gave up
+        char junk[64];
+        if (wcron_socket_recv(client->conn, junk, sizeof(junk)) == 0) {
+            client_close(client);
+        }
+        return;
+    }
+
+    size_t room = sizeof(client->request) - 1 - client->len;
+    long n = wcron_socket_recv(client->conn, client->request + client->len, room);
+    if (n == 0) {
+        client_close(client);
+        return;
+    }
+    if (n < 0) {
+        return;
+    }
+
+    client->len += (size_t)n;
+    client->request[client->len] = '\0';
+    if (strchr(client->request, '\n')) {
+        handle_request(client);
+    } else if (client->len == sizeof(client->request) - 1) {
+        reply_start("error request too long");
+        client_reply(client);
+    }
+}
+
+// Point the idle timer at the first client still owing its request
+static void arm_idle_timer(void) {
+    if (idle_timer == WCRON_NO_HANDLE) {
+        return;
+    }
+    uint64_t first = 0;
+    for (int i = 0; i < CONTROL_CLIENTS; i++) {
+        if (clients[i].used && !clients[i].waiting && (first == 0 || clients[i].accepted_ms < first)) {
+            first = clients[i].accepted_ms;
+        }
+    }
+    if (first == 0) {
+        wcron_timer_cancel(idle_timer);
+        return;
+    }
+    uint64_t now = wcron_monotonic_ms();
+    uint64_t due = first + CONTROL_IDLE_MS;
+    // Never 0: that would disarm the timer
+    if (wcron_timer_set_after(idle_timer, due > now ? (unsigned)(due - now) : 1) != 0) {
+        log_msg("Failed to set control client timer");
+    }
+}
+
+static void on_idle(wcron_handle handle, void *arg) {
+    (void)arg;
+    wcron_timer_ack(handle);
+
+    uint64_t now = wcron_monotonic_ms();
+    for (int i = 0; i < CONTROL_CLIENTS; i++) {
+        if (clients[i].used && !clients[i].waiting && now - clients[i].accepted_ms >= CONTROL_IDLE_MS) {
+            reply_start("error request timed out");
+            client_reply(&clients[i]);
+        }
+    }
+    arm_idle_timer();
+}
+
+static void on_connect(wcron_handle handle, void *arg) {
+    (void)arg;
+    wcron_handle conn;
+
+    while (wcron_socket_accept(handle, &conn) == 0) {
+        control_client *client = NULL;
+        for (int i = 0; i < CONTROL_CLIENTS && !client; i++) {
+            if (!clients[i].used) {
+                client = &clients[i];
+            }
+        }
+        if (!client || scheduler_watch(conn, on_client, client) != 0) {
+            static const char busy[] = "error busy, try again\n";
+            wcron_socket_send(conn, busy, sizeof(busy) - 1);
+            wcron_handle_close(conn);
+            continue;
+        }
+
+        memset(client, 0, sizeof(*client));
+        client->conn = conn;
+        client->used = 1;
+        client->accepted_ms = wcron_monotonic_ms();
+    }
+    arm_idle_timer();
+}
+
+int control_start(const char *path) {
+    size_t len = strlen(path);
+    if (len >= sizeof(socket_path)) {
+        return -1;
+    }
+    if (wcron_socket_listen(path, &listener) != 0) {
+        char msg[CONTROL_PATH_MAX + 64];
+        if (errno == EADDRINUSE) {
+            snprintf(msg, sizeof(msg), "Control socket %s is in use, a service is already running there", path);
+        } else {
+            snprintf(msg, sizeof(msg), "Cannot listen on control socket %s", path);
+        }
+        log_msg(msg);
+        listener = WCRON_NO_HANDLE;
+        return -1;
+    }
+    if (scheduler_watch(listener, on_connect, NULL) != 0) {
+        log_msg("Failed to watch the control socket");
+        wcron_handle_close(listener);
+        remove(path);
+        listener = WCRON_NO_HANDLE;
+        return -1;
+    }
+
+    // Without the timer, clients are only ever dropped when they hang up
+    if (wcron_timer_create(&idle_timer) != 0) {
+        log_msg("Failed to create control client timer");
+        idle_timer = WCRON_NO_HANDLE;
+    } else if (scheduler_watch(idle_timer, on_idle, NULL) != 0) {
+        log_msg("Failed to watch control client timer");
+        wcron_timer_destroy(idle_timer);
+        idle_timer = WCRON_NO_HANDLE;
+    }
+
+    memcpy(socket_path, path, len + 1);
+    started_ms = wcron_monotonic_ms();
+    scheduler_on_reload(on_reload);
+    return 0;
+}
+
+void control_stop(void) {
+    if (listener == WCRON_NO_HANDLE) {
+        return;
+    }
+
+    scheduler_on_reload(NULL);
+    for (int i = 0; i < CONTROL_CLIENTS; i++) {
+        if (clients[i].used) {
+            reply_start("error service stopping");
+            client_reply(&clients[i]);
+        }
+    }
+    scheduler_unwatch(listener);
+    wcron_handle_close(listener);
+    listener = WCRON_NO_HANDLE;
+    if (idle_timer != WCRON_NO_HANDLE) {
+        scheduler_unwatch(idle_timer);
+        wcron_timer_destroy(idle_timer);
+        idle_timer = WCRON_NO_HANDLE;
+    }
+    remove(socket_path);
+}
+
+int control_request(const char *path, const char *request) {
+    wcron_handle conn;
+    if (wcron_socket_connect(path, &conn) != 0) {
+        return -1;
+    }
+
+    char line[CONTROL_REQUEST_MAX];
+    int len = snprintf(line, sizeof(line), "%s\n", request);
+    if (len <= 0 || len >= (int)sizeof(line) || wcron_socket_send(conn, line, (size_t)len) != len) {
+        wcron_handle_close(conn);
+        fprintf(stderr, "Error: Failed to send the request\n");
+        return 1;
+    }
+
+    char *buffer = malloc(CONTROL_REPLY_MAX + 1);
+    if (!buffer) {
+        wcron_handle_close(conn);
+        return 1;
+    }
+    size_t used = 0;
+    long n;
+    while (used < CONTROL_REPLY_MAX && (n = wcron_socket_recv(conn, buffer + used, CONTROL_REPLY_MAX - used)) > 0) {
+        used += (size_t)n;
+    }
+    wcron_handle_close(conn);
+    buffer[used] = '\0';
+
+    // First line is the status, the rest goes to the user as is
+    char *body = strchr(buffer, '\n');
+    if (body) {
+        *body++ = '\0';
+    } else {
+        body = buffer + used;
+    }
+    int r = 0;
+    if (strncmp(buffer, "ok", 2) != 0) {
+        fprintf(stderr, "Error: %s\n", strncmp(buffer, "error ", 6) == 0 ? buffer + 6 : "no reply from the service");
+        r = 1;
+    }
+    fputs(body, stdout);
+    free(buffer);
+    return r;
+}
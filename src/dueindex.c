@@ -0,0 +1,208 @@
+#include "wcron/dueindex.h"
+#include <stdlib.h>
+#include <string.h>
+
+// First bitset of each field inside due_index.bits
+#define SET_MINUTE 0
+#define SET_HOUR 60
+#define SET_MDAY 84
+#define SET_MONTH 115
+#define SET_WDAY 127
+#define SET_BOTH_RESTRICTED 134
+
+static uint64_t *bitset(const due_index *index, int set) {
+    return index->bits + (size_t)set * index->words;
+}
+
+// Re-lay the bitsets out for a larger capacity; existing bits keep their slots
+static int grow(due_index *index, int capacity) {
+    size_t words = ((size_t)capacity + 63) / 64;
+    if (words <= index->words) {
+        return 0;
+    }
+
+    uint64_t *bits = calloc(words * DUE_INDEX_SETS, sizeof(uint64_t));
+    uint64_t *due = calloc(words, sizeof(uint64_t));
+    int *slot_job = malloc(sizeof(int) * words * 64);
+    int *free_slots = malloc(sizeof(int) * words * 64);
+    if (!bits || !due || !slot_job || !free_slots) {
+        free(bits);
+        free(due);
+        free(slot_job);
+        free(free_slots);
+        return -1;
+    }
+
+    for (int set = 0; set < DUE_INDEX_SETS; set++) {
+        if (index->words) {
+            memcpy(bits + (size_t)set * words, bitset(index, set), index->words * sizeof(uint64_t));
+        }
+    }
+    if (index->capacity) {
+        memcpy(slot_job, index->slot_job, sizeof(int) * (size_t)index->capacity);
+        memcpy(free_slots, index->free_slots, sizeof(int) * (size_t)index->free_count);
+    }
+    for (size_t i = (size_t)index->capacity; i < words * 64; i++) {
+        slot_job[i] = -1;
+    }
+
+    free(index->bits);
+    free(index->due);
+    free(index->slot_job);
+    free(index->free_slots);
+    index->bits = bits;
+    index->due = due;
+    index->slot_job = slot_job;
+    index->free_slots = free_slots;
+    index->words = words;
+    index->capacity = (int)(words * 64);
+    return 0;
+}
+
+int due_index_init(due_index *index, int capacity) {
+    memset(index, 0, sizeof(*index));
+    return grow(index, capacity > 0 ? capacity : 64);
+}
+
+void due_index_free(due_index *index) {
+    free(index->bits);
+    free(index->due);
+    free(index->slot_job);
+    free(index->free_slots);
+    memset(index, 0, sizeof(*index));
+}
+
+void due_index_clear(due_index *index) {
+    memset(index->bits, 0, index->words * DUE_INDEX_SETS * sizeof(uint64_t));
+    for (int i = 0; i < index->capacity; i++) {
+        index->slot_job[i] = -1;
+    }
+    index->free_count = 0;
+    index->used = 0;
+    index->members = 0;
+    memset(index->minute_refs, 0, sizeof(index->minute_refs));
+    memset(index->hour_refs, 0, sizeof(index->hour_refs));
+    memset(index->mday_refs, 0, sizeof(index->mday_refs));
+    memset(index->month_refs, 0, sizeof(index->month_refs));
+    memset(index->wday_refs, 0, sizeof(index->wday_refs));
+}
+
+int due_index_wants(const cron_job *job) {
+    // Evaluating every minute the clock shows suits jobs following the clock across DST; fixed times need the
+    // gap and overlap rules of next_fire_time()
+    if ((job->flags & CRON_NEVER_FIRES) || !(job->flags & CRON_TIME_WILDCARD)) {
+        return 0;
+    }
+    return __builtin_popcountll(job->minutes) * __builtin_popcount(job->hours) >= 24;
+}
+
+// Set or clear the slot's bit in every bitset the job's schedule allows, keeping the per-value counts
+static void apply(due_index *index, int slot, const cron_job *job, int add) {
+    size_t word = (size_t)slot / 64;
+    uint64_t bit = (uint64_t)1 << (slot % 64);
+    int delta = add ? 1 : -1;
+
+#define APPLY(set, mask, count, refs, shift)                                                                           \
+    for (int v = 0; v < (count); v++) {                                                                                \
+        if ((mask) >> (v + (shift)) & 1) {                                                                             \
+            uint64_t *w = bitset(index, (set) + v) + word;                                                             \
+            *w = add ? *w | bit : *w & ~bit;                                                                           \
+            (refs)[v] += delta;                                                                                        \
+        }                                                                                                              \
+    }
+
+    APPLY(SET_MINUTE, job->minutes, 60, index->minute_refs, 0)
+    APPLY(SET_HOUR, (uint64_t)job->hours, 24, index->hour_refs, 0)
+    APPLY(SET_MDAY, (uint64_t)job->days, 31, index->mday_refs, 1)
+    APPLY(SET_MONTH, (uint64_t)job->months, 12, index->month_refs, 0)
+    APPLY(SET_WDAY, (uint64_t)job->daysofweek, 7, index->wday_refs, 0)
+#undef APPLY
+
+    // Both day fields restricted: the job fires when either matches
+    if ((job->flags & (CRON_DOM_WILDCARD | CRON_DOW_WILDCARD)) == 0) {
+        uint64_t *w = bitset(index, SET_BOTH_RESTRICTED) + word;
+        *w = add ? *w | bit : *w & ~bit;
+    }
+}
+
+int due_index_add(due_index *index, const cron_job *job, int job_index) {
+    int slot;
+    if (index->free_count > 0) {
+        slot = index->free_slots[--index->free_count];
+    } else {
+        if (index->used == index->capacity && grow(index, index->capacity * 2) != 0) {
+            return -1;
+        }
+        slot = index->used++;
+    }
+
+    apply(index, slot, job, 1);
+    index->slot_job[slot] = job_index;
+    index->members++;
+    return slot;
+}
+
+void due_index_remove(due_index *index, int slot, const cron_job *job) {
+    apply(index, slot, job, 0);
+    index->slot_job[slot] = -1;
+    index->free_slots[index->free_count++] = slot;
+    index->members--;
+}
+
+void due_index_move(due_index *index, int slot, int job_index) {
+    index->slot_job[slot] = job_index;
+}
+
+int due_index_eval(due_index *index, const struct tm *tm) {
+    const uint64_t *restrict minute = bitset(index, SET_MINUTE + tm->tm_min);
+    const uint64_t *restrict hour = bitset(index, SET_HOUR + tm->tm_hour);
+    const uint64_t *restrict mday = bitset(index, SET_MDAY + tm->tm_mday - 1);
+    const uint64_t *restrict month = bitset(index, SET_MONTH + tm->tm_mon);
+    const uint64_t *restrict wday = bitset(index, SET_WDAY + tm->tm_wday);
+    const uint64_t *restrict both = bitset(index, SET_BOTH_RESTRICTED);
+    uint64_t *restrict due = index->due;
+    size_t words = ((size_t)index->used + 63) / 64;
+
+    // Straight-line word loop so the compiler can vectorize it. A wildcard day
+    // field has every bit set, so AND applies the other field alone; jobs with
+    // both fields restricted take the OR instead.
+    for (size_t i = 0; i < words; i++) {
+        uint64_t day = (mday[i] & wday[i]) | (both[i] & (mday[i] | wday[i]));
+        due[i] = minute[i] & hour[i] & month[i] & day;
+    }
+
+    int count = 0;
+    for (size_t i = 0; i < words; i++) {
+        count += __builtin_popcountll(due[i]);
+    }
+    return count;
+}
+
+time_t due_index_next(const due_index *index, time_t after) {
+    if (index->members == 0) {
+        return CRON_NEVER;
+    }
+
+    // Union of the members' schedules; with the day fields OR'ed it fires
+    // whenever any member does, and possibly more often
+    cron_job summary;
+    memset(&summary, 0, sizeof(summary));
+    summary.flags = CRON_TIME_WILDCARD;
+    for (int v = 0; v < 60; v++) {
+        summary.minutes |= (uint64_t)(index->minute_refs[v] > 0) << v;
+    }
+    for (int v = 0; v < 24; v++) {
+        summary.hours |= (uint32_t)(index->hour_refs[v] > 0) << v;
+    }
+    for (int v = 0; v < 31; v++) {
+        summary.days |= (uint32_t)(index->mday_refs[v] > 0) << (v + 1);
+    }
+    for (int v = 0; v < 12; v++) {
+        summary.months |= (uint32_t)(index->month_refs[v] > 0) << v;
+    }
+    for (int v = 0; v < 7; v++) {
+        summary.daysofweek |= (uint8_t)((index->wday_refs[v] > 0) << v);
+    }
+
+    return next_fire_time(&summary, after);
+}
@@ -0,0 +1,494 @@
+#include "wcron/jobtable.h"
+#include "wcron/log.h"
+#include "wcron/platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+// Invalid lines logged per load; a broken generated crontab would otherwise flood the log
+#define MAX_REPORTED_ERRORS 10
+
+// Big crontabs are parsed in parallel, in newline-aligned chunks of at least this many bytes
+#define PARSE_CHUNK_MIN (256 * 1024)
+#define MAX_PARSE_CHUNKS 64
+
+// Catch-up runs a WCRON_CATCHUP=all job makes up for one gap unless WCRON_CATCHUP_MAX says otherwise
+#define CATCHUP_MAX_DEFAULT 10
+
+// A rejected or never firing line, numbered within its chunk until the chunks are merged
+typedef struct {
+    int line;
+    cron_parse_error error; // reason NULL: the schedule never fires
+} parse_note;
+
+typedef struct {
+    char *begin;
+    char *end;
+    cron_job *jobs;   // output slots, max_jobs of them
+    uint64_t *hashes; // line hash of each job
+    size_t max_jobs;
+    size_t count;
+
+    int lines;
+    int problems; // notes, including the ones that did not fit
+    int noted;
+    parse_note notes[MAX_REPORTED_ERRORS];
+
+    // Catch-up settings in force, and how many jobs came before the chunk's first line setting each;
+    // those jobs follow the previous chunk's settings instead
+    uint8_t catchup;
+    uint8_t catchup_max;
+    size_t catchup_from;
+    size_t catchup_max_from;
+    int catchup_set;
+    int catchup_max_set;
+} parse_chunk;
+
+static int parse_threads; // 0: one per CPU
+
+static void add_note(parse_chunk *chunk, const cron_parse_error *error) {
+    chunk->problems++;
+    if (chunk->noted < MAX_REPORTED_ERRORS) {
+        chunk->notes[chunk->noted].line = chunk->lines;
+        chunk->notes[chunk->noted].error = *error;
+        chunk->noted++;
+    }
+}
+
+static void report_note(const parse_note *note, int line_base) {
+    char msg[160];
+    if (note->error.reason) {
+        snprintf(msg, sizeof(msg), "crontab line %d, column %lu: %s", line_base + note->line,
+                 (unsigned long)note->error.column + 1, note->error.reason);
+    } else {
+        snprintf(msg, sizeof(msg), "crontab line %d: schedule never fires (no valid date)", line_base + note->line);
+    }
+    log_msg(msg);
+}
+
+static uint64_t line_hash(const char *line, size_t len) {
+    if (len > 0 && line[len - 1] == '\r') {
+        len--;
+    }
+
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)line[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * Hash of the whole file, eight bytes per step: it runs before the parse can be
+ * split across threads, so a byte-wise FNV would dominate big loads. The shift
+ * folds high bits back down, which a plain multiply never does.
+ */
+static uint64_t content_hash(const char *data, size_t size) {
+    uint64_t hash = FNV_OFFSET ^ size;
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * FNV_PRIME;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// Length of `name` if the text at p..end starts with it followed by '=' or a blank, else 0
+static size_t setting_name(const char *p, const char *end, const char *name) {
+    size_t len = strlen(name);
+    if ((size_t)(end - p) <= len || memcmp(p, name, len) != 0) {
+        return 0;
+    }
+    return p[len] == '=' || p[len] == ' ' || p[len] == '\t' ? len : 0;
+}
+
+static int setting_fail(cron_parse_error *error, const char *line, const char *at, const char *reason) {
+    error->reason = reason;
+    error->column = (size_t)(at - line);
+    return -1;
+}
+
+/**
+ * Apply a WCRON_CATCHUP=skip|once|all or WCRON_CATCHUP_MAX=N line to the jobs below it.
+ * @param first First non-blank character of the line
+ * @return 1 if the line is not a setting, 0 if it was applied, -1 if it is invalid
+ */
+static int parse_setting(parse_chunk *chunk, const char *line, const char *first, const char *eol,
+                         cron_parse_error *error) {
+    if ((size_t)(eol - first) < 6 || memcmp(first, "WCRON_", 6) != 0) {
+        return 1;
+    }
+
+    const char *end = eol;
+    while (end > first && (end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+
+    int is_max = 0;
+    size_t name = setting_name(first, end, "WCRON_CATCHUP_MAX");
+    if (name) {
+        is_max = 1;
+    } else if (!(name = setting_name(first, end, "WCRON_CATCHUP"))) {
+        return setting_fail(error, line, first, "unknown setting (WCRON_CATCHUP and WCRON_CATCHUP_MAX are known)");
+    }
+
+    const char *p = first + name;
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    if (p == end || *p != '=') {
+        return setting_fail(error, line, p, "expected '=' after the setting name");
+    }
+    p++;
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    size_t len = (size_t)(end - p);
+
+    if (is_max) {
+        int value = 0;
+        for (const char *q = p; q < end; q++) {
+            if (*q < '0' || *q > '9' || (value = value * 10 + (*q - '0')) > 255) {
+                value = 0;
+                break;
+            }
+        }
+        if (value < 1) {
+            return setting_fail(error, line, p, "WCRON_CATCHUP_MAX must be a number from 1 to 255");
+        }
+        if (!chunk->catchup_max_set) {
+            chunk->catchup_max_from = chunk->count;
+            chunk->catchup_max_set = 1;
+        }
+        chunk->catchup_max = (uint8_t)value;
+        return 0;
+    }
+
+    uint8_t policy;
+    if (len == 4 && memcmp(p, "skip", 4) == 0) {
+        policy = 0;
+    } else if (len == 4 && memcmp(p, "once", 4) == 0) {
+        policy = CRON_CATCHUP_ONCE;
+    } else if (len == 3 && memcmp(p, "all", 3) == 0) {
+        policy = CRON_CATCHUP_ALL;
+    } else {
+        return setting_fail(error, line, p, "WCRON_CATCHUP must be skip, once or all");
+    }
+    if (!chunk->catchup_set) {
+        chunk->catchup_from = chunk->count;
+        chunk->catchup_set = 1;
+    }
+    chunk->catchup = policy;
+    return 0;
+}
+
+// Parse one chunk: every line in [begin, end), in one forward pass, wherever it lies and whatever its length
+static void parse_chunk_run(void *param) {
+    parse_chunk *chunk = (parse_chunk *)param;
+    char *p = chunk->begin;
+    char *end = chunk->end;
+    // Commands are compacted towards the chunk start; a chunk never writes outside its own text
+    size_t used = 0;
+
+    while (p < end) {
+        char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) {
+            eol = end;
+        }
+        size_t len = (size_t)(eol - p);
+        chunk->lines++;
+
+        const char *first = p;
+        while (first < eol && (*first == ' ' || *first == '\t')) {
+            first++;
+        }
+
+        // Skip comments and empty lines
+        if (first < eol && *first != '#' && *first != '\r' && chunk->count < chunk->max_jobs) {
+            cron_job *job = &chunk->jobs[chunk->count];
+            cron_parse_error error;
+            int setting = parse_setting(chunk, p, first, eol, &error);
+
+            // A valid setting line is applied and produces no job
+            if (setting > 0 && parse_cron_span(p, len, job, &error) == 0) {
+                job->flags |= chunk->catchup;
+                job->catchup_max = chunk->catchup_max;
+                chunk->hashes[chunk->count] = line_hash(p, len);
+                if (job->flags & CRON_NEVER_FIRES) {
+                    error.reason = NULL;
+                    error.column = 0;
+                    add_note(chunk, &error);
+                }
+
+                // The command never moves forward, and its terminator lands at or before this line's newline
+                memmove(chunk->begin + used, job->command, job->command_len);
+                job->command = chunk->begin + used;
+                chunk->begin[used + job->command_len] = '\0';
+                used += job->command_len + 1;
+                chunk->count++;
+            } else if (setting != 0) {
+                add_note(chunk, &error);
+            }
+        }
+
+        p = eol + 1;
+    }
+}
+
+static int parse_chunk_count(size_t size) {
+    int threads = parse_threads > 0 ? parse_threads : wcron_cpu_count();
+    size_t by_size = size / PARSE_CHUNK_MIN;
+
+    if ((size_t)threads > by_size) {
+        threads = (int)by_size;
+    }
+    if (threads > MAX_PARSE_CHUNKS) {
+        threads = MAX_PARSE_CHUNKS;
+    }
+    return threads > 1 ? threads : 1;
+}
+
+// Same bytes as current: hand current back instead of the table being built
+static job_table *reuse_current(job_table *table, job_table *current) {
+    free(table->block);
+    free(table);
+    job_table_acquire(current);
+    return current;
+}
+
+job_table *job_table_load(const char *path, job_table *current) {
+    job_table *table = calloc(1, sizeof(job_table));
+    if (!table) {
+        log_msg("Failed to allocate job table");
+        return NULL;
+    }
+    table->refs = 1;
+    table->content_hash = content_hash(NULL, 0);
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        if (current && current->content_size == 0 && current->content_hash == table->content_hash) {
+            return reuse_current(table, current);
+        }
+        return table;
+    }
+
+    long file_size = -1;
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        file_size = ftell(fp);
+    }
+    if (file_size < 0 || fseek(fp, 0, SEEK_SET) != 0) {
+        log_msg("Failed to get crontab size");
+        fclose(fp);
+        free(table);
+        return NULL;
+    }
+
+    // Size the job array from the byte count so jobs and text fit in one allocation:
+    // the shortest valid line, "* * * * * x", takes 11 bytes plus its newline, and
+    // each chunk may round its share up by one
+    size_t size = (size_t)file_size;
+    int chunk_count = parse_chunk_count(size);
+    size_t max_jobs = size / 11 + (size_t)chunk_count;
+    size_t jobs_bytes = max_jobs * sizeof(cron_job);
+    size_t hashes_bytes = max_jobs * sizeof(uint64_t);
+
+    parse_chunk *chunks = calloc((size_t)chunk_count, sizeof(parse_chunk));
+    char *block = chunks ? malloc(jobs_bytes + hashes_bytes + size + 1) : NULL;
+    if (!block) {
+        log_msg("Failed to allocate job table");
+        fclose(fp);
+        free(chunks);
+        free(table);
+        return NULL;
+    }
+
+    cron_job *jobs = (cron_job *)block;
+    uint64_t *hashes = (uint64_t *)(block + jobs_bytes);
+    char *strings = block + jobs_bytes + hashes_bytes;
+    size_t read = fread(strings, 1, size, fp);
+    fclose(fp);
+    strings[read] = '\0';
+
+    table->block = block;
+    table->content_size = read;
+    table->content_hash = content_hash(strings, read);
+    if (current && current->content_size == read && current->content_hash == table->content_hash) {
+        free(chunks);
+        return reuse_current(table, current);
+    }
+
+    // Cut the text at newlines into chunks of about equal size, each with its own output slots
+    char *begin = strings;
+    char *end = strings + read;
+    size_t slot = 0;
+    for (int c = 0; c < chunk_count; c++) {
+        char *stop = end;
+        if (c < chunk_count - 1) {
+            stop = strings + read / (size_t)chunk_count * (size_t)(c + 1);
+            stop = stop < begin ? begin : stop;
+            char *eol = memchr(stop, '\n', (size_t)(end - stop));
+            stop = eol ? eol + 1 : end;
+        }
+
+        chunks[c].begin = begin;
+        chunks[c].end = stop;
+        chunks[c].jobs = jobs + slot;
+        chunks[c].hashes = hashes + slot;
+        chunks[c].max_jobs = (size_t)(stop - begin) / 11 + 1;
+        chunks[c].catchup_max = CATCHUP_MAX_DEFAULT;
+        slot += chunks[c].max_jobs;
+        begin = stop;
+    }
+
+    // The calling thread takes the first chunk; a chunk whose thread fails to start runs here too
+    wcron_thread threads[MAX_PARSE_CHUNKS];
+    int started[MAX_PARSE_CHUNKS] = {0};
+    for (int c = 1; c < chunk_count; c++) {
+        started[c] = wcron_thread_start(&threads[c], parse_chunk_run, &chunks[c]) == 0;
+    }
+    parse_chunk_run(&chunks[0]);
+    for (int c = 1; c < chunk_count; c++) {
+        if (started[c]) {
+            wcron_thread_join(threads[c]);
+        } else {
+            parse_chunk_run(&chunks[c]);
+        }
+    }
+
+    // Merge in file order: slide each chunk's jobs down behind the previous ones
+    size_t count = 0;
+    int line_base = 0;
+    int reported = 0;
+    int problems = 0;
+    uint8_t catchup = 0;
+    uint8_t catchup_max = CATCHUP_MAX_DEFAULT;
+    for (int c = 0; c < chunk_count; c++) {
+        parse_chunk *chunk = &chunks[c];
+
+        memmove(jobs + count, chunk->jobs, chunk->count * sizeof(cron_job));
+        memmove(hashes + count, chunk->hashes, chunk->count * sizeof(uint64_t));
+
+        // Settings from earlier chunks reach the jobs above this chunk's own
+        size_t upto = chunk->catchup_set ? chunk->catchup_from : chunk->count;
+        for (size_t i = 0; catchup != 0 && i < upto; i++) {
+            jobs[count + i].flags = (uint8_t)((jobs[count + i].flags & ~CRON_CATCHUP_MASK) | catchup);
+        }
+        upto = chunk->catchup_max_set ? chunk->catchup_max_from : chunk->count;
+        for (size_t i = 0; catchup_max != CATCHUP_MAX_DEFAULT && i < upto; i++) {
+            jobs[count + i].catchup_max = catchup_max;
+        }
+        if (chunk->catchup_set) {
+            catchup = chunk->catchup;
+        }
+        if (chunk->catchup_max_set) {
+            catchup_max = chunk->catchup_max;
+        }
+        count += chunk->count;
+
+        for (int i = 0; i < chunk->noted && reported < MAX_REPORTED_ERRORS; i++, reported++) {
+            report_note(&chunk->notes[i], line_base);
+        }
+        problems += chunk->problems;
+        line_base += chunk->lines;
+    }
+    free(chunks);
+
+    if (problems > reported) {
+        char msg[96];
+        snprintf(msg, sizeof(msg), "crontab: %d more invalid or never firing lines not listed", problems - reported);
+        log_msg(msg);
+    }
+
+    table->jobs = jobs;
+    table->count = (int)count;
+    table->problems = problems;
+    table->hashes = hashes;
+    table->strings = strings;
+    table->strings_size = read + 1;
+    return table;
+}
+
+void job_table_set_threads(int threads) {
+    parse_threads = threads > 0 ? threads : 0;
+}
+
+void job_table_acquire(job_table *table) {
+    __atomic_fetch_add(&table->refs, 1, __ATOMIC_RELAXED);
+}
+
+void job_table_release(job_table *table) {
+    while (table && __atomic_sub_fetch(&table->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        job_table *successor = table->successor;
+        free(table->forward);
+        free(table->block);
+        free(table);
+        table = successor;
+    }
+}
+
+static int same_job(const cron_job *a, const cron_job *b) {
+    return a->minutes == b->minutes && a->hours == b->hours && a->days == b->days && a->months == b->months &&
+           a->daysofweek == b->daysofweek && a->flags == b->flags && a->catchup_max == b->catchup_max &&
+           a->command_len == b->command_len &&
+           memcmp(a->command, b->command, a->command_len) == 0;
+}
+
+int job_table_match(const job_table *prev, const job_table *next, int *map) {
+    for (int i = 0; i < next->count; i++) {
+        map[i] = -1;
+    }
+    if (prev->count == 0 || next->count == 0) {
+        return 0;
+    }
+
+    // Open-addressing index of prev by line hash; slots hold index + 1
+    size_t capacity = 16;
+    while (capacity < (size_t)prev->count * 2) {
+        capacity <<= 1;
+    }
+    int *slots = calloc(capacity, sizeof(int));
+    unsigned char *taken = calloc((size_t)prev->count, 1);
+    if (!slots || !taken) {
+        log_msg("Failed to allocate reload index, treating every job as new");
+        free(slots);
+        free(taken);
+        return 0;
+    }
+
+    size_t mask = capacity - 1;
+    for (int j = 0; j < prev->count; j++) {
+        size_t slot = (size_t)prev->hashes[j] & mask;
+        while (slots[slot]) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = j + 1;
+    }
+
+    int matched = 0;
+    for (int i = 0; i < next->count; i++) {
+        // Identical lines pair up in order, each old job at most once
+        for (size_t slot = (size_t)next->hashes[i] & mask; slots[slot]; slot = (slot + 1) & mask) {
+            int j = slots[slot] - 1;
+            if (!taken[j] && prev->hashes[j] == next->hashes[i] && same_job(&prev->jobs[j], &next->jobs[i])) {
+                taken[j] = 1;
+                map[i] = j;
+                matched++;
+                break;
+            }
+        }
+    }
+
+    free(slots);
+    free(taken);
+    return matched;
+}
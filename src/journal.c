@@ -0,0 +1,412 @@
+#include "wcron/journal.h"
+#include "wcron/log.h"
+#include "wcron/platform.h"
+#include "wcron/tz.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JOURNAL_VERSION 2
+#define JOURNAL_PATH_MAX 1024
+
+// 64-bit offsets: journals grow past 2 GB
+#ifdef _WIN32
+#define journal_seek _fseeki64
+#define journal_tell _ftelli64
+#else
+#define journal_seek fseeko
+#define journal_tell ftello
+#endif
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t stride; // index only
+} journal_header;
+
+// Entry k (0-based) is written at record (k + 1) * JOURNAL_INDEX_STRIDE and sums up block k, the stride before it
+typedef struct {
+    int64_t max_end_ms; // latest end_ms among all earlier records
+    uint64_t record;
+    uint32_t failed; // runs of the block with JOURNAL_RUN_FAILED
+    uint32_t reserved;
+    uint8_t jobs[JOURNAL_JOB_BITS / 8]; // bit job_hash % JOURNAL_JOB_BITS of every run in the block
+} journal_index_entry;
+
+static FILE *journal_file;
+static FILE *index_file;
+static uint64_t record_count;
+static uint64_t index_count;
+static int64_t max_end_ms;
+
+// Summary of the block being appended to, written out with the next index entry
+static uint8_t block_jobs[JOURNAL_JOB_BITS / 8];
+static uint32_t block_failed;
+
+static int header_matches(const journal_header *h, const char *magic, uint32_t entry_size, uint32_t stride) {
+    return memcmp(h->magic, magic, 4) == 0 && h->version == JOURNAL_VERSION && h->entry_size == entry_size &&
+           h->stride == stride;
+}
+
+// Open an existing file after checking its header, or create it; *entries gets the complete entries
+static FILE *open_table(const char *path, const char *magic, uint32_t entry_size, uint32_t stride, uint64_t *entries) {
+    journal_header header;
+    FILE *fp = fopen(path, "r+b");
+
+    if (fp) {
+        if (fread(&header, sizeof(header), 1, fp) != 1 || !header_matches(&header, magic, entry_size, stride)) {
+            fclose(fp);
+            return NULL;
+        }
+        journal_seek(fp, 0, SEEK_END);
+        int64_t size = (int64_t)journal_tell(fp);
+        *entries = (uint64_t)(size - (int64_t)sizeof(header)) / entry_size;
+        return fp;
+    }
+
+    fp = fopen(path, "w+b");
+    if (!fp) {
+        return NULL;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, 4);
+    header.version = JOURNAL_VERSION;
+    header.entry_size = entry_size;
+    header.stride = stride;
+    if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+        fclose(fp);
+        return NULL;
+    }
+    *entries = 0;
+    return fp;
+}
+
+static int has_job_bit(const uint8_t *jobs, uint64_t job_hash) {
+    unsigned bit = (unsigned)(job_hash % JOURNAL_JOB_BITS);
+    return (jobs[bit / 8] >> (bit % 8)) & 1;
+}
+
+static void block_add(const journal_record *record) {
+    unsigned bit = (unsigned)(record->job_hash % JOURNAL_JOB_BITS);
+    block_jobs[bit / 8] |= (uint8_t)(1u << (bit % 8));
+    if (record->flags & JOURNAL_RUN_FAILED) {
+        block_failed++;
+    }
+    if (record->end_ms > max_end_ms) {
+        max_end_ms = record->end_ms;
+    }
+}
+
+static int write_index_entry(uint64_t record) {
+    journal_index_entry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.max_end_ms = max_end_ms;
+    entry.record = record;
+    entry.failed = block_failed;
+    memcpy(entry.jobs, block_jobs, sizeof(entry.jobs));
+    // The next block starts empty even if this write failed
+    memset(block_jobs, 0, sizeof(block_jobs));
+    block_failed = 0;
+
+    journal_seek(index_file, (int64_t)sizeof(journal_header) + (int64_t)(index_count * sizeof(entry)), SEEK_SET);
+    if (fwrite(&entry, sizeof(entry), 1, index_file) != 1 || fflush(index_file) != 0) {
+        return -1;
+    }
+    index_count++;
+    return 0;
+}
+
+// Bring the index up to date with the records, e.g. after a crash between the two writes
+static void repair_index(void) {
+    uint64_t expected = record_count > 0 ? (record_count - 1) / JOURNAL_INDEX_STRIDE : 0;
+    if (index_count > expected) {
+        index_count = expected;
+    }
+
+    max_end_ms = INT64_MIN;
+    if (index_count > 0) {
+        journal_index_entry last;
+        journal_seek(index_file,
+                     (int64_t)sizeof(journal_header) + (int64_t)((index_count - 1) * sizeof(journal_index_entry)),
+                     SEEK_SET);
+        if (fread(&last, sizeof(last), 1, index_file) == 1) {
+            max_end_ms = last.max_end_ms;
+        } else {
+            index_count = 0;
+        }
+    }
+
+    memset(block_jobs, 0, sizeof(block_jobs));
+    block_failed = 0;
+    uint64_t n = index_count * JOURNAL_INDEX_STRIDE;
+    journal_seek(journal_file, (int64_t)sizeof(journal_header) + (int64_t)(n * sizeof(journal_record)), SEEK_SET);
+
+    journal_record record;
+    for (; n < record_count && fread(&record, sizeof(record), 1, journal_file) == 1; n++) {
+        if (n > 0 && n % JOURNAL_INDEX_STRIDE == 0 && n / JOURNAL_INDEX_STRIDE > index_count) {
+            write_index_entry(n);
+        }
+        block_add(&record);
+    }
+}
+
+// Move a journal that cannot be opened as this version aside, so the service keeps a history
+static int move_aside(const char *path) {
+    char old_path[JOURNAL_PATH_MAX];
+    int r = snprintf(old_path, sizeof(old_path), "%s.old", path);
+    if (r <= 0 || r >= (int)sizeof(old_path)) {
+        return -1;
+    }
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return -1;
+    }
+    fclose(fp);
+
+    remove(old_path);
+    if (rename(path, old_path) != 0) {
+        return -1;
+    }
+    char msg[JOURNAL_PATH_MAX + 64];
+    snprintf(msg, sizeof(msg), "Run journal has another format, moved to %s", old_path);
+    log_msg(msg);
+    return 0;
+}
+
+int journal_open(const char *path) {
+    char index_path[JOURNAL_PATH_MAX];
+    int r = snprintf(index_path, sizeof(index_path), "%s.idx", path);
+    if (r <= 0 || r >= (int)sizeof(index_path)) {
+        return -1;
+    }
+
+    journal_file = open_table(path, "WCRJ", sizeof(journal_record), 0, &record_count);
+    if (!journal_file && move_aside(path) == 0) {
+        journal_file = open_table(path, "WCRJ", sizeof(journal_record), 0, &record_count);
+    }
+    if (!journal_file) {
+        log_msg("Failed to open run journal");
+        return -1;
+    }
+
+    index_file = open_table(index_path, "WCRI", sizeof(journal_index_entry), JOURNAL_INDEX_STRIDE, &index_count);
+    if (!index_file) {
+        // The index is derived data: start it over
+        remove(index_path);
+        index_file = open_table(index_path, "WCRI", sizeof(journal_index_entry), JOURNAL_INDEX_STRIDE, &index_count);
+    }
+    if (!index_file) {
+        log_msg("Failed to open run journal index");
+        fclose(journal_file);
+        journal_file = NULL;
+        return -1;
+    }
+
+    repair_index();
+
+    // A torn record at the end is overwritten by the next append
+    journal_seek(journal_file, (int64_t)sizeof(journal_header) + (int64_t)(record_count * sizeof(journal_record)),
+                 SEEK_SET);
+    return 0;
+}
+
+int journal_append(const journal_record *record) {
+    if (!journal_file) {
+        return -1;
+    }
+
+    if (record_count > 0 && record_count % JOURNAL_INDEX_STRIDE == 0) {
+        write_index_entry(record_count);
+    }
+
+    if (fwrite(record, sizeof(*record), 1, journal_file) != 1 || fflush(journal_file) != 0) {
+        // Put the position back on a record boundary
+        journal_seek(journal_file,
+                     (int64_t)sizeof(journal_header) + (int64_t)(record_count * sizeof(journal_record)), SEEK_SET);
+        return -1;
+    }
+
+    record_count++;
+    block_add(record);
+    return 0;
+}
+
+void journal_close(void) {
+    if (journal_file) {
+        fclose(journal_file);
+        journal_file = NULL;
+    }
+    if (index_file) {
+        fclose(index_file);
+        index_file = NULL;
+    }
+}
+
+static int record_matches(const journal_record *record, const journal_query *query) {
+    if (query->by_job && record->job_hash != query->job_hash) {
+        return 0;
+    }
+    if (query->since_ms && record->start_ms < query->since_ms) {
+        return 0;
+    }
+    if (query->failed_only && !(record->flags & JOURNAL_RUN_FAILED)) {
+        return 0;
+    }
+    return 1;
+}
+
+// Whether the block an index entry sums up can hold a run matching query
+static int block_may_match(const journal_index_entry *entry, const journal_query *query) {
+    if (query->failed_only && entry->failed == 0) {
+        return 0;
+    }
+    return !query->by_job || has_job_bit(entry->jobs, query->job_hash);
+}
+
+/**
+ * Map the index of the journal at path and check it against the count records
+ * of the journal.
+ * @return entries of the complete blocks (*blocks of them), NULL without a usable index
+ */
+static const journal_index_entry *map_index(const char *path, uint64_t count, wcron_mapping *map, uint64_t *blocks) {
+    char index_path[JOURNAL_PATH_MAX];
+    int r = snprintf(index_path, sizeof(index_path), "%s.idx", path);
+    if (r <= 0 || r >= (int)sizeof(index_path) || wcron_map_file(index_path, map) != 0) {
+        return NULL;
+    }
+    if (map->size < sizeof(journal_header) ||
+        !header_matches(map->data, "WCRI", sizeof(journal_index_entry), JOURNAL_INDEX_STRIDE)) {
+        wcron_unmap_file(map);
+        return NULL;
+    }
+
+    const journal_index_entry *entries =
+        (const journal_index_entry *)((const char *)map->data + sizeof(journal_header));
+    uint64_t n = (map->size - sizeof(journal_header)) / sizeof(journal_index_entry);
+    // Entries past the records belong to a journal that was cut short
+    while (n > 0 && entries[n - 1].record > count) {
+        n--;
+    }
+    *blocks = n;
+    return entries;
+}
+
+// First record that can have started at or after since_ms
+static uint64_t first_candidate(const journal_index_entry *entries, uint64_t blocks, int64_t since_ms) {
+    // max_end_ms only grows, so find the last entry whose earlier records all ended before since_ms
+    uint64_t lo = 0, hi = blocks;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (entries[mid].max_end_ms < since_ms) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo > 0 ? entries[lo - 1].record : 0;
+}
+
+static void print_record(const journal_record *record) {
+    char scheduled[32], started[32];
+    struct tm tm;
+
+    tz_localtime((time_t)record->scheduled, &tm);
+    strftime(scheduled, sizeof(scheduled), "%Y-%m-%d %H:%M", &tm);
+    tz_localtime((time_t)(record->start_ms / 1000), &tm);
+    strftime(started, sizeof(started), "%Y-%m-%d %H:%M:%S", &tm);
+
+    if (!(record->flags & JOURNAL_RUN_STARTED)) {
+        printf("%-16s  %s.%03d  %6lu ms  %9s  %5s  #%-5d not started\n", scheduled, started,
+               (int)(record->start_ms % 1000), (unsigned long)record->queue_ms, "-", "-", record->job);
+        return;
+    }
+
+    // How much of the queueing was spent waiting for a WCRON_MAX_RUNNING slot
+    char waited[32] = "";
+    if (record->wait_ms > 0) {
+        snprintf(waited, sizeof(waited), " (waited %lu ms)", (unsigned long)record->wait_ms);
+    }
+    const char *kind = (record->flags & JOURNAL_RUN_CATCHUP)  ? " (catch-up)"
+                       : (record->flags & JOURNAL_RUN_MANUAL) ? " (manual)"
+                                                              : "";
+    printf("%-16s  %s.%03d  %6lu ms  %6lu ms  %5d  #%-5d %s%s%s\n", scheduled, started,
+           (int)(record->start_ms % 1000), (unsigned long)record->queue_ms, (unsigned long)record->duration_ms,
+           record->exit_code, record->job, (record->flags & JOURNAL_RUN_FAILED) ? "failed" : "ok", kind, waited);
+}
+
+long journal_print(const char *path, const journal_query *query) {
+    wcron_mapping map;
+    if (wcron_map_file(path, &map) != 0) {
+        return -1;
+    }
+    if (map.size < sizeof(journal_header) || !header_matches(map.data, "WCRJ", sizeof(journal_record), 0)) {
+        wcron_unmap_file(&map);
+        return -1;
+    }
+
+    const journal_record *records = (const journal_record *)((const char *)map.data + sizeof(journal_header));
+    uint64_t count = (map.size - sizeof(journal_header)) / sizeof(journal_record);
+
+    // Without an index every block is a candidate; the records after the last entry always are
+    wcron_mapping index_map;
+    uint64_t blocks = 0;
+    const journal_index_entry *entries = map_index(path, count, &index_map, &blocks);
+    uint64_t first = entries && query->since_ms ? first_candidate(entries, blocks, query->since_ms) : 0;
+    long printed = 0;
+
+    printf("%-16s  %-23s  %9s  %9s  %5s  %-6s %s\n", "SCHEDULED", "STARTED", "QUEUED", "DURATION", "EXIT", "JOB",
+           "STATUS");
+
+    if (query->tail > 0) {
+        // Walk back from the newest record and stop once enough runs matched
+        uint64_t limit = (uint64_t)query->tail < count ? (uint64_t)query->tail : count;
+        uint64_t *hits = malloc((limit > 0 ? limit : 1) * sizeof(uint64_t));
+        if (!hits) {
+            if (entries) {
+                wcron_unmap_file(&index_map);
+            }
+            wcron_unmap_file(&map);
+            return -1;
+        }
+
+        uint64_t found = 0;
+        uint64_t n = count;
+        while (n > first && found < limit) {
+            uint64_t block = (n - 1) / JOURNAL_INDEX_STRIDE;
+            if (block < blocks && !block_may_match(&entries[block], query)) {
+                n = block * JOURNAL_INDEX_STRIDE;
+                continue;
+            }
+            if (record_matches(&records[n - 1], query)) {
+                hits[found++] = n - 1;
+            }
+            n--;
+        }
+        while (found > 0) {
+            print_record(&records[hits[--found]]);
+            printed++;
+        }
+        free(hits);
+    } else {
+        uint64_t n = first;
+        while (n < count) {
+            uint64_t block = n / JOURNAL_INDEX_STRIDE;
+            if (block < blocks && !block_may_match(&entries[block], query)) {
+                n = (block + 1) * JOURNAL_INDEX_STRIDE;
+                continue;
+            }
+            if (record_matches(&records[n], query)) {
+                print_record(&records[n]);
+                printed++;
+            }
+            n++;
+        }
+    }
+
+    if (entries) {
+        wcron_unmap_file(&index_map);
+    }
+    wcron_unmap_file(&map);
+    return printed;
+}
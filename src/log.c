@@ -0,0 +1,306 @@
+#include "wcron/log.h"
+#include "wcron/platform.h"
+#include "wcron/tz.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LOG_PATH_MAX 1024
+#define LOG_SLOT_SIZE 512
+#define LOG_BATCH_SIZE (64 * 1024)
+#define LOG_DEFAULT_FLUSH_MS 50
+#define LOG_DEFAULT_RING 2048
+
+/**
+ * One preformatted line. seq follows the bounded MPSC ring protocol: a slot is
+ * free for the producer that claims position p when seq == p, and ready for
+ * the writer when seq == p + 1.
+ */
+typedef struct {
+    size_t seq;
+    size_t len;
+    char text[LOG_SLOT_SIZE - 2 * sizeof(size_t)];
+} log_slot;
+
+static char log_path[LOG_PATH_MAX];
+
+static log_slot *ring;
+static size_t ring_mask;
+static size_t enqueue_pos; // shared by producers
+static size_t dequeue_pos; // advanced by the writer, read by producers
+static size_t dropped;
+static int producers; // log_msg() calls inside the ring, so log_stop() can wait them out
+
+static log_config writer_config;
+static FILE *writer_file;
+static wcron_thread writer;
+static wcron_loop *writer_loop;
+static wcron_event writer_wake;
+static int writer_sleeping;
+static int writer_stopping;
+static int started;
+
+static size_t format_line(char *buffer, size_t size, const char *msg) {
+    struct tm tm;
+    // Not time(): the coarse clock can stamp a job started on the minute with the second before it
+    tz_localtime((time_t)(wcron_realtime_ms() / 1000), &tm);
+
+    int n = snprintf(buffer, size, "[%04d-%02d-%02d %02d:%02d:%02d] %s\n", tm.tm_year + 1900, tm.tm_mon + 1,
+                     tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, msg);
+    if (n < 0) {
+        return 0;
+    }
+    if ((size_t)n >= size) {
+        // Truncated: keep the line terminated
+        n = (int)size - 1;
+        buffer[n - 1] = '\n';
+    }
+    return (size_t)n;
+}
+
+void log_config_defaults(log_config *config) {
+    config->flush_interval_ms = LOG_DEFAULT_FLUSH_MS;
+    config->fsync_policy = LOG_FSYNC_NEVER;
+    config->ring_records = LOG_DEFAULT_RING;
+
+    const char *value = getenv("WCRON_LOG_FLUSH_MS");
+    if (value && *value) {
+        config->flush_interval_ms = (unsigned)strtoul(value, NULL, 10);
+    }
+
+    value = getenv("WCRON_LOG_FSYNC");
+    if (value && strcmp(value, "flush") == 0) {
+        config->fsync_policy = LOG_FSYNC_FLUSH;
+    }
+
+    value = getenv("WCRON_LOG_RING");
+    if (value && *value) {
+        config->ring_records = (unsigned)strtoul(value, NULL, 10);
+    }
+}
+
+int log_set_path(const char *path) {
+    size_t len = strlen(path);
+    if (len >= sizeof(log_path)) {
+        return -1;
+    }
+    memcpy(log_path, path, len + 1);
+    return 0;
+}
+
+// Synchronous append, used before the writer starts and after it stops
+static void log_write_direct(const char *msg) {
+    if (!log_path[0]) {
+        return;
+    }
+
+    FILE *f = fopen(log_path, "a");
+    if (!f)
+        return;
+
+    char line[LOG_SLOT_SIZE];
+    size_t len = format_line(line, sizeof(line), msg);
+    fwrite(line, 1, len, f);
+    fclose(f);
+}
+
+void log_msg(const char *msg) {
+    __atomic_fetch_add(&producers, 1, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&started, __ATOMIC_SEQ_CST)) {
+        __atomic_fetch_sub(&producers, 1, __ATOMIC_RELEASE);
+        log_write_direct(msg);
+        return;
+    }
+
+    size_t pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+    log_slot *slot;
+
+    while (1) {
+        slot = &ring[pos & ring_mask];
+        size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Ring full: drop rather than wait for the disk, and make sure the writer is up
+            if (__atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED) == 0) {
+                wcron_event_set(writer_wake);
+            }
+            __atomic_fetch_sub(&producers, 1, __ATOMIC_RELEASE);
+            return;
+        } else {
+            pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->len = format_line(slot->text, sizeof(slot->text), msg);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    if (__atomic_exchange_n(&writer_sleeping, 0, __ATOMIC_SEQ_CST)) {
+        wcron_event_set(writer_wake);
+    } else if (pos - __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED) == (ring_mask + 1) / 2) {
+        // Half full: cut the writer's flush interval short
+        wcron_event_set(writer_wake);
+    }
+    __atomic_fetch_sub(&producers, 1, __ATOMIC_RELEASE);
+}
+
+static int ring_has_records(void) {
+    log_slot *slot = &ring[dequeue_pos & ring_mask];
+    return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == dequeue_pos + 1;
+}
+
+// Move ready records into batch, releasing their slots; returns the bytes copied
+static size_t drain_ring(char *batch, size_t size) {
+    size_t used = 0;
+
+    while (1) {
+        log_slot *slot = &ring[dequeue_pos & ring_mask];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != dequeue_pos + 1 || used + slot->len > size) {
+            break;
+        }
+
+        memcpy(batch + used, slot->text, slot->len);
+        used += slot->len;
+        __atomic_store_n(&slot->seq, dequeue_pos + ring_mask + 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&dequeue_pos, dequeue_pos + 1, __ATOMIC_RELAXED);
+    }
+
+    size_t lost = __atomic_exchange_n(&dropped, 0, __ATOMIC_RELAXED);
+    if (lost > 0) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "Log ring full, dropped %lu messages", (unsigned long)lost);
+        if (used + LOG_SLOT_SIZE <= size) {
+            used += format_line(batch + used, LOG_SLOT_SIZE, msg);
+        } else {
+            __atomic_fetch_add(&dropped, lost, __ATOMIC_RELAXED);
+        }
+    }
+    return used;
+}
+
+static void writer_thread(void *param) {
+    (void)param;
+    char *batch = malloc(LOG_BATCH_SIZE);
+    if (!batch) {
+        return;
+    }
+
+    while (1) {
+        size_t len = drain_ring(batch, LOG_BATCH_SIZE);
+        if (len > 0) {
+            // One write per batch
+            fwrite(batch, 1, len, writer_file);
+            if (writer_config.fsync_policy == LOG_FSYNC_FLUSH) {
+                wcron_file_sync(writer_file);
+            }
+            continue;
+        }
+
+        if (__atomic_load_n(&writer_stopping, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        // Announce the sleep before the last check so a producer cannot slip in unseen
+        __atomic_store_n(&writer_sleeping, 1, __ATOMIC_SEQ_CST);
+        if (ring_has_records() || __atomic_load_n(&writer_stopping, __ATOMIC_ACQUIRE)) {
+            __atomic_store_n(&writer_sleeping, 0, __ATOMIC_SEQ_CST);
+            continue;
+        }
+
+        void *tag;
+        wcron_loop_wait(writer_loop, -1, &tag);
+        wcron_event_reset(writer_wake);
+
+        // Let a burst accumulate so it goes out in one write, unless the ring fills up first
+        size_t pending = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED) - dequeue_pos;
+        if (writer_config.flush_interval_ms > 0 && pending < (ring_mask + 1) / 2 &&
+            !__atomic_load_n(&writer_stopping, __ATOMIC_ACQUIRE)) {
+            if (wcron_loop_wait(writer_loop, (int)writer_config.flush_interval_ms, &tag) > 0) {
+                wcron_event_reset(writer_wake);
+            }
+        }
+    }
+
+    free(batch);
+}
+
+int log_start(const log_config *config) {
+    if (started || !log_path[0]) {
+        return -1;
+    }
+
+    writer_config = *config;
+    size_t capacity = 2;
+    while (capacity < writer_config.ring_records) {
+        capacity <<= 1;
+    }
+
+    ring = malloc(capacity * sizeof(log_slot));
+    if (!ring) {
+        return -1;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        ring[i].seq = i;
+    }
+    ring_mask = capacity - 1;
+    enqueue_pos = 0;
+    dequeue_pos = 0;
+    dropped = 0;
+    writer_sleeping = 0;
+    writer_stopping = 0;
+
+    writer_file = fopen(log_path, "a");
+    if (!writer_file) {
+        free(ring);
+        return -1;
+    }
+    // The batch is the buffer: each fwrite becomes a single write
+    setvbuf(writer_file, NULL, _IONBF, 0);
+
+    writer_loop = wcron_loop_create();
+    if (!writer_loop || wcron_event_create(&writer_wake) != 0) {
+        wcron_loop_destroy(writer_loop);
+        fclose(writer_file);
+        free(ring);
+        return -1;
+    }
+    wcron_loop_add(writer_loop, writer_wake, NULL);
+
+    if (wcron_thread_start(&writer, writer_thread, NULL) != 0) {
+        wcron_loop_destroy(writer_loop);
+        wcron_event_destroy(writer_wake);
+        fclose(writer_file);
+        free(ring);
+        return -1;
+    }
+
+    __atomic_store_n(&started, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void log_stop(void) {
+    if (!started) {
+        return;
+    }
+
+    // New messages go back to direct appends; wait for the ones already in the ring
+    __atomic_store_n(&started, 0, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&producers, __ATOMIC_ACQUIRE) > 0) {
+        wcron_sleep_ms(1);
+    }
+
+    __atomic_store_n(&writer_stopping, 1, __ATOMIC_RELEASE);
+    wcron_event_set(writer_wake);
+    wcron_thread_join(writer);
+
+    fclose(writer_file);
+    wcron_loop_destroy(writer_loop);
+    wcron_event_destroy(writer_wake);
+    free(ring);
+    ring = NULL;
+}
@@ -1,52 +1,65 @@
+#include "wcron/control.h"
+#include "wcron/preview.h"
 #include "wcron/service.h"
-#include <fcntl.h>
-#include <io.h>
+#include "wcron/simulate.h"
+#include "wcron/status.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <windows.h>
 
 int main(int argc, char *argv[]) {
+    char log_path[WCRON_PATH_MAX_SIZE];
+    if (get_log_path(log_path, sizeof(log_path))) {
+        log_set_path(log_path);
+    }
+
     // Run as service if "service" is passed
     if (argc == 2 && strcmp(argv[1], "service") == 0) {
-        SERVICE_TABLE_ENTRY st[] = {{WCRON_SERVICE_NAME, ServiceMain}, {NULL, NULL}};
-        if (!StartServiceCtrlDispatcher(st)) {
-            fprintf(stderr, "Failed to start service (error %lu)\n", GetLastError());
-            return 1;
-        }
-
-        return 0;
+        return run_service();
     }
 
     // Check for version command first
     if (argc == 2 && (strcmp(argv[1], "-v") == 0 || strcmp(argv[1], "--version") == 0)) {
-        wprintf(L"wCron version %hs\n", WCRON_VERSION);
+        printf("wCron version %s\n", WCRON_VERSION);
         return 0;
     }
 
     // user commands when no arguments are provided or help is requested
     if (argc < 2 || strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
-        wprintf(L"wCron version %hs\n", WCRON_VERSION);
-        wprintf(L"Usage: wcrontab -l|-e|-r|install|uninstall|start|stop|pause|resume|reload|logs|version\n");
-        wprintf(L"\nOptions:\n");
-        wprintf(L"  -l, --list    List current crontab\n");
-        wprintf(L"  -e, --edit    Edit crontab\n");
-        wprintf(L"  -r, --remove  Remove crontab\n");
-        wprintf(L"  -v, --version Show version information\n");
-        wprintf(L"  -h, --help    Show this help message\n");
-        wprintf(L"\nService commands:\n");
-        wprintf(L"  install     Install wcron service\n");
-        wprintf(L"  uninstall   Uninstall wcron service\n");
-        wprintf(L"  start       Start wcron service\n");
-        wprintf(L"  stop        Stop wcron service\n");
-        wprintf(L"  pause       Pause wcron service\n");
-        wprintf(L"  resume      Resume wcron service\n");
-        wprintf(L"  reload      Reload crontab configuration\n");
-        wprintf(L"  logs        Show wcron log file\n");
+        printf("wCron version %s\n", WCRON_VERSION);
+        printf("Usage: wcrontab -l|-e|-r|install|uninstall|start|stop|pause|resume|reload|logs|output|status|ctl|"
+               "next|simulate|version\n");
+        printf("\nOptions:\n");
+        printf("  -l, --list    List current crontab\n");
+        printf("  -e, --edit    Edit crontab\n");
+        printf("  -r, --remove  Remove crontab\n");
+        printf("  -v, --version Show version information\n");
+        printf("  -h, --help    Show this help message\n");
+        printf("\nService commands:\n");
+        printf("  install     Install wcron service\n");
+        printf("  uninstall   Uninstall wcron service\n");
+        printf("  start       Start wcron service\n");
+        printf("  stop        Stop wcron service\n");
+        printf("  pause       Pause wcron service\n");
+        printf("  resume      Resume wcron service\n");
+        printf("  reload      Reload crontab configuration\n");
+        printf("  logs        Show wcron log file\n");
+        printf("  logs [--job N] [--since TIME] [--failed] [--tail N]\n");
+        printf("              Query the run history (TIME: YYYY-MM-DD[ HH:MM] or an age like 12h, 7d)\n");
+        printf("  output N    Show what job N printed in its recent runs\n");
+        printf("  status      Show every job's state, last run and next fire time, without asking the service\n");
+        printf("  ctl REQUEST Ask the running service: status, reload, pause, resume, run-now N, list-running\n");
+        printf("  next [--count N] [--job J] [--from TIME]\n");
+        printf("              Show the next fire times of every job\n");
+        printf("  next --histogram [--window 24h|7d] [--top K | --all] [--from TIME]\n");
+        printf("              Show how many jobs fire in each minute, busiest first\n");
+        printf("  simulate --from TIME --to TIME [--crontab FILE] [--run-time SECONDS] [--suspend FROM UNTIL]...\n");
+        printf("              Print every run the scheduler would start over that span, in virtual time\n");
         return 0;
     }
 
     char *cmd = argv[1];
-    char crontab_path[MAX_PATH];
+    char crontab_path[WCRON_PATH_MAX_SIZE];
 
     if (!get_crontab_path(crontab_path, sizeof(crontab_path))) {
         fprintf(stderr, "Error: Failed to get crontab path\n");
@@ -62,8 +75,8 @@ int main(int argc, char *argv[]) {
                 fprintf(stderr, "Error: Failed to create crontab file\n");
                 return 1;
             }
-            wprintf(L"No crontab found. Created new crontab with template.\n");
-            wprintf(L"Use 'wcrontab -e' to edit it.\n");
+            printf("No crontab found. Created new crontab with template.\n");
+            printf("Use 'wcrontab -e' to edit it.\n");
             return 0;
         }
 
@@ -71,13 +84,13 @@ int main(int argc, char *argv[]) {
         char buf[1024];
         int has_content = 0;
         while (fgets(buf, sizeof(buf), fp) != NULL) {
-            wprintf(L"%hs", buf);
+            printf("%s", buf);
             has_content = 1;
         }
         fclose(fp);
 
         if (!has_content) {
-            wprintf(L"(empty crontab)\n");
+            printf("(empty crontab)\n");
         }
 
         // Open editor safely
@@ -90,7 +103,7 @@ int main(int argc, char *argv[]) {
                 fprintf(stderr, "Error: Failed to create crontab file\n");
                 return 1;
             }
-            wprintf(L"Created new crontab with template.\n");
+            printf("Created new crontab with template.\n");
         } else {
             fclose(fp);
         }
@@ -100,7 +113,7 @@ int main(int argc, char *argv[]) {
             return 1;
         }
 
-        printf("Crontab updated. Use 'wcrontab reload' to apply changes.\n");
+        printf("Crontab updated. A running service picks up the changes automatically.\n");
 
         // delete crontab (-r)
     } else if (strcmp(cmd, "-r") == 0) {
@@ -118,7 +131,7 @@ int main(int argc, char *argv[]) {
         }
         printf("Crontab removed successfully.\n");
 
-        // WIN32 SERVICE MANAGEMENT
+        // SERVICE MANAGEMENT
     } else if (strcmp(cmd, "install") == 0) {
         printf("Installing wcron service...\n");
         InstallService();
@@ -148,10 +161,59 @@ int main(int argc, char *argv[]) {
         ReloadCronService();
 
     } else if (strcmp(cmd, "logs") == 0) {
+        if (argc > 2) {
+            return show_run_history(argc - 2, argv + 2);
+        }
         show_logs();
 
+    } else if (strcmp(cmd, "output") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "Usage: wcrontab output N\n");
+            return 1;
+        }
+        return show_job_output(atoi(argv[2]));
+
+    } else if (strcmp(cmd, "status") == 0) {
+        char status_path[WCRON_PATH_MAX_SIZE];
+        int r = get_status_path(status_path, sizeof(status_path)) ? status_print(status_path) : -1;
+        if (r == -1) {
+            printf("No job status found. Is the service running?\n");
+        }
+        if (r != 0) {
+            return 1;
+        }
+
+    } else if (strcmp(cmd, "ctl") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "Usage: wcrontab ctl status|reload|pause|resume|run-now N|list-running\n");
+            return 1;
+        }
+        char request[256] = "";
+        for (int i = 2; i < argc; i++) {
+            if (strlen(request) + strlen(argv[i]) + 2 > sizeof(request)) {
+                fprintf(stderr, "Error: Request too long\n");
+                return 1;
+            }
+            strcat(request, argv[i]);
+            strcat(request, i + 1 < argc ? " " : "");
+        }
+
+        char control_path[WCRON_PATH_MAX_SIZE];
+        int r = get_control_path(control_path, sizeof(control_path)) ? control_request(control_path, request) : -1;
+        if (r < 0) {
+            fprintf(stderr, "Service is not running, or has no control socket on this platform.\n");
+            return 1;
+        }
+        return r;
+
+    } else if (strcmp(cmd, "next") == 0) {
+        return preview_command(argc - 2, argv + 2);
+
+    } else if (strcmp(cmd, "simulate") == 0) {
+        return simulate_command(argc - 2, argv + 2);
+
     } else if (strcmp(cmd, "version") == 0) {
-        wprintf(L"wCron version %hs\n", WCRON_VERSION);
+        printf("wCron version %s\n", WCRON_VERSION);
 
     } else {
         fprintf(stderr, "Error: Unknown command '%s'\n", cmd);
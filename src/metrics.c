@@ -0,0 +1,472 @@
+#include "wcron/metrics.h"
+#include "wcron/log.h"
+#include "wcron/platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define METRICS_PATH_MAX 1024
+#define METRICS_DEFAULT_INTERVAL 15
+#define METRICS_BOUNDS 11
+#define METRICS_JOB_CHUNK 256
+
+// Bucket upper bounds in microseconds; the last bucket is +Inf
+static const uint64_t FAST_BOUNDS[METRICS_BOUNDS] = {10,    50,    100,    500,    1000,   5000,
+                                                     10000, 50000, 100000, 500000, 1000000};
+static const uint64_t SLOW_BOUNDS[METRICS_BOUNDS] = {10000,    100000,   500000,    1000000,   5000000,  10000000,
+                                                     30000000, 60000000, 300000000, 900000000, 3600000000ull};
+
+typedef struct {
+    uint64_t buckets[METRICS_BOUNDS + 1]; // not cumulative; the export adds them up
+    uint64_t sum_us;
+} histogram_data;
+
+typedef struct {
+    const char *name;
+    const char *help;
+    const uint64_t *bounds;
+} metric_info;
+
+static const metric_info COUNTER_INFO[METRIC_COUNTERS] = {
+    {"wcron_runs_total{result=\"ok\"}", "Finished job runs by result", NULL},
+    {"wcron_runs_total{result=\"failed\"}", NULL, NULL},
+    {"wcron_runs_total{result=\"not_started\"}", NULL, NULL},
+    {"wcron_catchup_runs_total", "Runs making up for missed fire times", NULL},
+    {"wcron_output_truncated_total", "Runs whose output reached WCRON_OUTPUT_MAX", NULL},
+    {"wcron_reloads_total", "Crontab reloads installed", NULL},
+    {"wcron_scheduler_wakeups_total", "Times the scheduler loop woke up", NULL},
+    {"wcron_clock_jumps_total", "Wall clock changes noticed", NULL},
+};
+
+static const metric_info GAUGE_INFO[METRIC_GAUGES] = {
+    {"wcron_jobs", "Jobs in the live crontab", NULL},
+    {"wcron_jobs_running", "Job processes running", NULL},
+    {"wcron_runs_queued", "Runs due but not started yet (jitter, admission queue, launchers)", NULL},
+    {"wcron_paused", "1 while the scheduler is paused", NULL},
+};
+
+static const metric_info HISTOGRAM_INFO[METRIC_HISTOGRAMS] = {
+    {"wcron_schedule_drift_seconds", "Time from the scheduled minute to the job's process start", SLOW_BOUNDS},
+    {"wcron_spawn_seconds", "Time to create a job process", FAST_BOUNDS},
+    {"wcron_tick_seconds", "Time the scheduler spent handling one deadline", FAST_BOUNDS},
+};
+
+static uint64_t counters[METRIC_COUNTERS];
+static int64_t gauges[METRIC_GAUGES];
+static histogram_data histograms[METRIC_HISTOGRAMS];
+
+/**
+ * Per-job series. Entries live in chunks that never move: the scheduler
+ * thread appends them and publishes job_count, the writer reads up to it.
+ * Jobs gone from the crontab are retired at the next reload and their
+ * entries handed to new hashes, so edits do not grow the export; seq is odd
+ * while an entry is retired, and the writer skips it.
+ */
+typedef struct {
+    uint32_t seq;
+    uint32_t kept; // keep_round of the last reload that still had the job
+    uint64_t hash;
+    histogram_data duration;
+    uint64_t ok;
+    uint64_t failed;
+} job_metrics;
+
+typedef struct job_chunk {
+    job_metrics jobs[METRICS_JOB_CHUNK];
+    struct job_chunk *next;
+} job_chunk;
+
+static int per_job = 1;
+static job_chunk *first_chunk, *last_chunk;
+static size_t job_count;
+
+// Hash to entry, open-addressed, and the retired entries; only the scheduler thread touches them
+static job_metrics **job_index;
+static size_t job_index_slots;
+static job_metrics **free_jobs;
+static size_t free_count;
+static size_t free_capacity;
+static uint32_t keep_round;
+
+static char metrics_path[METRICS_PATH_MAX];
+static unsigned interval_s;
+static wcron_thread writer;
+static wcron_loop *writer_loop;
+static wcron_event writer_stop;
+static int started;
+
+void metrics_count(metrics_counter counter) {
+    __atomic_fetch_add(&counters[counter], 1, __ATOMIC_RELAXED);
+}
+
+void metrics_gauge_add(metrics_gauge gauge, int64_t delta) {
+    __atomic_fetch_add(&gauges[gauge], delta, __ATOMIC_RELAXED);
+}
+
+void metrics_gauge_set(metrics_gauge gauge, int64_t value) {
+    __atomic_store_n(&gauges[gauge], value, __ATOMIC_RELAXED);
+}
+
+uint64_t metrics_counter_value(metrics_counter counter) {
+    return __atomic_load_n(&counters[counter], __ATOMIC_RELAXED);
+}
+
+int64_t metrics_gauge_value(metrics_gauge gauge) {
+    return __atomic_load_n(&gauges[gauge], __ATOMIC_RELAXED);
+}
+
+static void observe(histogram_data *data, const uint64_t *bounds, uint64_t us) {
+    int bucket = 0;
+    while (bucket < METRICS_BOUNDS && us > bounds[bucket]) {
+        bucket++;
+    }
+    __atomic_fetch_add(&data->buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&data->sum_us, us, __ATOMIC_RELAXED);
+}
+
+void metrics_observe(metrics_histogram histogram, uint64_t us) {
+    observe(&histograms[histogram], HISTOGRAM_INFO[histogram].bounds, us);
+}
+
+static void write_begin(uint32_t *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(uint32_t *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+static void job_index_insert(job_metrics **index, size_t slots, job_metrics *job) {
+    size_t j = (size_t)job->hash & (slots - 1);
+    while (index[j]) {
+        j = (j + 1) & (slots - 1);
+    }
+    index[j] = job;
+}
+
+// Keep the index at most half full
+static int job_index_reserve(void) {
+    if (job_index_slots > 0 && (job_count + 1) * 2 <= job_index_slots) {
+        return 0;
+    }
+
+    size_t slots = job_index_slots ? job_index_slots * 2 : 1024;
+    job_metrics **bigger = calloc(slots, sizeof(job_metrics *));
+    if (!bigger) {
+        return -1;
+    }
+    for (size_t i = 0; i < job_index_slots; i++) {
+        if (job_index[i]) {
+            job_index_insert(bigger, slots, job_index[i]);
+        }
+    }
+    free(job_index);
+    job_index = bigger;
+    job_index_slots = slots;
+    return 0;
+}
+
+static job_metrics *lookup_job(uint64_t hash) {
+    if (job_index_slots == 0) {
+        return NULL;
+    }
+    size_t mask = job_index_slots - 1;
+    for (size_t i = (size_t)hash & mask; job_index[i]; i = (i + 1) & mask) {
+        if (job_index[i]->hash == hash) {
+            return job_index[i];
+        }
+    }
+    return NULL;
+}
+
+static job_metrics *find_job(uint64_t hash) {
+    job_metrics *job = lookup_job(hash);
+    if (job) {
+        return job;
+    }
+    if (job_index_reserve() != 0) {
+        return NULL;
+    }
+
+    if (free_count > 0) {
+        // The writer skips the entry until it is filled in for its new job
+        job = free_jobs[--free_count];
+        job->hash = hash;
+        job->kept = keep_round;
+        memset(&job->duration, 0, sizeof(job->duration));
+        job->ok = 0;
+        job->failed = 0;
+        write_end(&job->seq);
+        job_index_insert(job_index, job_index_slots, job);
+        return job;
+    }
+
+    size_t n = job_count;
+    if (n % METRICS_JOB_CHUNK == 0) {
+        job_chunk *chunk = calloc(1, sizeof(job_chunk));
+        if (!chunk) {
+            return NULL;
+        }
+        if (last_chunk) {
+            __atomic_store_n(&last_chunk->next, chunk, __ATOMIC_RELEASE);
+        } else {
+            __atomic_store_n(&first_chunk, chunk, __ATOMIC_RELEASE);
+        }
+        last_chunk = chunk;
+    }
+
+    job = &last_chunk->jobs[n % METRICS_JOB_CHUNK];
+    job->hash = hash;
+    job->kept = keep_round;
+    job_index_insert(job_index, job_index_slots, job);
+    __atomic_store_n(&job_count, n + 1, __ATOMIC_RELEASE);
+    return job;
+}
+
+void metrics_keep_jobs(const uint64_t *hashes, int count) {
+    if (!per_job || job_count == 0) {
+        return;
+    }
+
+    keep_round++;
+    for (int i = 0; i < count; i++) {
+        job_metrics *job = lookup_job(hashes[i]);
+        if (job) {
+            job->kept = keep_round;
+        }
+    }
+
+    // Retire the rest and index what is left from scratch
+    memset(job_index, 0, sizeof(job_metrics *) * job_index_slots);
+    job_chunk *chunk = first_chunk;
+    for (size_t i = 0; i < job_count; i++) {
+        if (i > 0 && i % METRICS_JOB_CHUNK == 0) {
+            chunk = chunk->next;
+        }
+        job_metrics *job = &chunk->jobs[i % METRICS_JOB_CHUNK];
+        if (job->seq & 1) {
+            continue; // retired earlier, already free
+        }
+        if (job->kept == keep_round) {
+            job_index_insert(job_index, job_index_slots, job);
+            continue;
+        }
+
+        if (free_count == free_capacity) {
+            size_t capacity = free_capacity ? free_capacity * 2 : 64;
+            job_metrics **grown = realloc(free_jobs, sizeof(job_metrics *) * capacity);
+            if (!grown) {
+                // Not reusable without a place on the free list: keep exporting it
+                job_index_insert(job_index, job_index_slots, job);
+                continue;
+            }
+            free_jobs = grown;
+            free_capacity = capacity;
+        }
+        write_begin(&job->seq);
+        free_jobs[free_count++] = job;
+    }
+}
+
+void metrics_observe_job(uint64_t hash, uint64_t duration_us, int failed) {
+    if (!per_job) {
+        return;
+    }
+    job_metrics *job = find_job(hash);
+    if (!job) {
+        return;
+    }
+    observe(&job->duration, SLOW_BOUNDS, duration_us);
+    __atomic_fetch_add(failed ? &job->failed : &job->ok, 1, __ATOMIC_RELAXED);
+}
+
+// Seqlock copy of a per-job entry; 0 while it is retired or being handed to another job
+static int read_job(const job_metrics *job, job_metrics *copy) {
+    uint32_t seq = __atomic_load_n(&job->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1) {
+        return 0;
+    }
+    memcpy(copy, job, sizeof(*copy));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&job->seq, __ATOMIC_RELAXED) == seq;
+}
+
+static void write_histogram(FILE *f, const char *name, const char *labels, const histogram_data *data,
+                            const uint64_t *bounds) {
+    const char *sep = labels[0] ? "," : "";
+    uint64_t total = 0;
+    for (int b = 0; b <= METRICS_BOUNDS; b++) {
+        total += __atomic_load_n(&data->buckets[b], __ATOMIC_RELAXED);
+        if (b < METRICS_BOUNDS) {
+            fprintf(f, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels, sep, (double)bounds[b] / 1e6,
+                    (unsigned long long)total);
+        } else {
+            fprintf(f, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep, (unsigned long long)total);
+        }
+    }
+
+    double sum = (double)__atomic_load_n(&data->sum_us, __ATOMIC_RELAXED) / 1e6;
+    if (labels[0]) {
+        fprintf(f, "%s_sum{%s} %.6f\n%s_count{%s} %llu\n", name, labels, sum, name, labels,
+                (unsigned long long)total);
+    } else {
+        fprintf(f, "%s_sum %.6f\n%s_count %llu\n", name, sum, name, (unsigned long long)total);
+    }
+}
+
+// Base name of a metric, for HELP and TYPE lines
+static void write_header(FILE *f, const char *name, const char *help, const char *type) {
+    int len = (int)strcspn(name, "{");
+    fprintf(f, "# HELP %.*s %s\n# TYPE %.*s %s\n", len, name, help, len, name, type);
+}
+
+static int write_metrics(void) {
+    char tmp_path[METRICS_PATH_MAX + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", metrics_path);
+    FILE *f = fopen(tmp_path, "w");
+    if (!f) {
+        return -1;
+    }
+    setvbuf(f, NULL, _IOFBF, 64 * 1024);
+
+    for (int i = 0; i < METRIC_COUNTERS; i++) {
+        if (COUNTER_INFO[i].help) {
+            write_header(f, COUNTER_INFO[i].name, COUNTER_INFO[i].help, "counter");
+        }
+        fprintf(f, "%s %llu\n", COUNTER_INFO[i].name,
+                (unsigned long long)__atomic_load_n(&counters[i], __ATOMIC_RELAXED));
+    }
+    for (int i = 0; i < METRIC_GAUGES; i++) {
+        write_header(f, GAUGE_INFO[i].name, GAUGE_INFO[i].help, "gauge");
+        fprintf(f, "%s %lld\n", GAUGE_INFO[i].name, (long long)__atomic_load_n(&gauges[i], __ATOMIC_RELAXED));
+    }
+    for (int i = 0; i < METRIC_HISTOGRAMS; i++) {
+        write_header(f, HISTOGRAM_INFO[i].name, HISTOGRAM_INFO[i].help, "histogram");
+        write_histogram(f, HISTOGRAM_INFO[i].name, "", &histograms[i], HISTOGRAM_INFO[i].bounds);
+    }
+
+    size_t count = __atomic_load_n(&job_count, __ATOMIC_ACQUIRE);
+    if (count > 0) {
+        char labels[32];
+        job_chunk *chunk = __atomic_load_n(&first_chunk, __ATOMIC_ACQUIRE);
+
+        write_header(f, "wcron_job_duration_seconds", "Run time of each job, by crontab line hash", "histogram");
+        for (size_t i = 0; i < count; i++) {
+            if (i > 0 && i % METRICS_JOB_CHUNK == 0) {
+                chunk = __atomic_load_n(&chunk->next, __ATOMIC_ACQUIRE);
+            }
+            job_metrics job;
+            if (!read_job(&chunk->jobs[i % METRICS_JOB_CHUNK], &job)) {
+                continue;
+            }
+            snprintf(labels, sizeof(labels), "job=\"%016llx\"", (unsigned long long)job.hash);
+            write_histogram(f, "wcron_job_duration_seconds", labels, &job.duration, SLOW_BOUNDS);
+        }
+
+        chunk = __atomic_load_n(&first_chunk, __ATOMIC_ACQUIRE);
+        write_header(f, "wcron_job_runs_total", "Finished runs of each job by result", "counter");
+        for (size_t i = 0; i < count; i++) {
+            if (i > 0 && i % METRICS_JOB_CHUNK == 0) {
+                chunk = __atomic_load_n(&chunk->next, __ATOMIC_ACQUIRE);
+            }
+            job_metrics job;
+            if (!read_job(&chunk->jobs[i % METRICS_JOB_CHUNK], &job)) {
+                continue;
+            }
+            fprintf(f, "wcron_job_runs_total{job=\"%016llx\",result=\"ok\"} %llu\n", (unsigned long long)job.hash,
+                    (unsigned long long)job.ok);
+            fprintf(f, "wcron_job_runs_total{job=\"%016llx\",result=\"failed\"} %llu\n", (unsigned long long)job.hash,
+                    (unsigned long long)job.failed);
+        }
+    }
+
+    if (fclose(f) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+    return wcron_file_replace(tmp_path, metrics_path);
+}
+
+static void writer_thread(void *param) {
+    (void)param;
+    int failed = 0;
+
+    while (1) {
+        void *tag;
+        int stopping = wcron_loop_wait(writer_loop, (int)(interval_s * 1000), &tag) != 0;
+
+        if (write_metrics() != 0 && !failed) {
+            char msg[METRICS_PATH_MAX + 32];
+            snprintf(msg, sizeof(msg), "Failed to write metrics to %s", metrics_path);
+            log_msg(msg);
+            failed = 1;
+        }
+        if (stopping) {
+            break;
+        }
+    }
+}
+
+int metrics_start(const char *dir) {
+    interval_s = METRICS_DEFAULT_INTERVAL;
+    const char *value = getenv("WCRON_METRICS_INTERVAL");
+    if (value && *value) {
+        interval_s = (unsigned)strtoul(value, NULL, 10);
+    }
+    value = getenv("WCRON_METRICS_JOBS");
+    if (value && strcmp(value, "0") == 0) {
+        per_job = 0;
+    }
+
+    int r = snprintf(metrics_path, sizeof(metrics_path), "%s/wcron.prom", dir);
+    if (interval_s == 0 || started || r <= 0 || r >= (int)sizeof(metrics_path)) {
+        return -1;
+    }
+    if (wcron_make_dir(dir) != 0) {
+        char msg[METRICS_PATH_MAX + 48];
+        snprintf(msg, sizeof(msg), "Cannot create metrics directory %s", dir);
+        log_msg(msg);
+        return -1;
+    }
+
+    writer_loop = wcron_loop_create();
+    if (!writer_loop || wcron_event_create(&writer_stop) != 0) {
+        wcron_loop_destroy(writer_loop);
+        return -1;
+    }
+    wcron_loop_add(writer_loop, writer_stop, NULL);
+
+    if (wcron_thread_start(&writer, writer_thread, NULL) != 0) {
+        wcron_loop_destroy(writer_loop);
+        wcron_event_destroy(writer_stop);
+        return -1;
+    }
+    started = 1;
+    return 0;
+}
+
+void metrics_stop(void) {
+    if (started) {
+        wcron_event_set(writer_stop);
+        wcron_thread_join(writer);
+        wcron_loop_destroy(writer_loop);
+        wcron_event_destroy(writer_stop);
+        started = 0;
+    }
+
+    while (first_chunk) {
+        job_chunk *chunk = first_chunk;
+        first_chunk = chunk->next;
+        free(chunk);
+    }
+    last_chunk = NULL;
+    job_count = 0;
+    free(job_index);
+    job_index = NULL;
+    job_index_slots = 0;
+    free(free_jobs);
+    free_jobs = NULL;
+    free_count = 0;
+    free_capacity = 0;
+}
@@ -0,0 +1,367 @@
+#include "wcron/output.h"
+#include "wcron/log.h"
+#include "wcron/tz.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define OUTPUT_PATH_MAX 1024
+#define OUTPUT_DEFAULT_MAX_KB 1024
+#define OUTPUT_DEFAULT_KEEP_KB 4
+// Most bytes moved per splice or read, and rounds per drain, so a chatty job cannot hold up the scheduler
+#define OUTPUT_CHUNK (64 * 1024)
+#define OUTPUT_DRAIN_ROUNDS 16
+
+/**
+ * The most recent output of one job, a circular buffer of `keep` bytes. Rings
+ * are found by the job's line hash, so they survive reloads that keep the line.
+ */
+typedef struct {
+    uint64_t hash;
+    size_t len;  // bytes held
+    size_t head; // where the next byte goes
+    char data[];
+} output_ring;
+
+static char output_dir[OUTPUT_PATH_MAX];
+static int enabled;
+static uint64_t file_cap; // bytes a run may write to its log file, 0: no files
+static size_t keep;       // bytes of each ring, 0: no rings
+
+// Open-addressed by hash, guarded by rings_lock
+static wcron_mutex rings_lock;
+static output_ring **rings;
+static size_t ring_slots; // power of two
+static size_t ring_count;
+
+static int open_failed; // log a failing output directory once, not on every run
+
+static size_t read_kb(const char *name, size_t fallback) {
+    const char *value = getenv(name);
+    if (value && *value) {
+        return (size_t)strtoul(value, NULL, 10);
+    }
+    return fallback;
+}
+
+int output_init(const char *dir) {
+    file_cap = (uint64_t)read_kb("WCRON_OUTPUT_MAX", OUTPUT_DEFAULT_MAX_KB) * 1024;
+    keep = read_kb("WCRON_OUTPUT_KEEP", OUTPUT_DEFAULT_KEEP_KB) * 1024;
+    if (file_cap == 0 && keep == 0) {
+        log_msg("Job output is not captured");
+        return -1;
+    }
+
+    size_t len = strlen(dir);
+    if (len >= sizeof(output_dir)) {
+        return -1;
+    }
+    memcpy(output_dir, dir, len + 1);
+    if (file_cap > 0 && wcron_make_dir(output_dir) != 0) {
+        char msg[OUTPUT_PATH_MAX + 64];
+        snprintf(msg, sizeof(msg), "Cannot create job output directory %s, keeping output in memory only", dir);
+        log_msg(msg);
+        file_cap = 0;
+    }
+
+    wcron_mutex_init(&rings_lock);
+    enabled = 1;
+    return 0;
+}
+
+void output_shutdown(void) {
+    if (!enabled) {
+        return;
+    }
+    enabled = 0;
+
+    wcron_mutex_lock(&rings_lock);
+    for (size_t i = 0; i < ring_slots; i++) {
+        free(rings[i]);
+    }
+    free(rings);
+    rings = NULL;
+    ring_slots = 0;
+    ring_count = 0;
+    wcron_mutex_unlock(&rings_lock);
+    wcron_mutex_destroy(&rings_lock);
+}
+
+// Slot of hash, or the empty slot where it would go. Caller must hold rings_lock.
+static size_t ring_slot(uint64_t hash) {
+    size_t mask = ring_slots - 1;
+    size_t i = (size_t)hash & mask;
+    while (rings[i] && rings[i]->hash != hash) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Keep the table at most half full. Caller must hold rings_lock.
+static int rings_reserve(void) {
+    if (ring_slots > 0 && (ring_count + 1) * 2 <= ring_slots) {
+        return 0;
+    }
+
+    size_t slots = ring_slots ? ring_slots * 2 : 64;
+    output_ring **bigger = calloc(slots, sizeof(output_ring *));
+    if (!bigger) {
+        return -1;
+    }
+    output_ring **old = rings;
+    size_t old_slots = ring_slots;
+    rings = bigger;
+    ring_slots = slots;
+    for (size_t i = 0; i < old_slots; i++) {
+        if (old[i]) {
+            rings[ring_slot(old[i]->hash)] = old[i];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+// Append to the job's ring, keeping only its last `keep` bytes
+static void ring_append(uint64_t hash, const char *data, size_t n) {
+    if (keep == 0 || n == 0) {
+        return;
+    }
+
+    wcron_mutex_lock(&rings_lock);
+    if (rings_reserve() != 0) {
+        wcron_mutex_unlock(&rings_lock);
+        return;
+    }
+    size_t slot = ring_slot(hash);
+    output_ring *ring = rings[slot];
+    if (!ring) {
+        ring = malloc(sizeof(output_ring) + keep);
+        if (!ring) {
+            wcron_mutex_unlock(&rings_lock);
+            return;
+        }
+        ring->hash = hash;
+        ring->len = 0;
+        ring->head = 0;
+        rings[slot] = ring;
+        ring_count++;
+    }
+
+    if (n >= keep) {
+        memcpy(ring->data, data + n - keep, keep);
+        ring->head = 0;
+        ring->len = keep;
+    } else {
+        size_t first = keep - ring->head < n ? keep - ring->head : n;
+        memcpy(ring->data + ring->head, data, first);
+        memcpy(ring->data, data + first, n - first);
+        ring->head = (ring->head + n) % keep;
+        ring->len = ring->len + n < keep ? ring->len + n : keep;
+    }
+    wcron_mutex_unlock(&rings_lock);
+}
+
+size_t output_tail(uint64_t hash, char *buffer, size_t size) {
+    if (!enabled || keep == 0) {
+        return 0;
+    }
+
+    wcron_mutex_lock(&rings_lock);
+    size_t n = 0;
+    output_ring *ring = ring_slots ? rings[ring_slot(hash)] : NULL;
+    if (ring) {
+        n = ring->len < size ? ring->len : size;
+        size_t from = (ring->head + keep - n) % keep;
+        size_t first = keep - from < n ? keep - from : n;
+        memcpy(buffer, ring->data + from, first);
+        memcpy(buffer + first, ring->data, n - first);
+    }
+    wcron_mutex_unlock(&rings_lock);
+    return n;
+}
+
+// Open the job's log file, moving it to .log.1 first once it reached the cap
+static wcron_handle open_log_file(uint64_t hash) {
+    char path[OUTPUT_PATH_MAX];
+    char old_path[OUTPUT_PATH_MAX + 8];
+    int r = snprintf(path, sizeof(path), "%s/%016llx.log", output_dir, (unsigned long long)hash);
+    if (r <= 0 || r >= (int)sizeof(path)) {
+        return WCRON_NO_HANDLE;
+    }
+
+    wcron_handle file;
+    if (wcron_file_open_append(path, &file) != 0) {
+        if (!__atomic_exchange_n(&open_failed, 1, __ATOMIC_RELAXED)) {
+            char msg[OUTPUT_PATH_MAX + 64];
+            snprintf(msg, sizeof(msg), "Cannot open job output file %s", path);
+            log_msg(msg);
+        }
+        return WCRON_NO_HANDLE;
+    }
+
+    if (wcron_file_size(file) >= (int64_t)file_cap) {
+        wcron_handle_close(file);
+        snprintf(old_path, sizeof(old_path), "%s.1", path);
+        remove(old_path);
+        rename(path, old_path);
+        if (wcron_file_open_append(path, &file) != 0) {
+            return WCRON_NO_HANDLE;
+        }
+    }
+    return file;
+}
+
+void output_begin(job_output *out, uint64_t hash, time_t scheduled) {
+    memset(out, 0, sizeof(*out));
+    out->pipe = WCRON_NO_HANDLE;
+    out->child = WCRON_NO_HANDLE;
+    out->file = WCRON_NO_HANDLE;
+    out->hash = hash;
+    if (!enabled) {
+        return;
+    }
+
+    if (file_cap > 0) {
+        out->file = open_log_file(hash);
+    }
+    if (out->file != WCRON_NO_HANDLE) {
+        // Start each run on a line of its own
+        int64_t size = wcron_file_size(out->file);
+        char last = '\n';
+        if (size > 0) {
+            wcron_file_read_at(out->file, size - 1, &last, 1);
+        }
+
+        char header[64];
+        struct tm tm;
+        tz_localtime(scheduled, &tm);
+        size_t len = strftime(header + 1, sizeof(header) - 1, "--- run of %Y-%m-%d %H:%M ---\n", &tm);
+        header[0] = '\n';
+        if (last == '\n') {
+            wcron_file_write(out->file, header + 1, len);
+        } else {
+            wcron_file_write(out->file, header, len + 1);
+        }
+        out->start = wcron_file_size(out->file);
+    }
+
+    if (wcron_pipe_create(&out->pipe, &out->child) != 0) {
+        // Unwatchable pipes: the child writes to the file directly
+        out->pipe = WCRON_NO_HANDLE;
+        out->child = out->file;
+    }
+}
+
+void output_spawned(job_output *out) {
+    if (out->pipe != WCRON_NO_HANDLE) {
+        wcron_handle_close(out->child);
+    }
+    out->child = WCRON_NO_HANDLE;
+}
+
+// Keep the last bytes the run wrote to its file in memory; read back from the page cache instead of holding a copy
+static void keep_file_tail(job_output *out) {
+    size_t n = out->written < keep ? (size_t)out->written : keep;
+    char *tail = n ? malloc(n) : NULL;
+    if (tail && wcron_file_read_at(out->file, out->start + (int64_t)(out->written - n), tail, n) == (long)n) {
+        ring_append(out->hash, tail, n);
+    }
+    free(tail);
+}
+
+// Write the marker once a run reached the cap
+static void mark_truncated(job_output *out) {
+    char marker[96];
+    int len = snprintf(marker, sizeof(marker), "\n[wcrontab: output truncated at %llu KB]\n",
+                       (unsigned long long)(file_cap / 1024));
+    if (wcron_file_write(out->file, marker, (size_t)len) == len) {
+        out->written += (uint64_t)len;
+    }
+    out->truncated = 1;
+}
+
+// Up to OUTPUT_DRAIN_ROUNDS moves: 1 when the output ended, 0 when the pipe is empty, 2 when more is waiting
+static int drain(job_output *out) {
+    if (out->pipe == WCRON_NO_HANDLE || out->ended) {
+        return 1;
+    }
+
+    for (int round = 0; round < OUTPUT_DRAIN_ROUNDS; round++) {
+        long n;
+        if (out->file != WCRON_NO_HANDLE && !out->truncated && out->written < file_cap) {
+            uint64_t room = file_cap - out->written;
+            n = wcron_pipe_splice(out->pipe, out->file, room < OUTPUT_CHUNK ? (size_t)room : OUTPUT_CHUNK);
+            if (n == -2) {
+                // Disk full or the like: keep draining so the job is not blocked, into memory only
+                wcron_handle_close(out->file);
+                out->file = WCRON_NO_HANDLE;
+                continue;
+            }
+            if (n > 0) {
+                out->written += (uint64_t)n;
+            }
+        } else {
+            char buffer[16 * 1024];
+            n = wcron_pipe_read(out->pipe, buffer, sizeof(buffer));
+            if (n > 0 && out->file != WCRON_NO_HANDLE) {
+                if (!out->truncated) {
+                    // From here the memory copy follows the pipe, so it ends where the output really ends
+                    keep_file_tail(out);
+                    mark_truncated(out);
+                }
+                out->dropped += (uint64_t)n;
+            }
+            if (n > 0) {
+                ring_append(out->hash, buffer, (size_t)n);
+            }
+        }
+
+        if (n == 0) {
+            out->ended = 1;
+            return 1;
+        }
+        if (n < 0) {
+            return 0;
+        }
+    }
+    return 2;
+}
+
+int output_drain(job_output *out) {
+    return drain(out) == 1;
+}
+
+void output_end(job_output *out) {
+    int kept = 0;
+    if (out->pipe != WCRON_NO_HANDLE) {
+        // The child is gone, so what it wrote is in the pipe; anything it left running loses its output.
+        // The rounds are bounded in case such a leftover keeps writing.
+        for (int i = 0; i < OUTPUT_DRAIN_ROUNDS && drain(out) == 2; i++) {
+        }
+        wcron_handle_close(out->pipe);
+        out->pipe = WCRON_NO_HANDLE;
+    } else if (out->file != WCRON_NO_HANDLE) {
+        // The child wrote to the file itself: cut the run back to the cap now
+        int64_t size = wcron_file_size(out->file);
+        out->written = size > out->start ? (uint64_t)(size - out->start) : 0;
+        if (out->written > file_cap) {
+            // Before the cut, or the memory copy would end at the marker
+            keep_file_tail(out);
+            kept = 1;
+            if (wcron_file_truncate(out->file, out->start + (int64_t)file_cap) == 0) {
+                out->dropped = out->written - file_cap;
+                out->written = file_cap;
+                mark_truncated(out);
+            }
+        }
+    }
+
+    if (out->file != WCRON_NO_HANDLE) {
+        // Past the cap, the drain kept the tail as it read it
+        if (!kept && !out->truncated) {
+            keep_file_tail(out);
+        }
+        wcron_handle_close(out->file);
+        out->file = WCRON_NO_HANDLE;
+    }
+}
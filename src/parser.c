@@ -1,226 +1,330 @@
 #include "wcron/parser.h"
-#include "wcron/service.h"
-#include <ctype.h>
+#include "wcron/log.h"
+#include "wcron/tz.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-static void set_range(int *arr, int start, int end, int step, int offset, int max) {
-    if (step < 1)
-        step = 1;
+#define CRON_DAYS_ALL 0xFFFFFFFEu              // days 1-31
+#define CRON_WDAYS_ALL 0x7Fu                   // weekdays 0-6
+#define CRON_MINUTES_ALL 0x0FFFFFFFFFFFFFFFull // minutes 0-59
+#define CRON_HOURS_ALL 0x00FFFFFFu             // hours 0-23
+#define CRON_MONTHS_ALL 0x0FFFu                // months 0-11
+#define CRON_WDAY_SUNDAY7 0x80u                // weekday 7, folded into 0
+#define CRON_EVERY_7_DAYS 0x20408102u          // days 1, 8, 15, 22, 29
 
-    for (int i = start; i <= end; i += step) {
-        int idx = i - offset;
-        if (idx >= 0 && idx < max) {
-            arr[idx] = 1;
-        }
-    }
+static const int DAYS_IN_MONTH[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+static int is_leap_year(int year) {
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
 }
 
-static int validate_value(int value, int min, int max, const char *field_name) {
-    if (value < min || value > max) {
-        char msg[128];
-        snprintf(msg, sizeof(msg), "Invalid %s value: %d (must be %d-%d)", field_name, value, min, max);
-        log_msg(msg);
-        return 0;
-    }
-    return 1;
+static int days_in_month(int year, int mon) {
+    return mon == 1 && is_leap_year(year) ? 29 : DAYS_IN_MONTH[mon];
 }
 
-/**
- * Parse one field of the cron expression
- *
- * @param field raw cron field string
- */
-static int parse_field(const char *field, int *arr, int min, int max, int offset, int size) {
-    if (!field || !arr) {
-        log_msg("NULL pointer in parse_field");
+// Weekday (0=Sun) of a Gregorian date, mon 0-11
+static int weekday_of(int year, int mon, int mday) {
+    static const int t[12] = {0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4};
+    if (mon < 2)
+        year--;
+    return (year + year / 4 - year / 100 + year / 400 + t[mon] + mday) % 7;
+}
+
+// Index of the lowest set bit >= from, or -1
+static int next_bit(uint64_t mask, int from) {
+    if (from > 63)
         return -1;
-    }
+    mask &= ~(uint64_t)0 << from;
+    return mask ? __builtin_ctzll(mask) : -1;
+}
 
-    memset(arr, 0, sizeof(int) * size);
+// Days since 1970-01-01 of a Gregorian date, mon 0-11
+static long days_from_civil(int year, int mon, int mday) {
+    year -= mon < 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long yoe = year - era * 400;
+    long doy = (153 * (mon + (mon > 1 ? -2 : 10)) + 2) / 5 + mday - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
 
-    char *copy = strdup(field);
-    if (!copy) {
-        log_msg("Failed to allocate memory in parse_field");
-        return -1;
+// Local calendar fields as seconds, as if the local zone were UTC
+static time_t civil_seconds(const struct tm *tm) {
+    return (time_t)days_from_civil(tm->tm_year + 1900, tm->tm_mon, tm->tm_mday) * 86400 + tm->tm_hour * 3600 +
+           tm->tm_min * 60 + tm->tm_sec;
+}
+
+static void set_range(uint64_t *mask, int start, int end, int step, int offset) {
+    for (int i = start; i <= end; i += step) {
+        *mask |= (uint64_t)1 << (i - offset);
     }
+}
 
-    char *saveptr;
-    char *token = strtok_r(copy, ",", &saveptr);
+// Limits of one time field; the mask gets bit (value - offset) for every allowed value
+typedef struct {
+    int min;
+    int max;
+    int offset;
+    const char *range_error;
+} cron_field;
+
+static const cron_field FIELDS[5] = {
+    {0, 59, 0, "minute out of range (0-59)"},
+    {0, 23, 0, "hour out of range (0-23)"},
+    {1, 31, 0, "day of month out of range (1-31)"},
+    {1, 12, 1, "month out of range (1-12)"},
+    {0, 7, 0, "day of week out of range (0-7)"},
+};
+
+static int is_blank(char c) {
+    return c == ' ' || c == '\t';
+}
 
-    while (token) {
-        while (isspace(*token))
-            token++;
-        char *end = token + strlen(token) - 1;
-        while (end > token && isspace(*end))
-            *end-- = '\0';
+static int parse_fail(cron_parse_error *error, const char *line, const char *at, const char *reason) {
+    if (error) {
+        error->reason = reason;
+        error->column = (size_t)(at - line);
+    }
+    return -1;
+}
 
-        if (strlen(token) == 0) {
-            token = strtok_r(NULL, ",", &saveptr);
-            continue;
-        }
+// Decimal number at *p, advancing *p past it; anything past 4 digits is out of range anyway
+static int parse_number(const char **p, const char *end, int *value) {
+    const char *s = *p;
+    int v = 0;
 
-        if (token[0] == '*') {
-            int step = 1;
+    while (s < end && *s >= '0' && *s <= '9') {
+        if (v < 10000) {
+            v = v * 10 + (*s - '0');
+        }
+        s++;
+    }
+    if (s == *p) {
+        return -1;
+    }
+    *p = s;
+    *value = v;
+    return 0;
+}
 
-            if (strlen(token) > 1 && token[1] == '/') {
-                step = atoi(token + 2);
-                if (step < 1) {
-                    log_msg("Invalid step value in */N");
-                    free(copy);
-                    return -1;
-                }
-            }
+/**
+ * Parse one time field in place: comma-separated items, each *, N or N-M with an
+ * optional /step. N/step runs from N to the field maximum.
+ *
+ * @param p start of the field in the line
+ * @param end one past its last byte
+ * @param at receives the position of the first offending byte on failure
+ */
+static int parse_field(const char *p, const char *end, const cron_field *field, uint64_t *mask, const char **at,
+                       const char **reason) {
+    const char *field_start = p;
+    *mask = 0;
+
+    for (;;) {
+        if (p == end || *p == ',') {
+            // An empty item: a comma first, last or right after another; point at that comma
+            *at = p == end && p > field_start ? p - 1 : p;
+            *reason = "expected *, a number or a range";
+            return -1;
+        }
 
-            set_range(arr, min, max, step, offset, size);
-        } else if (strchr(token, '-')) {
-            int start, end, step = 1;
-            char *slash = strchr(token, '/');
-
-            if (slash) {
-                *slash = '\0';
-                step = atoi(slash + 1);
-                if (step < 1) {
-                    log_msg("Invalid step in range");
-                    free(copy);
+        const char *item = p;
+        int start, stop, step = 1;
+
+        if (*p == '*') {
+            start = field->min;
+            stop = field->max;
+            p++;
+        } else if (parse_number(&p, end, &start) == 0) {
+            stop = start;
+            if (p < end && *p == '-') {
+                p++;
+                if (parse_number(&p, end, &stop) != 0) {
+                    *at = p;
+                    *reason = "range end is not a number";
                     return -1;
                 }
+            } else if (p < end && *p == '/') {
+                stop = field->max;
             }
-
-            if (sscanf(token, "%d-%d", &start, &end) != 2) {
-                log_msg("Invalid range format");
-                free(copy);
-                return -1;
-            }
-
-            if (!validate_value(start, min, max, "range start") || !validate_value(end, min, max, "range end")) {
-                free(copy);
-                return -1;
-            }
-
-            if (start > end) {
-                log_msg("Range start > end");
-                free(copy);
-                return -1;
-            }
-
-            set_range(arr, start, end, step, offset, size);
         } else {
-            int val = atoi(token);
+            *at = p;
+            *reason = "expected *, a number or a range";
+            return -1;
+        }
 
-            if (!validate_value(val, min, max, "value")) {
-                free(copy);
+        if (p < end && *p == '/') {
+            p++;
+            const char *step_at = p;
+            if (parse_number(&p, end, &step) != 0 || step < 1) {
+                *at = step_at;
+                *reason = "step must be a positive number";
                 return -1;
             }
+        }
 
-            int idx = val - offset;
-            if (idx >= 0 && idx < size) {
-                arr[idx] = 1;
-            }
+        if (p < end && *p != ',') {
+            *at = p;
+            *reason = "unexpected character";
+            return -1;
         }
 
-        token = strtok_r(NULL, ",", &saveptr);
-    }
+        if (start < field->min || start > field->max || stop < field->min || stop > field->max) {
+            *at = item;
+            *reason = field->range_error;
+            return -1;
+        }
+        if (start > stop) {
+            *at = item;
+            *reason = "range start is after its end";
+            return -1;
+        }
 
-    free(copy);
-    return 0;
+        set_range(mask, start, stop, step, field->offset);
+        if (p == end) {
+            return 0;
+        }
+        p++; // the comma
+    }
 }
 
-int parse_cron_line(const char *line, cron_job *job) {
-    if (!line || !job) {
-        log_msg("NULL pointer in parse_cron_line");
-        return -1;
+/**
+ * Check that at least one calendar date satisfies the schedule. Only a restricted
+ * day-of-month with a wildcard weekday can be impossible (e.g. 31 in February).
+ */
+static int schedule_can_fire(const cron_job *job) {
+    if (!job->minutes || !job->hours || !job->days || !job->months || !job->daysofweek) {
+        return 0;
     }
 
-    memset(job, 0, sizeof(cron_job));
+    if (!(job->flags & CRON_DOW_WILDCARD)) {
+        return 1;
+    }
 
-    char buf[512];
-    strncpy(buf, line, sizeof(buf) - 1);
-    buf[sizeof(buf) - 1] = '\0';
-
-    char *newline = strchr(buf, '\n');
-    if (newline)
-        *newline = '\0';
-    newline = strchr(buf, '\r');
-    if (newline)
-        *newline = '\0';
-
-    char *fields[5];
-    int field_count = 0;
-    char *saveptr;
-    char *token = strtok_r(buf, " \t", &saveptr);
-
-    while (token && field_count < 5) {
-        if (strlen(token) > 0) {
-            fields[field_count++] = token;
+    for (int mon = 0; mon < 12; mon++) {
+        int max_day = mon == 1 ? 29 : DAYS_IN_MONTH[mon];
+        uint32_t valid_days = (uint32_t)(((uint64_t)1 << (max_day + 1)) - 2);
+        if ((job->months >> mon & 1) && (job->days & valid_days)) {
+            return 1;
         }
-        token = strtok_r(NULL, " \t", &saveptr);
     }
+    return 0;
+}
 
-    if (field_count < 5) {
-        log_msg("Not enough fields in cron line (need 5 time fields + command)");
-        return -1;
+// Pick the specialized matcher for the schedule's shape
+static uint8_t schedule_kind(const cron_job *job) {
+    if ((job->flags & CRON_NEVER_FIRES) || job->months != CRON_MONTHS_ALL || !(job->flags & CRON_DOM_WILDCARD)) {
+        return CRON_KIND_GENERIC;
+    }
+    if (!(job->flags & CRON_DOW_WILDCARD)) {
+        return CRON_KIND_WEEKDAYS;
+    }
+    if (job->hours != CRON_HOURS_ALL) {
+        return CRON_KIND_DAILY;
+    }
+    // The every-minute and hourly routines follow the clock, which is right only for jobs written with * (see
+    // CRON_TIME_WILDCARD); 0-59 0-23 * * * is a list of fixed times and keeps the generic search's DST rules
+    if (!(job->flags & CRON_TIME_WILDCARD)) {
+        return CRON_KIND_GENERIC;
     }
+    return job->minutes == CRON_MINUTES_ALL ? CRON_KIND_EVERY_MINUTE : CRON_KIND_HOURLY;
+}
 
-    if (!token) {
-        log_msg("No command specified in cron line");
-        return -1;
+int parse_cron_span(const char *line, size_t len, cron_job *job, cron_parse_error *error) {
+    memset(job, 0, sizeof(cron_job));
+
+    const char *p = line;
+    const char *end = line + len;
+    while (end > p && (end[-1] == '\n' || end[-1] == '\r')) {
+        end--;
     }
 
-    size_t cmd_len = 0;
-    while (token) {
-        if (cmd_len > 0 && cmd_len < sizeof(job->command) - 1) {
-            job->command[cmd_len++] = ' ';
+    uint64_t masks[5];
+    for (int f = 0; f < 5; f++) {
+        while (p < end && is_blank(*p)) {
+            p++;
         }
-
-        size_t token_len = strlen(token);
-        if (cmd_len + token_len < sizeof(job->command) - 1) {
-            strcpy(job->command + cmd_len, token);
-            cmd_len += token_len;
-        } else {
-            log_msg("Command too long");
-            return -1;
+        const char *field_end = p;
+        while (field_end < end && !is_blank(*field_end)) {
+            field_end++;
+        }
+        if (field_end == p) {
+            return parse_fail(error, line, p, "not enough fields (need 5 time fields and a command)");
         }
 
-        token = strtok_r(NULL, " \t", &saveptr);
+        const char *at;
+        const char *reason;
+        if (parse_field(p, field_end, &FIELDS[f], &masks[f], &at, &reason) != 0) {
+            return parse_fail(error, line, at, reason);
+        }
+        // As in Vixie cron, * or */N in the minute or hour field makes the job follow the clock across DST changes
+        if (f < 2 && *p == '*') {
+            job->flags |= CRON_TIME_WILDCARD;
+        }
+        p = field_end;
     }
 
-    if (cmd_len == 0) {
-        log_msg("Empty command in cron line");
-        return -1;
+    while (p < end && is_blank(*p)) {
+        p++;
+    }
+    const char *command_end = end;
+    while (command_end > p && is_blank(command_end[-1])) {
+        command_end--;
+    }
+    if (command_end == p) {
+        return parse_fail(error, line, p, "no command specified");
     }
 
-    if (parse_field(fields[0], job->minutes, 0, 59, 0, 60) != 0) {
-        log_msg("Failed to parse minute field");
-        return -1;
+    job->command = p;
+    job->command_len = (uint32_t)(command_end - p);
+
+    job->minutes = masks[0];
+    job->hours = (uint32_t)masks[1];
+    job->days = (uint32_t)masks[2];
+    job->months = (uint32_t)masks[3];
+
+    // Sunday may be written as 0 or 7
+    uint64_t mask = masks[4];
+    if (mask & CRON_WDAY_SUNDAY7) {
+        mask = (mask & ~CRON_WDAY_SUNDAY7) | 1;
     }
+    job->daysofweek = (uint8_t)mask;
 
-    if (parse_field(fields[1], job->hours, 0, 23, 0, 24) != 0) {
-        log_msg("Failed to parse hour field");
-        return -1;
+    // A field is a wildcard when it allows every value (*, */1, 1-31, 0-7, ...)
+    if (job->days == CRON_DAYS_ALL) {
+        job->flags |= CRON_DOM_WILDCARD;
+    }
+    if (job->daysofweek == CRON_WDAYS_ALL) {
+        job->flags |= CRON_DOW_WILDCARD;
     }
 
-    if (parse_field(fields[2], job->days, 1, 31, 1, 31) != 0) {
-        log_msg("Failed to parse day field");
-        return -1;
+    if (!schedule_can_fire(job)) {
+        job->flags |= CRON_NEVER_FIRES;
     }
+    job->kind = schedule_kind(job);
+
+    return 0;
+}
 
-    if (parse_field(fields[3], job->months, 1, 12, 1, 12) != 0) {
-        log_msg("Failed to parse month field");
+int parse_cron_line(const char *line, cron_job *job) {
+    if (!line || !job) {
+        log_msg("NULL pointer in parse_cron_line");
         return -1;
     }
 
-    if (parse_field(fields[4], job->daysofweek, 0, 7, 0, 7) != 0) {
-        log_msg("Failed to parse weekday field");
+    cron_parse_error error;
+    if (parse_cron_span(line, strcspn(line, "\r\n"), job, &error) != 0) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Invalid cron line at column %lu: %s", (unsigned long)error.column + 1,
+                 error.reason);
+        log_msg(msg);
         return -1;
     }
 
-    if (job->daysofweek[6]) {
-        job->daysofweek[0] = 1;
-        job->daysofweek[6] = 0;
+    if (job->flags & CRON_NEVER_FIRES) {
+        log_msg("Schedule never fires (no valid date), job will not run");
     }
-
     return 0;
 }
 
@@ -229,56 +333,273 @@ int time_matches(const cron_job *job, const struct tm *tm) {
         return 0;
     }
 
-    // Verificar minuto (0-59)
-    if (!job->minutes[tm->tm_min]) {
+    // Every kind restricts the minute, and it rejects most jobs; dispatch only the survivors
+    if (!(job->minutes >> tm->tm_min & 1)) {
         return 0;
     }
 
-    // Verificar hora (0-23)
-    if (!job->hours[tm->tm_hour]) {
-        return 0;
+    switch (job->kind) {
+    case CRON_KIND_EVERY_MINUTE:
+    case CRON_KIND_HOURLY:
+        return 1;
+    case CRON_KIND_DAILY:
+        return (int)(job->hours >> tm->tm_hour & 1);
+    case CRON_KIND_WEEKDAYS:
+        return (int)(job->hours >> tm->tm_hour & job->daysofweek >> tm->tm_wday & 1);
+    default:
+        break;
     }
 
-    // Verificar mes (tm_mon: 0-11, array: 0-11 indexado por 1-12)
-    if (!job->months[tm->tm_mon]) {
+    if (!(job->hours >> tm->tm_hour & 1) || !(job->months >> tm->tm_mon & 1)) {
         return 0;
     }
 
-    // Verificar día del mes vs día de la semana
-    // Si ambos están especificados (no todos marcados), usar OR
-    int day_match = job->days[tm->tm_mday - 1];       // tm_mday: 1-31, array: 0-30
-    int weekday_match = job->daysofweek[tm->tm_wday]; // tm_wday: 0-6
+    int day_match = job->days >> tm->tm_mday & 1;
+    int weekday_match = job->daysofweek >> tm->tm_wday & 1;
 
-    // Verificar si day está como * (todos marcados)
-    int day_is_wildcard = 1;
-    for (int i = 0; i < 31; i++) {
-        if (!job->days[i]) {
-            day_is_wildcard = 0;
-            break;
-        }
+    // Lógica según estándar cron:
+    // - Si ambos son *, coinciden
+    // - Si uno es * y otro no, verificar el específico
+    // - Si ambos son específicos, usar OR (cualquiera coincide)
+    // Un campo * tiene todos sus bits en 1, así que AND cubre los tres primeros casos
+    if ((job->flags & (CRON_DOM_WILDCARD | CRON_DOW_WILDCARD)) == 0) {
+        return day_match | weekday_match;
     }
+    return day_match & weekday_match;
+}
 
-    // Verificar si weekday está como * (todos marcados)
-    int weekday_is_wildcard = 1;
-    for (int i = 0; i < 7; i++) {
-        if (!job->daysofweek[i]) {
-            weekday_is_wildcard = 0;
-            break;
+/**
+ * Days of the given month allowed by the job, one bit per day (1-31), with the
+ * dom/dow OR rule of time_matches() applied
+ */
+static uint32_t month_day_mask(const cron_job *job, int year, int mon) {
+    int dim = days_in_month(year + 1900, mon);
+    uint32_t in_month = (uint32_t)(((uint64_t)1 << (dim + 1)) - 2);
+
+    // Spread the weekday mask over the days of this month
+    int first_wday = weekday_of(year + 1900, mon, 1);
+    uint32_t wday_days = 0;
+    for (int w = 0; w < 7; w++) {
+        if (job->daysofweek >> w & 1) {
+            wday_days |= CRON_EVERY_7_DAYS << ((w - first_wday + 7) % 7);
         }
     }
 
-    // Lógica según estándar cron:
-    // - Si ambos son *, coinciden
-    // - Si uno es * y otro no, verificar el específico
-    // - Si ambos son específicos, usar OR (cualquiera coincide)
-    if (day_is_wildcard && weekday_is_wildcard) {
-        return 1; // Ambos son *, siempre coincide
-    } else if (day_is_wildcard) {
-        return weekday_match; // Solo verificar weekday
-    } else if (weekday_is_wildcard) {
-        return day_match; // Solo verificar day
+    uint32_t allowed;
+    if ((job->flags & (CRON_DOM_WILDCARD | CRON_DOW_WILDCARD)) == 0) {
+        allowed = job->days | wday_days;
     } else {
-        return day_match || weekday_match; // Verificar ambos con OR
+        allowed = job->days & wday_days;
+    }
+    return allowed & in_month;
+}
+
+// Fall-backs replay at most this much local time
+#define CRON_MAX_REPLAY (3 * 3600)
+
+/**
+ * Find the first fire time after `after` by carrying from field to field
+ * (month -> day -> hour -> minute) through local calendar time, starting at
+ * `from` inclusive, instead of probing every minute. DST changes follow
+ * Vixie cron: a local time skipped by a spring-forward fires a fixed-time job
+ * when the clock jumps past it and is dropped for jobs following the clock; a
+ * local time that happens twice fires a fixed-time job the first time only.
+ */
+static time_t search_local(const cron_job *job, time_t after, const struct tm *from) {
+    int follows_clock = (job->flags & CRON_TIME_WILDCARD) != 0;
+    int year = from->tm_year;
+    int mon = from->tm_mon;
+    int mday = from->tm_mday;
+    int hour = from->tm_hour;
+    int min = from->tm_min;
+
+    // A leap-day-only schedule can be 8 years away (e.g. 2096 -> 2104)
+    int last_year = year + 9;
+
+    while (year <= last_year) {
+        if (min > 59) {
+            min = 0;
+            hour++;
+        }
+        if (hour > 23) {
+            hour = 0;
+            mday++;
+        }
+
+        int m = next_bit(job->months, mon);
+        if (m < 0) {
+            year++;
+            mon = 0;
+            mday = 1;
+            hour = 0;
+            min = 0;
+            continue;
+        }
+        if (m != mon) {
+            mon = m;
+            mday = 1;
+            hour = 0;
+            min = 0;
+        }
+
+        int d = next_bit(month_day_mask(job, year, mon), mday);
+        if (d < 0) {
+            mon++;
+            mday = 1;
+            hour = 0;
+            min = 0;
+            if (mon > 11) {
+                year++;
+                mon = 0;
+            }
+            continue;
+        }
+        if (d != mday) {
+            mday = d;
+            hour = 0;
+            min = 0;
+        }
+
+        int h = next_bit(job->hours, hour);
+        if (h < 0) {
+            mday++;
+            hour = 0;
+            min = 0;
+            continue;
+        }
+        if (h != hour) {
+            hour = h;
+            min = 0;
+        }
+
+        int mi = next_bit(job->minutes, min);
+        if (mi < 0) {
+            hour++;
+            min = 0;
+            continue;
+        }
+
+        struct tm candidate = {0};
+        candidate.tm_year = year;
+        candidate.tm_mon = mon;
+        candidate.tm_mday = mday;
+        candidate.tm_hour = hour;
+        candidate.tm_min = mi;
+
+        time_t when[2];
+        int n = tz_resolve(civil_seconds(&candidate), when);
+        if (n == 0) {
+            if (!follows_clock && when[0] > after) {
+                return when[0];
+            }
+        } else if (when[0] > after) {
+            return when[0];
+        } else if (n == 2 && follows_clock && when[1] > after) {
+            return when[1];
+        }
+
+        // Already passed, or skipped: keep searching
+        min = mi + 1;
+    }
+
+    return CRON_NEVER;
+}
+
+static time_t next_fire_generic(const cron_job *job, time_t after) {
+    struct tm from;
+    tz_localtime(after, &from);
+    from.tm_min++;
+    time_t t = search_local(job, after, &from);
+
+    // A fall-back right after `after` replays local times the search has passed; jobs following the clock run again
+    if (job->flags & CRON_TIME_WILDCARD) {
+        time_t until = t != CRON_NEVER && t - after < CRON_MAX_REPLAY ? t : after + CRON_MAX_REPLAY;
+        time_t back = tz_transition(after, until);
+        if (back != (time_t)-1 && tz_offset(back) < tz_offset(after)) {
+            tz_localtime(back, &from);
+            time_t replay = search_local(job, after, &from);
+            if (replay != CRON_NEVER && (t == CRON_NEVER || replay < t)) {
+                t = replay;
+            }
+        }
+    }
+    return t;
+}
+
+// HOURLY kind: every hour matches, so the next allowed minute of this hour or the next
+static time_t next_fire_hourly(const cron_job *job, time_t after) {
+    struct tm tm;
+    tz_localtime(after, &tm);
+
+    int m = next_bit(job->minutes, tm.tm_min + 1);
+    if (m < 0) {
+        m = __builtin_ctzll(job->minutes) + 60;
+    }
+    time_t delta = (time_t)(m - tm.tm_min) * 60 - tm.tm_sec;
+    time_t t = after + delta;
+
+    // Across a DST change the local clock does not advance by delta; the generic search knows the rules
+    struct tm check;
+    tz_localtime(t, &check);
+    return civil_seconds(&check) == civil_seconds(&tm) + delta ? t : next_fire_generic(job, after);
+}
+
+// DAILY and WEEKDAYS kinds: the next allowed time of day on an allowed weekday, at most a week away
+static time_t next_fire_daily(const cron_job *job, time_t after) {
+    struct tm tm;
+    tz_localtime(after, &tm);
+    time_t utc_offset = civil_seconds(&tm) - after;
+    time_t midnight = after + utc_offset - tm.tm_hour * 3600 - tm.tm_min * 60 - tm.tm_sec; // as civil seconds
+
+    int hour = tm.tm_hour;
+    int min = tm.tm_min + 1;
+    for (int day = 0; day <= 7; day++, hour = 0, min = 0) {
+        int wday = (tm.tm_wday + day) % 7;
+        if (!(job->daysofweek >> wday & 1)) {
+            continue;
+        }
+
+        int h = next_bit(job->hours, hour);
+        int m = h == hour ? next_bit(job->minutes, min) : -1;
+        if (h == hour && m < 0) {
+            h = next_bit(job->hours, hour + 1);
+        }
+        if (h < 0) {
+            continue;
+        }
+        if (m < 0) {
+            m = __builtin_ctzll(job->minutes);
+        }
+
+        // Same UTC offset as at `after` in the common case; across a DST change let the generic search convert
+        time_t civil = midnight + (time_t)day * 86400 + h * 3600 + m * 60;
+        time_t t = civil - utc_offset;
+        struct tm check;
+        tz_localtime(t, &check);
+        if (t > after && civil_seconds(&check) == civil) {
+            return t;
+        }
+        break;
+    }
+    return next_fire_generic(job, after);
+}
+
+time_t next_fire_time(const cron_job *job, time_t after) {
+    if (!job || (job->flags & CRON_NEVER_FIRES)) {
+        return CRON_NEVER;
+    }
+
+    switch (job->kind) {
+    case CRON_KIND_EVERY_MINUTE:
+        // Zones have kept whole-minute UTC offsets since 1972, so local minutes start on UTC ones
+        return after - after % 60 + 60;
+    case CRON_KIND_HOURLY:
+        return next_fire_hourly(job, after);
+    case CRON_KIND_DAILY:
+    case CRON_KIND_WEEKDAYS:
+        return next_fire_daily(job, after);
+    default:
+        return next_fire_generic(job, after);
     }
 }
 
@@ -289,39 +610,39 @@ void print_cron_job(const cron_job *job) {
     if (!job)
         return;
 
-    printf("Command: %s\n", job->command);
+    printf("Command: %.*s\n", (int)job->command_len, job->command);
 
     printf("Minutes: ");
     for (int i = 0; i < 60; i++) {
-        if (job->minutes[i])
+        if (job->minutes >> i & 1)
             printf("%d ", i);
     }
     printf("\n");
 
     printf("Hours: ");
     for (int i = 0; i < 24; i++) {
-        if (job->hours[i])
+        if (job->hours >> i & 1)
             printf("%d ", i);
     }
     printf("\n");
 
     printf("Days: ");
-    for (int i = 0; i < 31; i++) {
-        if (job->days[i])
-            printf("%d ", i + 1);
+    for (int i = 1; i <= 31; i++) {
+        if (job->days >> i & 1)
+            printf("%d ", i);
     }
     printf("\n");
 
     printf("Months: ");
     for (int i = 0; i < 12; i++) {
-        if (job->months[i])
+        if (job->months >> i & 1)
             printf("%d ", i + 1);
     }
     printf("\n");
 
     printf("Weekdays: ");
     for (int i = 0; i < 7; i++) {
-        if (job->daysofweek[i])
+        if (job->daysofweek >> i & 1)
             printf("%d ", i);
     }
     printf("\n");
@@ -0,0 +1,744 @@
+#ifndef _WIN32
+
+#include "wcron/platform.h"
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char **environ;
+
+typedef struct {
+    wcron_thread_fn fn;
+    void *arg;
+} thread_start_data;
+
+static void *thread_trampoline(void *param) {
+    thread_start_data data = *(thread_start_data *)param;
+    free(param);
+    data.fn(data.arg);
+    return NULL;
+}
+
+void wcron_mutex_init(wcron_mutex *mutex) {
+    pthread_mutex_init(mutex, NULL);
+}
+
+void wcron_mutex_lock(wcron_mutex *mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+void wcron_mutex_unlock(wcron_mutex *mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+void wcron_mutex_destroy(wcron_mutex *mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+int wcron_sem_init(wcron_sem *sem, unsigned initial) {
+    return sem_init(sem, 0, initial);
+}
+
+void wcron_sem_post(wcron_sem *sem) {
+    sem_post(sem);
+}
+
+void wcron_sem_wait(wcron_sem *sem) {
+    while (sem_wait(sem) != 0 && errno == EINTR) {
+    }
+}
+
+void wcron_sem_destroy(wcron_sem *sem) {
+    sem_destroy(sem);
+}
+
+int wcron_thread_start(wcron_thread *thread, wcron_thread_fn fn, void *arg) {
+    thread_start_data *data = malloc(sizeof(thread_start_data));
+    if (!data) {
+        return -1;
+    }
+    data->fn = fn;
+    data->arg = arg;
+
+    if (pthread_create(thread, NULL, thread_trampoline, data) != 0) {
+        free(data);
+        return -1;
+    }
+    return 0;
+}
+
+int wcron_thread_start_detached(wcron_thread_fn fn, void *arg) {
+    wcron_thread thread;
+    if (wcron_thread_start(&thread, fn, arg) != 0) {
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+void wcron_thread_join(wcron_thread thread) {
+    pthread_join(thread, NULL);
+}
+
+int wcron_event_create(wcron_event *event) {
+    *event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    return *event >= 0 ? 0 : -1;
+}
+
+void wcron_event_set(wcron_event event) {
+    uint64_t one = 1;
+    ssize_t r = write(event, &one, sizeof(one));
+    (void)r;
+}
+
+void wcron_event_reset(wcron_event event) {
+    uint64_t value;
+    ssize_t r = read(event, &value, sizeof(value));
+    (void)r;
+}
+
+void wcron_event_destroy(wcron_event event) {
+    close(event);
+}
+
+int wcron_timer_create(wcron_timer *timer) {
+    *timer = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC | TFD_NONBLOCK);
+    return *timer >= 0 ? 0 : -1;
+}
+
+int wcron_timer_set_at(wcron_timer timer, time_t when) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+
+    // A zero it_value disarms a timerfd
+    spec.it_value.tv_sec = when > 0 ? when : 0;
+    spec.it_value.tv_nsec = when > 0 ? 0 : 1;
+
+    // CANCEL_ON_SET wakes us when the clock is stepped, so the deadline gets recomputed
+    return timerfd_settime(timer, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, NULL);
+}
+
+void wcron_timer_cancel(wcron_timer timer) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    timerfd_settime(timer, 0, &spec, NULL);
+}
+
+int wcron_timer_set_after(wcron_timer timer, unsigned ms) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+
+    spec.it_value.tv_sec = ms / 1000;
+    spec.it_value.tv_nsec = (long)(ms % 1000) * 1000000;
+    if (ms == 0) {
+        spec.it_value.tv_nsec = 1; // zero would disarm
+    }
+    return timerfd_settime(timer, 0, &spec, NULL);
+}
+
+int wcron_timer_ack(wcron_timer timer) {
+    uint64_t expirations;
+    ssize_t r = read(timer, &expirations, sizeof(expirations));
+    return r < 0 && errno == ECANCELED;
+}
+
+void wcron_timer_destroy(wcron_timer timer) {
+    close(timer);
+}
+
+struct wcron_loop {
+    int epfd;
+};
+
+wcron_loop *wcron_loop_create(void) {
+    wcron_loop *loop = malloc(sizeof(wcron_loop));
+    if (!loop) {
+        return NULL;
+    }
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) {
+        free(loop);
+        return NULL;
+    }
+    return loop;
+}
+
+void wcron_loop_destroy(wcron_loop *loop) {
+    if (loop) {
+        close(loop->epfd);
+        free(loop);
+    }
+}
+
+int wcron_loop_add(wcron_loop *loop, wcron_handle handle, void *tag) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = tag;
+    return epoll_ctl(loop->epfd, EPOLL_CTL_ADD, handle, &ev);
+}
+
+void wcron_loop_remove(wcron_loop *loop, wcron_handle handle) {
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, handle, NULL);
+}
+
+int wcron_loop_wait(wcron_loop *loop, int timeout_ms, void **tag) {
+    // One event per call: a handler may remove other handles, so nothing is buffered
+    struct epoll_event ev;
+    int r;
+
+    do {
+        r = epoll_wait(loop->epfd, &ev, 1, timeout_ms);
+    } while (r < 0 && errno == EINTR);
+
+    if (r <= 0) {
+        return r;
+    }
+    *tag = ev.data.ptr;
+    return 1;
+}
+
+struct wcron_file_watch {
+    int fd;
+    char name[256]; // file name inside the watched directory
+};
+
+wcron_file_watch *wcron_file_watch_create(const char *path) {
+    const char *slash = strrchr(path, '/');
+    const char *name = slash ? slash + 1 : path;
+    size_t dir_len = slash ? (size_t)(slash - path) : 0;
+
+    char dir[4096];
+    if (strlen(name) >= sizeof(((wcron_file_watch *)0)->name) || dir_len >= sizeof(dir)) {
+        return NULL;
+    }
+    if (slash) {
+        memcpy(dir, path, dir_len);
+        dir[dir_len] = '\0';
+        if (dir_len == 0) {
+            strcpy(dir, "/");
+        }
+    } else {
+        strcpy(dir, ".");
+    }
+
+    wcron_file_watch *watch = malloc(sizeof(wcron_file_watch));
+    if (!watch) {
+        return NULL;
+    }
+    strcpy(watch->name, name);
+
+    watch->fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    // CLOSE_WRITE rather than MODIFY: one event per save instead of one per write()
+    if (watch->fd < 0 ||
+        inotify_add_watch(watch->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+        wcron_file_watch_destroy(watch);
+        return NULL;
+    }
+    return watch;
+}
+
+wcron_handle wcron_file_watch_handle(const wcron_file_watch *watch) {
+    return watch->fd;
+}
+
+int wcron_file_watch_ack(wcron_file_watch *watch) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int touched = 0;
+    ssize_t len;
+
+    while ((len = read(watch->fd, buffer, sizeof(buffer))) > 0) {
+        for (char *p = buffer; p < buffer + len;) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            // An overflowed queue lost events, so assume ours was among them
+            if ((ev->mask & IN_Q_OVERFLOW) || (ev->len > 0 && strcmp(ev->name, watch->name) == 0)) {
+                touched = 1;
+            }
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+    return touched;
+}
+
+void wcron_file_watch_destroy(wcron_file_watch *watch) {
+    if (watch) {
+        if (watch->fd >= 0) {
+            close(watch->fd);
+        }
+        free(watch);
+    }
+}
+
+int wcron_spawn(const char *command, wcron_process *process, wcron_handle output) {
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t actions;
+    if (posix_spawnattr_init(&attr) != 0) {
+        return -1;
+    }
+    if (posix_spawn_file_actions_init(&actions) != 0) {
+        posix_spawnattr_destroy(&attr);
+        return -1;
+    }
+    if (output >= 0) {
+        posix_spawn_file_actions_adddup2(&actions, output, STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, output, STDERR_FILENO);
+    }
+
+    // The daemon blocks its control signals for signalfd; jobs get the defaults back
+    sigset_t empty, defaults;
+    sigemptyset(&empty);
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGTERM);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGHUP);
+    sigaddset(&defaults, SIGUSR1);
+    sigaddset(&defaults, SIGUSR2);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigmask(&attr, &empty);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    char *argv[] = {"/bin/sh", "-c", (char *)command, NULL};
+    int r = posix_spawn(&process->pid, "/bin/sh", &actions, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    if (r != 0) {
+        return -1;
+    }
+
+    process->fd = -1;
+#ifdef SYS_pidfd_open
+    // The pid cannot be recycled before we reap it, so opening it after the spawn is safe
+    process->fd = (int)syscall(SYS_pidfd_open, process->pid, 0);
+#endif
+    return 0;
+}
+
+int wcron_process_handle(const wcron_process *process, wcron_handle *handle) {
+    if (process->fd < 0) {
+        return -1;
+    }
+    *handle = process->fd;
+    return 0;
+}
+
+static int exit_code_of(int status) {
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+int wcron_process_wait(wcron_process *process, int *exit_code) {
+    int status;
+    pid_t r;
+
+    do {
+        r = waitpid(process->pid, &status, 0);
+    } while (r < 0 && errno == EINTR);
+
+    if (process->fd >= 0) {
+        close(process->fd);
+        process->fd = -1;
+    }
+
+    if (r < 0) {
+        return -1;
+    }
+
+    if (exit_code) {
+        *exit_code = exit_code_of(status);
+    }
+    return 0;
+}
+
+void wcron_process_release(wcron_process *process) {
+    if (process->fd >= 0) {
+        close(process->fd);
+        process->fd = -1;
+    }
+}
+
+int wcron_child_watch_create(wcron_handle *watch) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    int fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    *watch = fd;
+    return 0;
+}
+
+void wcron_child_watch_ack(wcron_handle watch) {
+    struct signalfd_siginfo si;
+    // Notices of several exits merge into one: the caller reaps until none is left
+    while (read(watch, &si, sizeof(si)) == (ssize_t)sizeof(si)) {
+    }
+}
+
+int wcron_child_reap(long *pid, int *exit_code) {
+    int status;
+    pid_t r;
+    do {
+        r = waitpid(-1, &status, WNOHANG);
+    } while (r < 0 && errno == EINTR);
+    if (r <= 0) {
+        return 0;
+    }
+    *pid = (long)r;
+    *exit_code = exit_code_of(status);
+    return 1;
+}
+
+int wcron_pipe_create(wcron_handle *read_end, wcron_handle *write_end) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        return -1;
+    }
+    // Only our end is non-blocking; the child writes as usual and waits when the pipe is full
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    *read_end = fds[0];
+    *write_end = fds[1];
+    return 0;
+}
+
+long wcron_pipe_read(wcron_handle pipe, void *buffer, size_t size) {
+    ssize_t n;
+    do {
+        n = read(pipe, buffer, size);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? -1 : 0;
+    }
+    return (long)n;
+}
+
+long wcron_pipe_splice(wcron_handle pipe, wcron_handle file, size_t size) {
+#ifdef SPLICE_F_MOVE
+    ssize_t n;
+    do {
+        n = splice(pipe, NULL, file, NULL, size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    } while (n < 0 && errno == EINTR);
+
+    if (n >= 0) {
+        return (long)n;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return -1;
+    }
+    if (errno != EINVAL) {
+        return -2;
+    }
+    // The file system cannot splice: copy instead
+#endif
+    char buffer[16 * 1024];
+    long n_read = wcron_pipe_read(pipe, buffer, size < sizeof(buffer) ? size : sizeof(buffer));
+    if (n_read > 0 && wcron_file_write(file, buffer, (size_t)n_read) != n_read) {
+        return -2;
+    }
+    return n_read;
+}
+
+void wcron_handle_close(wcron_handle handle) {
+    if (handle >= 0) {
+        close(handle);
+    }
+}
+
+int wcron_file_open_append(const char *path, wcron_handle *file) {
+    // Not O_APPEND: splice() refuses files opened that way, so the position is kept at the end instead
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    if (lseek(fd, 0, SEEK_END) < 0) {
+        close(fd);
+        return -1;
+    }
+    *file = fd;
+    return 0;
+}
+
+int64_t wcron_file_size(wcron_handle file) {
+    struct stat st;
+    return fstat(file, &st) == 0 ? (int64_t)st.st_size : -1;
+}
+
+long wcron_file_read_at(wcron_handle file, int64_t offset, void *buffer, size_t size) {
+    ssize_t n;
+    do {
+        n = pread(file, buffer, size, (off_t)offset);
+    } while (n < 0 && errno == EINTR);
+    return (long)n;
+}
+
+long wcron_file_write(wcron_handle file, const void *buffer, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = write(file, (const char *)buffer + done, size - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    return (long)done;
+}
+
+int wcron_file_truncate(wcron_handle file, int64_t size) {
+    if (ftruncate(file, (off_t)size) != 0) {
+        return -1;
+    }
+    return lseek(file, (off_t)size, SEEK_SET) < 0 ? -1 : 0;
+}
+
+int wcron_make_dir(const char *path) {
+    return mkdir(path, 0755) == 0 || errno == EEXIST ? 0 : -1;
+}
+
+int wcron_file_replace(const char *from, const char *to) {
+    return rename(from, to) == 0 ? 0 : -1;
+}
+
+static int socket_address(const char *path, struct sockaddr_un *addr) {
+    size_t len = strlen(path);
+    if (len >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path, path, len + 1);
+    return 0;
+}
+
+int wcron_socket_listen(const char *path, wcron_handle *listener) {
+    struct sockaddr_un addr;
+    if (socket_address(path, &addr) != 0) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    // A socket file left by a daemon that did not stop cleanly would make bind() fail; one a daemon still
+    // answers on is not ours to take
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe < 0) {
+        close(fd);
+        return -1;
+    }
+    int live = connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+    int err = errno;
+    close(probe);
+    if (live || (err != ECONNREFUSED && err != ENOENT)) {
+        close(fd);
+        errno = live ? EADDRINUSE : err;
+        return -1;
+    }
+    unlink(path);
+    // Nobody can connect before listen(), so tightening the mode in between leaves no window
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || chmod(path, 0600) != 0 || listen(fd, 16) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    *listener = fd;
+    return 0;
+}
+
+int wcron_socket_accept(wcron_handle listener, wcron_handle *conn) {
+    int fd;
+    do {
+        fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0) {
+        return -1;
+    }
+    *conn = fd;
+    return 0;
+}
+
+int wcron_socket_connect(const char *path, wcron_handle *conn) {
+    struct sockaddr_un addr;
+    if (socket_address(path, &addr) != 0) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    *conn = fd;
+    return 0;
+}
+
+long wcron_socket_recv(wcron_handle conn, void *buffer, size_t size) {
+    return wcron_pipe_read(conn, buffer, size);
+}
+
+long wcron_socket_send(wcron_handle conn, const void *buffer, size_t size) {
+    ssize_t n;
+    do {
+        n = send(conn, buffer, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+    } while (n < 0 && errno == EINTR);
+    return n < 0 ? -1 : (long)n;
+}
+
+long wcron_current_pid(void) {
+    return (long)getpid();
+}
+
+int wcron_executable_path(char *buffer, size_t length) {
+    if (length == 0) {
+        return -1;
+    }
+
+    ssize_t len = readlink("/proc/self/exe", buffer, length - 1);
+    if (len <= 0) {
+        return -1;
+    }
+    buffer[len] = '\0';
+    return 0;
+}
+
+int wcron_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+int wcron_file_sync(FILE *fp) {
+    if (fflush(fp) != 0) {
+        return -1;
+    }
+    return fsync(fileno(fp));
+}
+
+int wcron_map_file(const char *path, wcron_mapping *mapping) {
+    mapping->data = NULL;
+    mapping->size = 0;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (st.st_size > 0) {
+        void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        mapping->data = data;
+        mapping->size = (size_t)st.st_size;
+    }
+
+    // The mapping keeps its own reference to the file
+    close(fd);
+    return 0;
+}
+
+int wcron_map_shared(const char *path, size_t size, wcron_mapping *mapping) {
+    mapping->data = NULL;
+    mapping->size = 0;
+
+    // Readable by anyone, like the log: monitoring agents need not run as the daemon's user
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (st.st_size < (off_t)size && ftruncate(fd, (off_t)size) != 0)) {
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size > size) {
+        size = (size_t)st.st_size;
+    }
+
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+    mapping->data = data;
+    mapping->size = size;
+    return 0;
+}
+
+void wcron_unmap_file(wcron_mapping *mapping) {
+    if (mapping->data) {
+        munmap(mapping->data, mapping->size);
+    }
+    mapping->data = NULL;
+    mapping->size = 0;
+}
+
+uint64_t wcron_monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+uint64_t wcron_monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+uint64_t wcron_boot_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+int64_t wcron_realtime_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void wcron_sleep_ms(unsigned ms) {
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+#endif // _WIN32
@@ -0,0 +1,820 @@
+#ifdef _WIN32
+
+#include "wcron/platform.h"
+#include <io.h>
+#include <process.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <windows.h>
+
+typedef struct {
+    wcron_thread_fn fn;
+    void *arg;
+} thread_start_data;
+
+static unsigned __stdcall thread_trampoline(void *param) {
+    thread_start_data data = *(thread_start_data *)param;
+    free(param);
+    data.fn(data.arg);
+    return 0;
+}
+
+void wcron_mutex_init(wcron_mutex *mutex) {
+    InitializeCriticalSection(mutex);
+}
+
+void wcron_mutex_lock(wcron_mutex *mutex) {
+    EnterCriticalSection(mutex);
+}
+
+void wcron_mutex_unlock(wcron_mutex *mutex) {
+    LeaveCriticalSection(mutex);
+}
+
+void wcron_mutex_destroy(wcron_mutex *mutex) {
+    DeleteCriticalSection(mutex);
+}
+
+int wcron_sem_init(wcron_sem *sem, unsigned initial) {
+    *sem = CreateSemaphore(NULL, (LONG)initial, 0x7fffffff, NULL);
+    return *sem ? 0 : -1;
+}
+
+void wcron_sem_post(wcron_sem *sem) {
+    ReleaseSemaphore(*sem, 1, NULL);
+}
+
+void wcron_sem_wait(wcron_sem *sem) {
+    WaitForSingleObject(*sem, INFINITE);
+}
+
+void wcron_sem_destroy(wcron_sem *sem) {
+    CloseHandle(*sem);
+}
+
+int wcron_thread_start(wcron_thread *thread, wcron_thread_fn fn, void *arg) {
+    thread_start_data *data = malloc(sizeof(thread_start_data));
+    if (!data) {
+        return -1;
+    }
+    data->fn = fn;
+    data->arg = arg;
+
+    uintptr_t handle = _beginthreadex(NULL, 0, thread_trampoline, data, 0, NULL);
+    if (handle == 0) {
+        free(data);
+        return -1;
+    }
+
+    *thread = (HANDLE)handle;
+    return 0;
+}
+
+int wcron_thread_start_detached(wcron_thread_fn fn, void *arg) {
+    wcron_thread thread;
+    if (wcron_thread_start(&thread, fn, arg) != 0) {
+        return -1;
+    }
+    CloseHandle(thread);
+    return 0;
+}
+
+void wcron_thread_join(wcron_thread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+int wcron_event_create(wcron_event *event) {
+    *event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    return *event ? 0 : -1;
+}
+
+void wcron_event_set(wcron_event event) {
+    SetEvent(event);
+}
+
+void wcron_event_reset(wcron_event event) {
+    ResetEvent(event);
+}
+
+void wcron_event_destroy(wcron_event event) {
+    CloseHandle(event);
+}
+
+int wcron_timer_create(wcron_timer *timer) {
+    *timer = CreateWaitableTimer(NULL, FALSE, NULL);
+    return *timer ? 0 : -1;
+}
+
+int wcron_timer_set_at(wcron_timer timer, time_t when) {
+    LARGE_INTEGER due_time;
+    // Positive due time is absolute UTC in 100 ns units since 1601-01-01
+    due_time.QuadPart = ((LONGLONG)when + 11644473600LL) * 10000000LL;
+    return SetWaitableTimer(timer, &due_time, 0, NULL, NULL, FALSE) ? 0 : -1;
+}
+
+void wcron_timer_cancel(wcron_timer timer) {
+    CancelWaitableTimer(timer);
+}
+
+int wcron_timer_set_after(wcron_timer timer, unsigned ms) {
+    LARGE_INTEGER due_time;
+    // Negative due time is relative, in 100 ns units
+    due_time.QuadPart = -(LONGLONG)ms * 10000LL;
+    return SetWaitableTimer(timer, &due_time, 0, NULL, NULL, FALSE) ? 0 : -1;
+}
+
+int wcron_timer_ack(wcron_timer timer) {
+    (void)timer; // auto-reset timer; absolute due times already follow clock changes
+    return 0;
+}
+
+void wcron_timer_destroy(wcron_timer timer) {
+    CancelWaitableTimer(timer);
+    CloseHandle(timer);
+}
+
+// Handles past the first wait set go to groups, each waited on by a thread of its own. A group thread that sees
+// a handle fire parks until the loop has dispatched it, so the loop can change a group only while it is parked.
+#define LOOP_DIRECT (MAXIMUM_WAIT_OBJECTS - 1) // one slot of the direct set is the groups' ready event
+#define LOOP_GROUP (MAXIMUM_WAIT_OBJECTS - 1)  // one slot of a group is its wake event
+
+typedef enum {
+    GROUP_RUNNING,   // its thread waits on the handles
+    GROUP_PARKED,    // stopped, nothing fired
+    GROUP_PENDING,   // stopped on a fired handle the loop has not returned yet
+    GROUP_DISPATCHED // stopped, the fired handle was returned by the last wait
+} loop_group_state;
+
+typedef struct {
+    HANDLE handles[MAXIMUM_WAIT_OBJECTS]; // [0] is wake
+    void *tags[MAXIMUM_WAIT_OBJECTS];
+    int count; // handles after wake
+    int fired; // index of the handle that stopped the thread, 0 if it was woken
+    int stopping;
+    HANDLE wake;   // auto-reset: stop waiting and park
+    HANDLE parked; // auto-reset: the thread parked
+    HANDLE resume; // auto-reset: wait again, or exit if stopping
+    HANDLE ready;  // the loop's, set when a handle fired
+    loop_group_state state;
+    wcron_thread thread;
+} loop_group;
+
+struct wcron_loop {
+    HANDLE handles[MAXIMUM_WAIT_OBJECTS]; // [0] is ready
+    void *tags[MAXIMUM_WAIT_OBJECTS];
+    int count; // handles after ready
+    HANDLE ready;
+    loop_group **groups;
+    int group_count;
+};
+
+static void loop_group_thread(void *arg) {
+    loop_group *group = (loop_group *)arg;
+    for (;;) {
+        DWORD result = WaitForMultipleObjects((DWORD)(group->count + 1), group->handles, FALSE, INFINITE);
+        group->fired = result > WAIT_OBJECT_0 && result <= WAIT_OBJECT_0 + (DWORD)group->count
+                           ? (int)(result - WAIT_OBJECT_0)
+                           : 0;
+        SetEvent(group->parked);
+        if (group->fired) {
+            SetEvent(group->ready);
+        }
+        WaitForSingleObject(group->resume, INFINITE);
+        if (group->stopping) {
+            return;
+        }
+    }
+}
+
+// Stop the group's thread so its handles can change
+static void loop_group_park(loop_group *group) {
+    if (group->state != GROUP_RUNNING) {
+        return;
+    }
+    SetEvent(group->wake);
+    WaitForSingleObject(group->parked, INFINITE);
+    // A handle may have fired before the wake got through
+    group->state = group->fired ? GROUP_PENDING : GROUP_PARKED;
+}
+
+static void loop_group_resume(loop_group *group) {
+    ResetEvent(group->wake); // left over if a handle fired first
+    group->fired = 0;
+    group->state = GROUP_RUNNING;
+    SetEvent(group->resume);
+}
+
+static void loop_group_destroy(loop_group *group) {
+    loop_group_park(group);
+    group->stopping = 1;
+    SetEvent(group->resume);
+    wcron_thread_join(group->thread);
+    CloseHandle(group->wake);
+    CloseHandle(group->parked);
+    CloseHandle(group->resume);
+    free(group);
+}
+
+static loop_group *loop_group_create(wcron_loop *loop) {
+    loop_group **groups = realloc(loop->groups, sizeof(loop_group *) * (size_t)(loop->group_count + 1));
+    if (!groups) {
+        return NULL;
+    }
+    loop->groups = groups;
+
+    loop_group *group = calloc(1, sizeof(loop_group));
+    if (!group) {
+        return NULL;
+    }
+    group->wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+    group->parked = CreateEvent(NULL, FALSE, FALSE, NULL);
+    group->resume = CreateEvent(NULL, FALSE, FALSE, NULL);
+    group->ready = loop->ready;
+    group->handles[0] = group->wake;
+    // The thread waits on its wake alone until the first handle is added
+    group->state = GROUP_RUNNING;
+    if (!group->wake || !group->parked || !group->resume ||
+        wcron_thread_start(&group->thread, loop_group_thread, group) != 0) {
+        if (group->wake) {
+            CloseHandle(group->wake);
+        }
+        if (group->parked) {
+            CloseHandle(group->parked);
+        }
+        if (group->resume) {
+            CloseHandle(group->resume);
+        }
+        free(group);
+        return NULL;
+    }
+    loop->groups[loop->group_count++] = group;
+    return group;
+}
+
+wcron_loop *wcron_loop_create(void) {
+    wcron_loop *loop = calloc(1, sizeof(wcron_loop));
+    if (!loop) {
+        return NULL;
+    }
+    loop->ready = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!loop->ready) {
+        free(loop);
+        return NULL;
+    }
+    loop->handles[0] = loop->ready;
+    return loop;
+}
+
+void wcron_loop_destroy(wcron_loop *loop) {
+    for (int i = 0; i < loop->group_count; i++) {
+        loop_group_destroy(loop->groups[i]);
+    }
+    free(loop->groups);
+    CloseHandle(loop->ready);
+    free(loop);
+}
+
+int wcron_loop_add(wcron_loop *loop, wcron_handle handle, void *tag) {
+    if (loop->count < LOOP_DIRECT) {
+        loop->count++;
+        loop->handles[loop->count] = handle;
+        loop->tags[loop->count] = tag;
+        return 0;
+    }
+
+    loop_group *group = NULL;
+    for (int i = 0; i < loop->group_count && !group; i++) {
+        if (loop->groups[i]->count < LOOP_GROUP) {
+            group = loop->groups[i];
+        }
+    }
+    if (!group && !(group = loop_group_create(loop))) {
+        return -1;
+    }
+    loop_group_park(group);
+    group->count++;
+    group->handles[group->count] = handle;
+    group->tags[group->count] = tag;
+    return 0;
+}
+
+void wcron_loop_remove(wcron_loop *loop, wcron_handle handle) {
+    for (int i = 1; i <= loop->count; i++) {
+        if (loop->handles[i] == handle) {
+            loop->handles[i] = loop->handles[loop->count];
+            loop->tags[i] = loop->tags[loop->count];
+            loop->count--;
+            return;
+        }
+    }
+
+    for (int g = 0; g < loop->group_count; g++) {
+        loop_group *group = loop->groups[g];
+        for (int i = 1; i <= group->count; i++) {
+            if (group->handles[i] != handle) {
+                continue;
+            }
+            // Parked, the thread no longer waits on the handle the caller is about to close
+            loop_group_park(group);
+            if (group->fired == i) {
+                group->fired = 0;
+                group->state = GROUP_PARKED;
+            } else if (group->fired == group->count) {
+                group->fired = i;
+            }
+            group->handles[i] = group->handles[group->count];
+            group->tags[i] = group->tags[group->count];
+            group->count--;
+            return;
+        }
+    }
+}
+
+// Return a handle a group thread stopped on, if any
+static int loop_take_pending(wcron_loop *loop, void **tag) {
+    for (int g = 0; g < loop->group_count; g++) {
+        loop_group *group = loop->groups[g];
+        if (group->state == GROUP_RUNNING && WaitForSingleObject(group->parked, 0) == WAIT_OBJECT_0) {
+            group->state = GROUP_PENDING;
+        }
+        if (group->state == GROUP_PENDING) {
+            *tag = group->tags[group->fired];
+            group->state = GROUP_DISPATCHED;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int wcron_loop_wait(wcron_loop *loop, int timeout_ms, void **tag) {
+    // What the last wait returned has been handled: watch the groups again
+    for (int g = 0; g < loop->group_count; g++) {
+        if (loop->groups[g]->state == GROUP_PARKED || loop->groups[g]->state == GROUP_DISPATCHED) {
+            loop_group_resume(loop->groups[g]);
+        }
+    }
+
+    uint64_t deadline = timeout_ms < 0 ? 0 : wcron_monotonic_ms() + (uint64_t)timeout_ms;
+    for (;;) {
+        if (loop_take_pending(loop, tag)) {
+            return 1;
+        }
+        DWORD wait_ms = INFINITE;
+        if (timeout_ms >= 0) {
+            uint64_t now = wcron_monotonic_ms();
+            wait_ms = now < deadline ? (DWORD)(deadline - now) : 0;
+        }
+        DWORD result = WaitForMultipleObjects((DWORD)(loop->count + 1), loop->handles, FALSE, wait_ms);
+        if (result == WAIT_TIMEOUT) {
+            return 0;
+        }
+        if (result > WAIT_OBJECT_0 && result <= WAIT_OBJECT_0 + (DWORD)loop->count) {
+            *tag = loop->tags[result - WAIT_OBJECT_0];
+            return 1;
+        }
+        if (result != WAIT_OBJECT_0) {
+            return -1;
+        }
+        // ready: a group stopped on a handle, or a stale signal from one already taken
+    }
+}
+
+struct wcron_file_watch {
+    HANDLE dir;
+    HANDLE event;
+    OVERLAPPED overlapped;
+    WCHAR name[MAX_PATH]; // file name inside the watched directory
+    DWORD buffer[1024];   // FILE_NOTIFY_INFORMATION records, DWORD aligned
+};
+
+// Queue the next asynchronous directory read; completion signals watch->event
+static int file_watch_arm(wcron_file_watch *watch) {
+    ZeroMemory(&watch->overlapped, sizeof(watch->overlapped));
+    watch->overlapped.hEvent = watch->event;
+    return ReadDirectoryChangesW(watch->dir, watch->buffer, sizeof(watch->buffer), FALSE,
+                                 FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, NULL,
+                                 &watch->overlapped, NULL)
+               ? 0
+               : -1;
+}
+
+wcron_file_watch *wcron_file_watch_create(const char *path) {
+    const char *sep = strrchr(path, '\\');
+    const char *name = sep ? sep + 1 : path;
+    char dir[MAX_PATH];
+    size_t dir_len = sep ? (size_t)(sep - path) : 0;
+
+    if (dir_len >= sizeof(dir)) {
+        return NULL;
+    }
+    if (sep) {
+        memcpy(dir, path, dir_len);
+        dir[dir_len] = '\0';
+    } else {
+        strcpy(dir, ".");
+    }
+
+    wcron_file_watch *watch = calloc(1, sizeof(wcron_file_watch));
+    if (!watch) {
+        return NULL;
+    }
+    if (MultiByteToWideChar(CP_ACP, 0, name, -1, watch->name, MAX_PATH) == 0) {
+        free(watch);
+        return NULL;
+    }
+
+    watch->dir = CreateFileA(dir, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                             OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (watch->dir == INVALID_HANDLE_VALUE) {
+        free(watch);
+        return NULL;
+    }
+    watch->event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!watch->event || file_watch_arm(watch) != 0) {
+        wcron_file_watch_destroy(watch);
+        return NULL;
+    }
+    return watch;
+}
+
+wcron_handle wcron_file_watch_handle(const wcron_file_watch *watch) {
+    return watch->event;
+}
+
+int wcron_file_watch_ack(wcron_file_watch *watch) {
+    DWORD bytes = 0;
+    int touched = 0;
+
+    if (!GetOverlappedResult(watch->dir, &watch->overlapped, &bytes, FALSE)) {
+        touched = 1;
+    } else if (bytes == 0) {
+        // The buffer overflowed and the changes were dropped, so assume ours was among them
+        touched = 1;
+    } else {
+        BYTE *p = (BYTE *)watch->buffer;
+        for (;;) {
+            FILE_NOTIFY_INFORMATION *info = (FILE_NOTIFY_INFORMATION *)p;
+            size_t len = info->FileNameLength / sizeof(WCHAR);
+            if (len == wcslen(watch->name) && _wcsnicmp(info->FileName, watch->name, len) == 0) {
+                touched = 1;
+            }
+            if (info->NextEntryOffset == 0) {
+                break;
+            }
+            p += info->NextEntryOffset;
+        }
+    }
+
+    ResetEvent(watch->event);
+    file_watch_arm(watch);
+    return touched;
+}
+
+void wcron_file_watch_destroy(wcron_file_watch *watch) {
+    if (!watch) {
+        return;
+    }
+    if (watch->dir && watch->dir != INVALID_HANDLE_VALUE) {
+        CancelIo(watch->dir);
+        CloseHandle(watch->dir);
+    }
+    if (watch->event) {
+        CloseHandle(watch->event);
+    }
+    free(watch);
+}
+
+int wcron_spawn(const char *command, wcron_process *process, wcron_handle output) {
+    STARTUPINFOA si;
+    PROCESS_INFORMATION pi;
+
+    ZeroMemory(&si, sizeof(si));
+    si.cb = sizeof(si);
+    ZeroMemory(&pi, sizeof(pi));
+
+    // The output handle is inheritable only for the duration of the call. A job started by
+    // another launcher meanwhile may inherit it too, which only keeps the file open longer.
+    BOOL inherit = FALSE;
+    if (output != WCRON_NO_HANDLE && SetHandleInformation(output, HANDLE_FLAG_INHERIT, HANDLE_FLAG_INHERIT)) {
+        si.dwFlags = STARTF_USESTDHANDLES;
+        si.hStdInput = NULL;
+        si.hStdOutput = output;
+        si.hStdError = output;
+        inherit = TRUE;
+    }
+
+    BOOL ok = CreateProcessA(NULL, (LPSTR)command, NULL, NULL, inherit, CREATE_NO_WINDOW, NULL, NULL, &si, &pi);
+    if (inherit) {
+        SetHandleInformation(output, HANDLE_FLAG_INHERIT, 0);
+    }
+    if (!ok) {
+        return -1;
+    }
+
+    CloseHandle(pi.hThread);
+    process->process = pi.hProcess;
+    process->pid = pi.dwProcessId;
+    return 0;
+}
+
+int wcron_process_handle(const wcron_process *process, wcron_handle *handle) {
+    *handle = process->process;
+    return 0;
+}
+
+int wcron_process_wait(wcron_process *process, int *exit_code) {
+    DWORD code = 0;
+
+    WaitForSingleObject(process->process, INFINITE);
+    BOOL ok = GetExitCodeProcess(process->process, &code);
+    CloseHandle(process->process);
+    process->process = NULL;
+
+    if (exit_code) {
+        *exit_code = (int)code;
+    }
+    return ok ? 0 : -1;
+}
+
+void wcron_process_release(wcron_process *process) {
+    if (process->process) {
+        CloseHandle(process->process);
+        process->process = NULL;
+    }
+}
+
+int wcron_child_watch_create(wcron_handle *watch) {
+    (void)watch;
+    return -1;
+}
+
+void wcron_child_watch_ack(wcron_handle watch) {
+    (void)watch;
+}
+
+int wcron_child_reap(long *pid, int *exit_code) {
+    (void)pid;
+    (void)exit_code;
+    return 0;
+}
+
+int wcron_pipe_create(wcron_handle *read_end, wcron_handle *write_end) {
+    // Anonymous pipes cannot be waited on with WaitForMultipleObjects
+    (void)read_end;
+    (void)write_end;
+    return -1;
+}
+
+long wcron_pipe_read(wcron_handle pipe, void *buffer, size_t size) {
+    DWORD n = 0;
+    if (!ReadFile(pipe, buffer, (DWORD)size, &n, NULL)) {
+        return 0;
+    }
+    return (long)n;
+}
+
+long wcron_pipe_splice(wcron_handle pipe, wcron_handle file, size_t size) {
+    char buffer[16 * 1024];
+    long n = wcron_pipe_read(pipe, buffer, size < sizeof(buffer) ? size : sizeof(buffer));
+    if (n > 0 && wcron_file_write(file, buffer, (size_t)n) != n) {
+        return -2;
+    }
+    return n;
+}
+
+void wcron_handle_close(wcron_handle handle) {
+    if (handle != WCRON_NO_HANDLE) {
+        CloseHandle(handle);
+    }
+}
+
+int wcron_file_open_append(const char *path, wcron_handle *file) {
+    HANDLE h = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+    LARGE_INTEGER zero, end;
+    zero.QuadPart = 0;
+    if (!SetFilePointerEx(h, zero, &end, FILE_END)) {
+        CloseHandle(h);
+        return -1;
+    }
+    *file = h;
+    return 0;
+}
+
+int64_t wcron_file_size(wcron_handle file) {
+    LARGE_INTEGER size;
+    return GetFileSizeEx(file, &size) ? (int64_t)size.QuadPart : -1;
+}
+
+long wcron_file_read_at(wcron_handle file, int64_t offset, void *buffer, size_t size) {
+    // Reading through an OVERLAPPED offset moves the position, so put it back afterwards
+    LARGE_INTEGER zero, position;
+    zero.QuadPart = 0;
+    if (!SetFilePointerEx(file, zero, &position, FILE_CURRENT)) {
+        return -1;
+    }
+
+    OVERLAPPED at;
+    ZeroMemory(&at, sizeof(at));
+    at.Offset = (DWORD)offset;
+    at.OffsetHigh = (DWORD)(offset >> 32);
+    DWORD n = 0;
+    BOOL ok = ReadFile(file, buffer, (DWORD)size, &n, &at);
+    SetFilePointerEx(file, position, NULL, FILE_BEGIN);
+    return ok ? (long)n : -1;
+}
+
+long wcron_file_write(wcron_handle file, const void *buffer, size_t size) {
+    DWORD n = 0;
+    if (!WriteFile(file, buffer, (DWORD)size, &n, NULL) || n != size) {
+        return -1;
+    }
+    return (long)n;
+}
+
+int wcron_file_truncate(wcron_handle file, int64_t size) {
+    LARGE_INTEGER at;
+    at.QuadPart = size;
+    return SetFilePointerEx(file, at, NULL, FILE_BEGIN) && SetEndOfFile(file) ? 0 : -1;
+}
+
+int wcron_make_dir(const char *path) {
+    return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS ? 0 : -1;
+}
+
+int wcron_file_replace(const char *from, const char *to) {
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+}
+
+// No control socket: the service is driven through the SCM
+int wcron_socket_listen(const char *path, wcron_handle *listener) {
+    (void)path;
+    (void)listener;
+    return -1;
+}
+
+int wcron_socket_accept(wcron_handle listener, wcron_handle *conn) {
+    (void)listener;
+    (void)conn;
+    return -1;
+}
+
+int wcron_socket_connect(const char *path, wcron_handle *conn) {
+    (void)path;
+    (void)conn;
+    return -1;
+}
+
+long wcron_socket_recv(wcron_handle conn, void *buffer, size_t size) {
+    (void)conn;
+    (void)buffer;
+    (void)size;
+    return 0;
+}
+
+long wcron_socket_send(wcron_handle conn, const void *buffer, size_t size) {
+    (void)conn;
+    (void)buffer;
+    (void)size;
+    return -1;
+}
+
+long wcron_current_pid(void) {
+    return (long)GetCurrentProcessId();
+}
+
+int wcron_executable_path(char *buffer, size_t length) {
+    DWORD len = GetModuleFileName(NULL, buffer, (DWORD)length);
+    return len > 0 && len < length ? 0 : -1;
+}
+
+int wcron_cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+int wcron_file_sync(FILE *fp) {
+    if (fflush(fp) != 0) {
+        return -1;
+    }
+    return _commit(_fileno(fp));
+}
+
+int wcron_map_file(const char *path, wcron_mapping *mapping) {
+    ZeroMemory(mapping, sizeof(*mapping));
+
+    mapping->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mapping->file == INVALID_HANDLE_VALUE) {
+        mapping->file = NULL;
+        return -1;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mapping->file, &size)) {
+        CloseHandle(mapping->file);
+        mapping->file = NULL;
+        return -1;
+    }
+    if (size.QuadPart == 0) {
+        return 0;
+    }
+
+    mapping->mapping = CreateFileMappingA(mapping->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping->mapping) {
+        mapping->data = MapViewOfFile(mapping->mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (!mapping->data) {
+        wcron_unmap_file(mapping);
+        return -1;
+    }
+    mapping->size = (size_t)size.QuadPart;
+    return 0;
+}
+
+int wcron_map_shared(const char *path, size_t size, wcron_mapping *mapping) {
+    ZeroMemory(mapping, sizeof(*mapping));
+
+    mapping->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mapping->file == INVALID_HANDLE_VALUE) {
+        mapping->file = NULL;
+        return -1;
+    }
+
+    LARGE_INTEGER current;
+    if (!GetFileSizeEx(mapping->file, &current)) {
+        wcron_unmap_file(mapping);
+        return -1;
+    }
+    if ((uint64_t)current.QuadPart > size) {
+        size = (size_t)current.QuadPart;
+    }
+
+    // A mapping larger than the file grows it
+    uint64_t size64 = size;
+    mapping->mapping = CreateFileMappingA(mapping->file, NULL, PAGE_READWRITE, (DWORD)(size64 >> 32), (DWORD)size64,
+                                          NULL);
+    if (mapping->mapping) {
+        mapping->data = MapViewOfFile(mapping->mapping, FILE_MAP_WRITE, 0, 0, size);
+    }
+    if (!mapping->data) {
+        wcron_unmap_file(mapping);
+        return -1;
+    }
+    mapping->size = size;
+    return 0;
+}
+
+void wcron_unmap_file(wcron_mapping *mapping) {
+    if (mapping->data) {
+        UnmapViewOfFile(mapping->data);
+    }
+    if (mapping->mapping) {
+        CloseHandle(mapping->mapping);
+    }
+    if (mapping->file) {
+        CloseHandle(mapping->file);
+    }
+    ZeroMemory(mapping, sizeof(*mapping));
+}
+
+uint64_t wcron_monotonic_ms(void) {
+    return GetTickCount64();
+}
+
+uint64_t wcron_monotonic_us(void) {
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / frequency.QuadPart * 1000000 +
+                      now.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+}
+
+uint64_t wcron_boot_ms(void) {
+    return GetTickCount64(); // keeps counting through sleep and hibernation
+}
+
+int64_t wcron_realtime_ms(void) {
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    // 100 ns units since 1601-01-01
+    uint64_t t = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    return (int64_t)(t / 10000) - 11644473600000LL;
+}
+
+void wcron_sleep_ms(unsigned ms) {
+    Sleep(ms);
+}
+
+#endif // _WIN32
@@ -0,0 +1,251 @@
+#include "wcron/preview.h"
+#include "wcron/dueindex.h"
+#include "wcron/jobtable.h"
+#include "wcron/parser.h"
+#include "wcron/platform.h"
+#include "wcron/service.h"
+#include "wcron/tz.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PREVIEW_MAX_COUNT 100
+#define PREVIEW_MAX_WINDOW (366 * 24 * 60) // minutes
+#define PREVIEW_BAR_WIDTH 50
+
+static void format_minute(time_t t, char *buffer, size_t size) {
+    struct tm tm;
+    tz_localtime(t, &tm);
+    strftime(buffer, size, "%Y-%m-%d %H:%M", &tm);
+}
+
+// The next `count` fire times after `from` of every job, or of job `only`
+static void print_next(const job_table *table, time_t from, int count, int only) {
+    for (int i = 0; i < table->count; i++) {
+        if (only >= 0 && i != only) {
+            continue;
+        }
+        const cron_job *job = &table->jobs[i];
+
+        printf("#%-5d", i);
+        time_t t = from;
+        for (int n = 0; n < count; n++) {
+            char when[32] = "-";
+            t = t == CRON_NEVER ? CRON_NEVER : next_fire_time(job, t);
+            if (t != CRON_NEVER) {
+                format_minute(t, when, sizeof(when));
+            }
+            printf(" %-16s", when);
+        }
+        printf("  %s\n", job->command);
+    }
+}
+
+/**
+ * Count the jobs firing in each minute of [start, start + minutes * 60). Jobs
+ * firing about hourly or more are evaluated together, one bitset pass per
+ * minute, as the scheduler does; the rest add their few fire times one by one.
+ * @return 0 on success, -1 if out of memory
+ */
+static int count_fires(const job_table *table, time_t start, int minutes, uint32_t *counts) {
+    due_index index;
+    if (due_index_init(&index, table->count) != 0) {
+        return -1;
+    }
+
+    time_t end = start + (time_t)minutes * 60;
+    for (int i = 0; i < table->count; i++) {
+        const cron_job *job = &table->jobs[i];
+        if (due_index_wants(job)) {
+            if (due_index_add(&index, job, i) < 0) {
+                due_index_free(&index);
+                return -1;
+            }
+            continue;
+        }
+        for (time_t t = next_fire_time(job, start - 1); t != CRON_NEVER && t < end; t = next_fire_time(job, t)) {
+            counts[(t - start) / 60]++;
+        }
+    }
+
+    // Minutes no member can be due in are skipped outright
+    for (time_t t = due_index_next(&index, start - 1); t != CRON_NEVER && t < end; t = due_index_next(&index, t)) {
+        struct tm tm;
+        tz_localtime(t, &tm);
+        counts[(t - start) / 60] += (uint32_t)due_index_eval(&index, &tm);
+    }
+
+    due_index_free(&index);
+    return 0;
+}
+
+typedef struct {
+    uint32_t count;
+    int minute;
+} busy_minute;
+
+// Busiest first, earliest first among equals
+static int compare_busy(const void *a, const void *b) {
+    const busy_minute *x = (const busy_minute *)a;
+    const busy_minute *y = (const busy_minute *)b;
+    if (x->count != y->count) {
+        return x->count < y->count ? 1 : -1;
+    }
+    return x->minute - y->minute;
+}
+
+static void print_bar(time_t t, uint32_t count, uint32_t peak) {
+    char when[32];
+    char bar[PREVIEW_BAR_WIDTH + 1];
+    int width = (int)((uint64_t)count * PREVIEW_BAR_WIDTH / peak);
+    width = width == 0 ? 1 : width;
+    memset(bar, '#', (size_t)width);
+    bar[width] = '\0';
+    format_minute(t, when, sizeof(when));
+    printf("%s %7lu  %s\n", when, (unsigned long)count, bar);
+}
+
+/**
+ * Print the fire counts of the window starting at `start`
+ * @param top Busiest minutes to list, or 0 for every minute with a fire in time order
+ */
+static int print_histogram(const job_table *table, time_t start, int minutes, int top) {
+    uint32_t *counts = calloc((size_t)minutes, sizeof(uint32_t));
+    busy_minute *busy = malloc(sizeof(busy_minute) * (size_t)minutes);
+    if (!counts || !busy || count_fires(table, start, minutes, counts) != 0) {
+        fprintf(stderr, "Error: Out of memory\n");
+        free(counts);
+        free(busy);
+        return 1;
+    }
+
+    uint64_t fires = 0;
+    uint32_t peak = 0;
+    int busy_count = 0;
+    for (int m = 0; m < minutes; m++) {
+        if (counts[m]) {
+            fires += counts[m];
+            peak = counts[m] > peak ? counts[m] : peak;
+            busy[busy_count].count = counts[m];
+            busy[busy_count].minute = m;
+            busy_count++;
+        }
+    }
+
+    char from[32], to[32];
+    format_minute(start, from, sizeof(from));
+    format_minute(start + (time_t)minutes * 60, to, sizeof(to));
+    printf("%llu fire times from %s to %s, in %d of %d minutes, at most %lu in one minute\n",
+           (unsigned long long)fires, from, to, busy_count, minutes, (unsigned long)peak);
+
+    if (top > 0) {
+        qsort(busy, (size_t)busy_count, sizeof(busy_minute), compare_busy);
+        busy_count = busy_count < top ? busy_count : top;
+    }
+    for (int i = 0; i < busy_count; i++) {
+        print_bar(start + (time_t)busy[i].minute * 60, busy[i].count, peak);
+    }
+
+    free(counts);
+    free(busy);
+    return 0;
+}
+
+// A window length such as 12h or 7d, in minutes; 0 if invalid
+static int parse_window(const char *value) {
+    long amount;
+    char unit, extra;
+    if (sscanf(value, "%ld%c%c", &amount, &unit, &extra) != 2 || amount <= 0) {
+        return 0;
+    }
+    long minutes = unit == 'h' ? amount * 60 : unit == 'd' ? amount * 24 * 60 : 0;
+    return minutes <= PREVIEW_MAX_WINDOW ? (int)minutes : 0;
+}
+
+static void print_usage(void) {
+    printf("Usage: wcrontab next [--count N] [--job J] [--from TIME] [--crontab FILE]\n"
+           "       wcrontab next --histogram [--window 24h|7d] [--top K | --all] [--from TIME] [--crontab FILE]\n");
+}
+
+int preview_command(int argc, char *argv[]) {
+    char crontab_path[WCRON_PATH_MAX_SIZE] = "";
+    time_t from = time(NULL);
+    int count = 3;
+    int only = -1;
+    int histogram = 0;
+    int window = 24 * 60;
+    int top = 10;
+
+    for (int i = 0; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--histogram") == 0) {
+            histogram = 1;
+        } else if (strcmp(argv[i], "--all") == 0) {
+            top = 0;
+        } else if (strcmp(argv[i], "--count") == 0 && value) {
+            count = atoi(value);
+            if (count < 1 || count > PREVIEW_MAX_COUNT) {
+                fprintf(stderr, "Error: --count must be 1 to %d\n", PREVIEW_MAX_COUNT);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--job") == 0 && value) {
+            only = atoi(value);
+            i++;
+        } else if (strcmp(argv[i], "--top") == 0 && value) {
+            top = atoi(value);
+            top = top < 1 ? 1 : top;
+            i++;
+        } else if (strcmp(argv[i], "--window") == 0 && value) {
+            window = parse_window(value);
+            if (!window) {
+                fprintf(stderr, "Error: Invalid --window value '%s' (hours or days, up to a year)\n", value);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--from") == 0 && value) {
+            if (!parse_local_time(value, &from)) {
+                fprintf(stderr, "Error: Invalid --from value '%s'\n", value);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--crontab") == 0 && value) {
+            snprintf(crontab_path, sizeof(crontab_path), "%s", value);
+            i++;
+        } else {
+            fprintf(stderr, "Error: Unknown next option '%s'\n", argv[i]);
+            print_usage();
+            return 1;
+        }
+    }
+
+    if (!crontab_path[0] && !get_crontab_path(crontab_path, sizeof(crontab_path))) {
+        fprintf(stderr, "Error: Failed to get crontab path\n");
+        return 1;
+    }
+    job_table *table = job_table_load(crontab_path, NULL);
+    if (!table) {
+        fprintf(stderr, "Error: Failed to load %s\n", crontab_path);
+        return 1;
+    }
+    if (only >= table->count) {
+        fprintf(stderr, "Error: No job #%d, the crontab has %d\n", only, table->count);
+        job_table_release(table);
+        return 1;
+    }
+    if (table->problems > 0) {
+        fprintf(stderr, "%d lines rejected as invalid or never firing, see the log\n", table->problems);
+    }
+
+    int r = 0;
+    if (histogram) {
+        // The window starts with the first whole minute after --from
+        r = print_histogram(table, from - from % 60 + 60, window, top);
+    } else {
+        print_next(table, from, count, only);
+    }
+    job_table_release(table);
+    return r;
+}
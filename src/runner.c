@@ -1,247 +1,1906 @@
 #include "wcron/runner.h"
+#include "wcron/dueindex.h"
+#include "wcron/journal.h"
+#include "wcron/metrics.h"
+#include "wcron/output.h"
 #include "wcron/parser.h"
+#include "wcron/platform.h"
+#include "wcron/runqueue.h"
 #include "wcron/service.h"
-#include <process.h>
+#include "wcron/status.h"
+#include "wcron/tz.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include <windows.h>
 
-BOOL execute_command_safely(const char *command);
-void __cdecl execute_job_worker(void *param);
+// Threads that start job processes; they never wait for a job to finish
+#define LAUNCHER_THREADS 4
+#define RUN_SLAB_SIZE 32
 
-static BOOL spawn_process(const char *cmdline, DWORD *exit_code);
-BOOL should_execute_job(cron_job *job, struct tm *current_time, time_t now);
+// Jobs named in the log for one gap of missed fire times; the rest are only counted
+#define CATCHUP_REPORT_MAX 10
+// Smallest step of the wall clock against the boot clock that is logged as a clock change
+#define CLOCK_JUMP_MIN_MS 1000
+
+int should_execute_job(cron_job *job, time_t now);
+static void resume_catch_up(int index);
+static void admit_waiting(void);
 
 typedef struct {
-    char command[512];
+    wcron_handle handle;
+    scheduler_watch_fn fn;
+    void *arg;
+    int used;
+} scheduler_watch_entry;
+
+typedef enum {
+    RUN_LAUNCH,  // queued for a launcher
+    RUN_STARTED, // handed to the scheduler thread
+    RUN_WATCHED, // the scheduler thread waits for its exit
+    RUN_DONE     // exited or failed to start
+} run_state;
+
+typedef enum {
+    RUN_SCHEDULED,
+    RUN_CATCHUP, // makes up for a missed fire time
+    RUN_MANUAL   // asked for through the control socket
+} run_kind;
+
+// One job execution, recycled through run_free_list
+typedef struct job_run {
+    struct job_run *next;
+    scheduler_watch_entry watch;        // reaper registration while the child runs
+    scheduler_watch_entry output_watch; // registration of the output pipe until it ends
+    run_state state;
+    int active; // allocated, not on the free list
     int job_index;
     time_t scheduled_time;
-} job_execution_data;
+    run_kind kind;
+    time_t release;        // held back by jitter until then
+    int64_t due_wall_ms;   // when the run came due
+    uint64_t wait_from_ms; // monotonic, when it joined the admission queue; 0 if it never waited
+    uint64_t wait_ms;
+    uint64_t start_ms;
+    int64_t start_wall_ms;
+    int64_t running_since_ms; // start_wall_ms once the process exists, published for scheduler_list_runs()
+    wcron_process process;
+    job_output output;
+    int started;
+    int exit_code;
+    int reaped;          // exit_code came from the SIGCHLD reaper
+    job_table *table;    // referenced until the run is finished, reloads may replace it meanwhile
+    const char *command; // in table's string arena
+} job_run;
+
+typedef struct run_slab {
+    struct run_slab *next;
+    job_run runs[RUN_SLAB_SIZE];
+} run_slab;
+
+wcron_mutex jobs_lock;
+
+// Jobs ordered by next fire time, guarded by jobs_lock
+static runqueue run_queue;
+
+// Jobs firing about hourly or more are evaluated each minute from the bitset
+// index instead; the run queue keeps the rest. Guarded by jobs_lock.
+static due_index due_jobs;
+static int *job_slots;                 // slot of each live job in due_jobs, -1 if it is in the run queue
+static time_t index_next = CRON_NEVER; // next minute due_jobs may have work
+
+// Missed fire times still owed to jobs under a catch-up policy, made up one run
+// after the other. Guarded by jobs_lock.
+typedef struct {
+    int job;      // index in the live table
+    time_t next;  // next missed fire time to make up
+    time_t until; // end of the gap; fire times from here on are regular ones
+    int left;     // runs the policy still allows
+} catchup_entry;
+
+static catchup_entry *catchups;
+static int catchup_count;
+static int catchup_capacity;
+
+static wcron_loop *scheduler_loop;
+
+// Run records are only allocated and released on the scheduler thread
+static run_slab *run_slabs;
+static job_run *run_free_list;
+static int runs_active;
+
+// Launch queue, consumed by the launcher pool
+static wcron_mutex launch_lock;
+static wcron_sem launch_sem;
+static job_run *launch_head, *launch_tail;
+static wcron_thread launchers[LAUNCHER_THREADS];
+static int launcher_count;
+static int launchers_stopping;
+
+// Runs handed back by launchers, picked up by the scheduler thread
+static wcron_mutex handoff_lock;
+static wcron_event handoff_event;
+static job_run *handoff_head;
+
+// Exit notices for children without a process handle, opened the first time one turns up (see watch_children()).
+// Scheduler thread only, like the exits reaped before their run was handed over.
+typedef struct {
+    long pid;
+    int exit_code;
+} early_exit;
+
+static wcron_handle child_watch = WCRON_NO_HANDLE;
+static early_exit *early_exits;
+static int early_count;
+static int early_capacity;
+
+// Launch pacing, read from the environment at startup. WCRON_JITTER holds each
+// job back by a hash of its line spread over that many seconds; WCRON_MAX_RUNNING
+// caps the jobs running at once, the rest wait their turn in FIFO order.
+// Guarded by jobs_lock.
+static unsigned jitter_window;
+static int max_running; // 0: no cap
+static int runs_admitted;
+static job_run *admit_head, *admit_tail;
+
+// Runs held back by jitter, a min-heap on release time. Guarded by jobs_lock.
+static job_run **delayed;
+static int delayed_count;
+static int delayed_capacity;
 
-static BOOL spawn_process(const char *cmdline, DWORD *exit_code) {
-    STARTUPINFOA si;
-    PROCESS_INFORMATION pi;
+// Wall clock of the scheduling logic; a simulation swaps in a virtual one
+static scheduler_clock_fn clock_ms = wcron_realtime_ms;
 
-    ZeroMemory(&si, sizeof(si));
-    si.cb = sizeof(si);
-    ZeroMemory(&pi, sizeof(pi));
+// Set by scheduler_sim_init(): admitted runs go to it instead of the launcher pool
+static scheduler_spawn_fn sim_spawn;
+static void *sim_arg;
 
-    BOOL ok = CreateProcessA(NULL, (LPSTR)cmdline, NULL, NULL, FALSE, CREATE_NO_WINDOW, NULL, NULL, &si, &pi);
+static time_t clock_now(void) {
+    return (time_t)(clock_ms() / 1000);
+}
 
-    if (!ok) {
-        return FALSE;
+static job_run *run_alloc(void) {
+    if (!run_free_list) {
+        run_slab *slab = calloc(1, sizeof(run_slab));
+        if (!slab) {
+            return NULL;
+        }
+        slab->next = run_slabs;
+        run_slabs = slab;
+        for (int i = 0; i < RUN_SLAB_SIZE; i++) {
+            slab->runs[i].next = run_free_list;
+            run_free_list = &slab->runs[i];
+        }
     }
 
-    WaitForSingleObject(pi.hProcess, INFINITE);
+    job_run *run = run_free_list;
+    run_free_list = run->next;
+    run->next = NULL;
+    run->active = 1;
+    runs_active++;
+    return run;
+}
+
+static void run_release(job_run *run) {
+    run->active = 0;
+    run->next = run_free_list;
+    run_free_list = run;
+    runs_active--;
+}
 
-    if (exit_code) {
-        GetExitCodeProcess(pi.hProcess, exit_code);
+static void run_pool_free(void) {
+    while (run_slabs) {
+        run_slab *slab = run_slabs;
+        run_slabs = slab->next;
+        free(slab);
     }
+    run_free_list = NULL;
+}
+
+static void describe_run(const job_run *run, scheduler_run_info *info);
 
-    CloseHandle(pi.hProcess);
-    CloseHandle(pi.hThread);
+// Simulated start: no launcher and no process, the run lasts until scheduler_sim_finish()
+static void sim_start(job_run *run) {
+    run->state = RUN_STARTED;
+    run->started = 1;
+    run->start_ms = wcron_monotonic_ms();
+    run->start_wall_ms = clock_ms();
+    run->running_since_ms = run->start_wall_ms;
+    run->process.pid = 0;
 
-    return TRUE;
+    scheduler_run_info info;
+    describe_run(run, &info);
+    sim_spawn(run, &info, sim_arg);
 }
 
-CRITICAL_SECTION jobs_lock;
+static void launch_push(job_run *run) {
+    if (sim_spawn) {
+        sim_start(run);
+        return;
+    }
 
-BOOL execute_command_safely(const char *command) {
-    char cmd_line[2048];
-    DWORD exit_code = 0;
-    char msg[512];
-
-    // !TODO: Prevent command injection
-    int r = snprintf(cmd_line, sizeof(cmd_line), "%s", command);
-    if (r > 0 && r < (int)sizeof(cmd_line)) {
-        if (spawn_process(cmd_line, &exit_code)) {
-            if (exit_code == 0) {
-                snprintf(msg, sizeof(msg), "Job successfully runs: %s", command);
-                log_msg(msg);
-                return TRUE;
-            } else {
-                snprintf(msg, sizeof(msg), "Direct execution failed with exit code %lu", exit_code);
-                log_msg(msg);
-            }
-        }
+    wcron_mutex_lock(&launch_lock);
+    if (launch_tail) {
+        launch_tail->next = run;
+    } else {
+        launch_head = run;
+    }
+    launch_tail = run;
+    wcron_mutex_unlock(&launch_lock);
+
+    wcron_sem_post(&launch_sem);
+}
+
+static void handoff_push(job_run *run) {
+    wcron_mutex_lock(&handoff_lock);
+    run->next = handoff_head;
+    handoff_head = run;
+    wcron_mutex_unlock(&handoff_lock);
+
+    wcron_event_set(handoff_event);
+}
+
+static int spawn_job(const char *command, wcron_process *process, wcron_handle output) {
+    if (wcron_spawn(command, process, output) == 0) {
+        return 0;
     }
 
+#ifdef _WIN32
     // Try with cmd.exe is insecure: only use if absolutely necessary, dev purposes
-    r = snprintf(cmd_line, sizeof(cmd_line), "cmd.exe /C \"%s\"", command);
+    char cmd_line[2048];
+    int r = snprintf(cmd_line, sizeof(cmd_line), "cmd.exe /C \"%s\"", command);
     if (r <= 0 || r >= (int)sizeof(cmd_line)) {
         log_msg("Command too long for cmd.exe");
-        return FALSE;
+        return -1;
     }
 
-    if (!spawn_process(cmd_line, &exit_code)) {
-        snprintf(msg, sizeof(msg), "cmd.exe execution failed (err=%lu)", GetLastError());
-        log_msg(msg);
-        return FALSE;
+    if (wcron_spawn(cmd_line, process, output) == 0) {
+        log_msg("Direct execution failed, running via cmd.exe");
+        return 0;
     }
 
-    snprintf(msg, sizeof(msg), "Executed via cmd.exe with exit code %lu", exit_code);
+    char msg[128];
+    snprintf(msg, sizeof(msg), "cmd.exe execution failed (err=%lu)", GetLastError());
     log_msg(msg);
-    return exit_code == 0;
+#endif
+    return -1;
 }
 
-void __cdecl execute_job_worker(void *param) {
-    job_execution_data *data = (job_execution_data *)param;
-
+static void start_run(job_run *run) {
     char log_buffer[768];
-    snprintf(log_buffer, sizeof(log_buffer), "Executing job #%d: %s", data->job_index, data->command);
+    snprintf(log_buffer, sizeof(log_buffer), "Executing job #%d: %s", run->job_index, run->command);
     log_msg(log_buffer);
 
-    DWORD start_time = GetTickCount();
-    BOOL success = execute_command_safely(data->command);
-    DWORD elapsed = GetTickCount() - start_time;
+    output_begin(&run->output, run->table->hashes[run->job_index], run->scheduled_time);
+    metrics_gauge_add(METRIC_QUEUED, -1);
+    uint64_t spawn_us = wcron_monotonic_us();
+    run->start_ms = wcron_monotonic_ms();
+    run->start_wall_ms = clock_ms();
+    run->started = spawn_job(run->command, &run->process, run->output.child) == 0;
+    output_spawned(&run->output);
+
+    if (run->started) {
+        int64_t drift_ms = run->start_wall_ms - (int64_t)run->scheduled_time * 1000;
+        metrics_observe(METRIC_SPAWN, wcron_monotonic_us() - spawn_us);
+        metrics_observe(METRIC_DRIFT, drift_ms > 0 ? (uint64_t)drift_ms * 1000 : 0);
+        metrics_gauge_add(METRIC_RUNNING, 1);
+        __atomic_store_n(&run->running_since_ms, run->start_wall_ms, __ATOMIC_RELEASE);
+    }
+
+    // The scheduler thread watches the child from here on
+    run->state = run->started ? RUN_STARTED : RUN_DONE;
+    handoff_push(run);
+}
+
+static void launcher_thread(void *param) {
+    (void)param;
+
+    while (1) {
+        wcron_sem_wait(&launch_sem);
+
+        wcron_mutex_lock(&launch_lock);
+        job_run *run = launch_head;
+        if (run) {
+            launch_head = run->next;
+            if (!launch_head) {
+                launch_tail = NULL;
+            }
+        }
+        int stopping = launchers_stopping;
+        wcron_mutex_unlock(&launch_lock);
+
+        if (!run) {
+            if (stopping) {
+                break;
+            }
+            continue;
+        }
+
+        start_run(run);
+    }
+}
+
+// Follow reloads that happened since the run was created to find its job in the live table; -1 if it is gone
+static int live_index(const job_run *run) {
+    job_table *table = run->table;
+    int index = run->job_index;
+    while (table != crontab && index >= 0 && table->successor) {
+        index = table->forward ? table->forward[index] : -1;
+        table = table->successor;
+    }
+    return table == crontab && index < crontab->count ? index : -1;
+}
+
+// Log the last line a failed job printed, from its in-memory output
+static void log_last_output(const job_run *run) {
+    char tail[512];
+    size_t n = output_tail(run->table->hashes[run->job_index], tail, sizeof(tail) - 1);
+    while (n > 0 && (tail[n - 1] == '\n' || tail[n - 1] == '\r')) {
+        n--;
+    }
+    if (n == 0) {
+        return;
+    }
+    tail[n] = '\0';
+    const char *line = tail;
+    for (size_t i = 0; i < n; i++) {
+        if (tail[i] == '\n') {
+            line = tail + i + 1;
+        }
+    }
+
+    char msg[640];
+    snprintf(msg, sizeof(msg), "Job #%d last output: %s", run->job_index, line);
+    log_msg(msg);
+}
+
+// Free the run's admission slot and mark its job as not running. Runs on the scheduler thread.
+static void settle_run(job_run *run, int exit_code, uint32_t duration_ms) {
+    wcron_mutex_lock(&jobs_lock);
+    runs_admitted--;
+    admit_waiting();
+    int index = live_index(run);
+    if (index >= 0) {
+        // A manual run is not a fire time, and must not hold back the next scheduled one
+        if (run->kind != RUN_MANUAL) {
+            crontab->jobs[index].last_run = run->scheduled_time;
+        }
+        crontab->jobs[index].is_running = 0;
+        status_run_finished(index, crontab->jobs[index].last_run, exit_code, run->start_wall_ms, duration_ms);
+        resume_catch_up(index);
+    }
+    wcron_mutex_unlock(&jobs_lock);
+
+    job_table_release(run->table);
+    run->table = NULL;
+    run_release(run);
+}
+
+// Log the outcome and release the job. Runs on the scheduler thread.
+static void finish_run(job_run *run) {
+    char log_buffer[768];
+    unsigned long elapsed = (unsigned long)(wcron_monotonic_ms() - run->start_ms);
+    int success = run->started && run->exit_code == 0;
+
+    output_end(&run->output);
+    if (run->started) {
+        metrics_gauge_add(METRIC_RUNNING, -1);
+        metrics_observe_job(run->table->hashes[run->job_index], (uint64_t)elapsed * 1000, !success);
+    }
+    metrics_count(!run->started ? METRIC_RUNS_NOT_STARTED : success ? METRIC_RUNS_OK : METRIC_RUNS_FAILED);
+    if (run->kind == RUN_CATCHUP) {
+        metrics_count(METRIC_CATCHUP_RUNS);
+    }
+    if (run->output.truncated) {
+        metrics_count(METRIC_OUTPUT_TRUNCATED);
+        snprintf(log_buffer, sizeof(log_buffer), "Job #%d output truncated, %llu bytes dropped", run->job_index,
+                 (unsigned long long)run->output.dropped);
+        log_msg(log_buffer);
+    }
+
+    if (!run->started) {
+        snprintf(log_buffer, sizeof(log_buffer), "Failed to start job #%d: %s", run->job_index, run->command);
+        log_msg(log_buffer);
+    } else if (success) {
+        snprintf(log_buffer, sizeof(log_buffer), "Job successfully runs: %s", run->command);
+        log_msg(log_buffer);
+    } else {
+        snprintf(log_buffer, sizeof(log_buffer), "Direct execution failed with exit code %d", run->exit_code);
+        log_msg(log_buffer);
+        log_last_output(run);
+    }
 
     if (success) {
-        snprintf(log_buffer, sizeof(log_buffer), "Job #%d completed in %lu ms", data->job_index, elapsed);
+        snprintf(log_buffer, sizeof(log_buffer), "Job #%d completed in %lu ms", run->job_index, elapsed);
     } else {
-        snprintf(log_buffer, sizeof(log_buffer), "Job #%d failed after %lu ms", data->job_index, elapsed);
+        snprintf(log_buffer, sizeof(log_buffer), "Job #%d failed after %lu ms", run->job_index, elapsed);
     }
     log_msg(log_buffer);
 
-    // Mark job as not running
-    EnterCriticalSection(&jobs_lock);
-    if (data->job_index < job_count) {
-        jobs[data->job_index].last_run = data->scheduled_time;
-        jobs[data->job_index].is_running = 0;
+    journal_record record;
+    memset(&record, 0, sizeof(record));
+    record.job_hash = run->table->hashes[run->job_index];
+    record.job = run->job_index;
+    record.exit_code = run->started ? run->exit_code : -1;
+    record.scheduled = (int64_t)run->scheduled_time;
+    record.start_ms = run->start_wall_ms;
+    record.end_ms = run->start_wall_ms + (int64_t)elapsed;
+    record.duration_ms = (uint32_t)elapsed;
+    record.flags = (run->started ? JOURNAL_RUN_STARTED : 0) | (success ? 0 : JOURNAL_RUN_FAILED) |
+                   (run->kind == RUN_CATCHUP ? JOURNAL_RUN_CATCHUP : 0) |
+                   (run->kind == RUN_MANUAL ? JOURNAL_RUN_MANUAL : 0);
+    int64_t queued = run->start_wall_ms - run->due_wall_ms;
+    record.queue_ms = queued <= 0 ? 0 : queued >= UINT32_MAX ? UINT32_MAX : (uint32_t)queued;
+    record.wait_ms = run->wait_ms >= UINT32_MAX ? UINT32_MAX : (uint32_t)run->wait_ms;
+    if (journal_append(&record) != 0) {
+        log_msg("Failed to append run to journal");
+    }
+
+    settle_run(run, record.exit_code, record.duration_ms);
+}
+
+// The run's process exited and was reaped
+static void child_exited(job_run *run) {
+    if (run->output_watch.used) {
+        wcron_loop_remove(scheduler_loop, run->output_watch.handle);
+        run->output_watch.used = 0;
+    }
+    finish_run(run);
+}
+
+static void on_child_exit(wcron_handle handle, void *arg) {
+    job_run *run = (job_run *)arg;
+
+    // Stop watching before the wait closes the handle
+    wcron_loop_remove(scheduler_loop, handle);
+    run->watch.used = 0;
+    if (run->reaped) {
+        wcron_process_release(&run->process);
+    } else if (wcron_process_wait(&run->process, &run->exit_code) != 0) {
+        run->exit_code = -1;
+    }
+    child_exited(run);
+}
+
+// The watched run whose process is pid, NULL if none
+static job_run *find_watched_run(long pid) {
+    for (run_slab *slab = run_slabs; slab; slab = slab->next) {
+        for (int i = 0; i < RUN_SLAB_SIZE; i++) {
+            job_run *run = &slab->runs[i];
+            if (run->active && run->state == RUN_WATCHED && !run->reaped && (long)run->process.pid == pid) {
+                return run;
+            }
+        }
+    }
+    return NULL;
+}
+
+// SIGCHLD: reap every child that exited. Runs watched by their handle finish when it turns ready, the rest here.
+static void on_child_signal(wcron_handle handle, void *arg) {
+    (void)arg;
+    wcron_child_watch_ack(handle);
+
+    long pid;
+    int exit_code;
+    while (wcron_child_reap(&pid, &exit_code)) {
+        job_run *run = find_watched_run(pid);
+        if (!run) {
+            // Its run is still on the way from the launcher; on_handoff() takes the exit from here
+            if (early_count == early_capacity) {
+                int capacity = early_capacity ? early_capacity * 2 : 16;
+                early_exit *grown = realloc(early_exits, sizeof(early_exit) * (size_t)capacity);
+                if (!grown) {
+                    log_msg("Out of memory, the exit of a job process is lost");
+                    continue;
+                }
+                early_exits = grown;
+                early_capacity = capacity;
+            }
+            early_exits[early_count].pid = pid;
+            early_exits[early_count].exit_code = exit_code;
+            early_count++;
+            continue;
+        }
+
+        run->exit_code = exit_code;
+        run->reaped = 1;
+        if (!run->watch.used) {
+            wcron_process_release(&run->process);
+            child_exited(run);
+        }
+    }
+}
+
+// Take the exit the reaper collected for the run before it was handed over; 0 if there is none
+static int take_early_exit(job_run *run) {
+    for (int i = 0; i < early_count; i++) {
+        if (early_exits[i].pid == (long)run->process.pid) {
+            run->exit_code = early_exits[i].exit_code;
+            run->reaped = 1;
+            early_exits[i] = early_exits[--early_count];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Reap children on SIGCHLD from now on. Turned on the first time a process
+ * has no handle to watch (no pidfd before Linux 5.3), and only then, as
+ * waitpid(-1) would also take the exits meant for pidfd watches.
+ * @return 0 when the reaper runs, -1 where there is none (Windows)
+ */
+static int watch_children(void) {
+    if (child_watch != WCRON_NO_HANDLE) {
+        return 0;
+    }
+    wcron_handle watch;
+    if (wcron_child_watch_create(&watch) != 0) {
+        return -1;
+    }
+    if (scheduler_watch(watch, on_child_signal, NULL) != 0) {
+        wcron_handle_close(watch);
+        return -1;
+    }
+    child_watch = watch;
+    log_msg("Job processes cannot be watched by handle here, reaping them on SIGCHLD");
+    return 0;
+}
+
+// The child wrote to its output pipe, or closed it
+static void on_output(wcron_handle handle, void *arg) {
+    job_run *run = (job_run *)arg;
+
+    if (output_drain(&run->output)) {
+        wcron_loop_remove(scheduler_loop, handle);
+        run->output_watch.used = 0;
     }
-    LeaveCriticalSection(&jobs_lock);
+}
 
-    free(data);
+// Reaper side of the handoff: watch started children, finish completed runs
+static void on_handoff(wcron_handle handle, void *arg) {
+    (void)arg;
+    wcron_event_reset(handle);
+
+    wcron_mutex_lock(&handoff_lock);
+    job_run *list = handoff_head;
+    handoff_head = NULL;
+    wcron_mutex_unlock(&handoff_lock);
+
+    while (list) {
+        job_run *run = list;
+        list = run->next;
+        run->next = NULL;
+
+        if (run->state == RUN_DONE) {
+            finish_run(run);
+            continue;
+        }
+
+        run->state = RUN_WATCHED;
+        if (take_early_exit(run)) {
+            wcron_process_release(&run->process);
+            finish_run(run);
+            continue;
+        }
+
+        // By its handle where there is one, else through the SIGCHLD reaper
+        run->watch.fn = on_child_exit;
+        run->watch.arg = run;
+        if (wcron_process_handle(&run->process, &run->watch.handle) == 0) {
+            run->watch.used = wcron_loop_add(scheduler_loop, run->watch.handle, &run->watch) == 0;
+        }
+        if (!run->watch.used && watch_children() != 0) {
+            char msg[96];
+            snprintf(msg, sizeof(msg), "Cannot watch the process of job #%d, its outcome is unknown", run->job_index);
+            log_msg(msg);
+            wcron_process_release(&run->process);
+            run->exit_code = -1;
+            finish_run(run);
+            continue;
+        }
+
+        if (run->output.pipe != WCRON_NO_HANDLE) {
+            run->output_watch.handle = run->output.pipe;
+            run->output_watch.fn = on_output;
+            run->output_watch.arg = run;
+            if (wcron_loop_add(scheduler_loop, run->output_watch.handle, &run->output_watch) != 0) {
+                // Unread, the pipe would fill up and stall the job: keep what it holds, later writes fail
+                char msg[96];
+                snprintf(msg, sizeof(msg), "Cannot watch the output of job #%d, closing it", run->job_index);
+                log_msg(msg);
+                output_drain(&run->output);
+                wcron_handle_close(run->output.pipe);
+                run->output.pipe = WCRON_NO_HANDLE;
+            } else {
+                run->output_watch.used = 1;
+            }
+        }
+    }
 }
 
-BOOL should_execute_job(cron_job *job, struct tm *current_time, time_t now) {
+int should_execute_job(cron_job *job, time_t now) {
     if (job->is_running) {
-        return FALSE;
+        return 0;
     }
 
     if (job->last_run > 0) {
         time_t time_diff = now - job->last_run;
         if (time_diff < 60) {
-            return FALSE;
+            return 0;
         }
     }
 
-    return time_matches(job, current_time);
+    return 1;
 }
 
-void __cdecl scheduler_thread(void *param) {
-    (void)param;
+// Hand the run to the launcher pool now, or queue it for the next free slot. Caller must hold jobs_lock.
+static void admit_run(job_run *run) {
+    // Nothing overtakes the queue, and nothing starts while paused
+    if (paused || admit_head || (max_running > 0 && runs_admitted >= max_running)) {
+        run->wait_from_ms = wcron_monotonic_ms();
+        run->next = NULL;
+        if (admit_tail) {
+            admit_tail->next = run;
+        } else {
+            admit_head = run;
+        }
+        admit_tail = run;
+        return;
+    }
+
+    runs_admitted++;
+    launch_push(run);
+}
 
-    InitializeCriticalSection(&jobs_lock);
+// Admit queued runs while slots are free. Caller must hold jobs_lock.
+static void admit_waiting(void) {
+    while (admit_head && !paused && (max_running == 0 || runs_admitted < max_running)) {
+        job_run *run = admit_head;
+        admit_head = run->next;
+        if (!admit_head) {
+            admit_tail = NULL;
+        }
+        run->next = NULL;
+        run->wait_ms = wcron_monotonic_ms() - run->wait_from_ms;
 
-    log_msg("Scheduler thread started");
+        runs_admitted++;
+        launch_push(run);
+    }
+}
+
+static int delay_push(job_run *run) {
+    if (delayed_count == delayed_capacity) {
+        int capacity = delayed_capacity ? delayed_capacity * 2 : 64;
+        job_run **grown = realloc(delayed, sizeof(job_run *) * (size_t)capacity);
+        if (!grown) {
+            return -1;
+        }
+        delayed = grown;
+        delayed_capacity = capacity;
+    }
 
-    HANDLE timer = CreateWaitableTimer(NULL, FALSE, NULL);
-    if (!timer) {
-        log_msg("Failed to create waitable timer");
+    int i = delayed_count++;
+    while (i > 0 && delayed[(i - 1) / 2]->release > run->release) {
+        delayed[i] = delayed[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    delayed[i] = run;
+    return 0;
+}
+
+static job_run *delay_pop(void) {
+    job_run *top = delayed[0];
+    job_run *last = delayed[--delayed_count];
+    int i = 0;
+
+    while (2 * i + 1 < delayed_count) {
+        int child = 2 * i + 1;
+        if (child + 1 < delayed_count && delayed[child + 1]->release < delayed[child]->release) {
+            child++;
+        }
+        if (last->release <= delayed[child]->release) {
+            break;
+        }
+        delayed[i] = delayed[child];
+        i = child;
+    }
+    if (delayed_count > 0) {
+        delayed[i] = last;
+    }
+    return top;
+}
+
+// Admit the runs whose jitter has passed. Caller must hold jobs_lock.
+static void release_delayed(time_t now) {
+    while (delayed_count > 0 && delayed[0]->release <= now) {
+        admit_run(delay_pop());
+    }
+}
+
+// Create a run of the job; jitter and the admission queue decide when it starts. Caller must hold jobs_lock.
+static void launch_job(cron_job *job, int index, time_t scheduled_time, run_kind kind) {
+    job_run *run = run_alloc();
+    if (!run) {
+        log_msg("Failed to allocate memory for job execution");
         return;
     }
 
-    LARGE_INTEGER due_time;
-    due_time.QuadPart = 0;
+    job_table_acquire(crontab);
+    run->table = crontab;
+    run->command = job->command;
+    run->state = RUN_LAUNCH;
+    run->job_index = index;
+    run->scheduled_time = scheduled_time;
+    run->kind = kind;
+    run->due_wall_ms = clock_ms();
+    run->wait_from_ms = 0;
+    run->wait_ms = 0;
+    run->started = 0;
+    run->running_since_ms = 0;
+    run->exit_code = 0;
+    run->reaped = 0;
+    run->watch.used = 0;
+    run->output_watch.used = 0;
+
+    job->is_running = 1;
+    status_set_running(index, 1);
+    metrics_gauge_add(METRIC_QUEUED, 1);
+
+    // The line hash places the job in the window the same way on every run and every host
+    run->release = scheduled_time;
+    if (jitter_window > 0 && kind != RUN_MANUAL) {
+        run->release += (time_t)(crontab->hashes[index] % jitter_window);
+    }
+    if (run->release <= clock_now() || delay_push(run) != 0) {
+        admit_run(run);
+    }
+}
 
-    if (!SetWaitableTimer(timer, &due_time, 1000, NULL, NULL, FALSE)) {
-        log_msg("Failed to set waitable timer");
-        CloseHandle(timer);
+// Launch the indexed jobs due in the minute starting at `minute`. Caller must hold jobs_lock.
+static void run_indexed_jobs(time_t minute, time_t now) {
+    struct tm tm;
+    tz_localtime(minute, &tm);
+    if (due_index_eval(&due_jobs, &tm) == 0) {
         return;
     }
 
-    int last_minute = -1;
+    size_t words = ((size_t)due_jobs.used + 63) / 64;
+    for (size_t w = 0; w < words; w++) {
+        for (uint64_t bits = due_jobs.due[w]; bits; bits &= bits - 1) {
+            int index = due_jobs.slot_job[w * 64 + (size_t)__builtin_ctzll(bits)];
+            cron_job *job = &crontab->jobs[index];
+            if (should_execute_job(job, now)) {
+                launch_job(job, index, minute, RUN_SCHEDULED);
+            }
+        }
+    }
+}
 
-    while (1) {
-        HANDLE handles[2] = {stop_event, timer};
-        DWORD wait_result = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+// Fire times missed in one pass of run_due_jobs(), summarized in the log afterwards
+typedef struct {
+    time_t since;    // earliest missed fire time, CRON_NEVER if none
+    time_t until;    // the minute the scheduler is back at
+    int catching_up; // jobs making up for what they missed
+} missed_report;
 
-        if (wait_result == WAIT_OBJECT_0) {
-            log_msg("Scheduler received stop signal");
-            break;
+static void format_minute(time_t t, char *buffer, size_t size) {
+    struct tm tm;
+    tz_localtime(t, &tm);
+    strftime(buffer, size, "%Y-%m-%d %H:%M", &tm);
+}
+
+// Start the next owed run of catchups[i] unless the job is busy; finish_run() comes back for the rest
+static void launch_catch_up(int i) {
+    catchup_entry *entry = &catchups[i];
+    cron_job *job = &crontab->jobs[entry->job];
+    if (job->is_running) {
+        return;
+    }
+
+    launch_job(job, entry->job, entry->next, RUN_CATCHUP);
+    entry->left--;
+    entry->next = entry->left > 0 ? next_fire_time(job, entry->next) : CRON_NEVER;
+    if (entry->next == CRON_NEVER || entry->next >= entry->until) {
+        catchups[i] = catchups[--catchup_count];
+    }
+}
+
+// A run of the job ended: go on with its owed runs. Caller must hold jobs_lock.
+static void resume_catch_up(int index) {
+    for (int i = 0; i < catchup_count; i++) {
+        if (catchups[i].job == index) {
+            launch_catch_up(i);
+            return;
+        }
+    }
+}
+
+/**
+ * Record that a job missed its fire times in [from, until) and queue what its
+ * policy makes up for; the runs start at the end of the pass, after the current
+ * minute's. Caller must hold jobs_lock.
+ * @param from The first missed fire time
+ */
+static void catch_up(cron_job *job, int index, time_t from, time_t until, missed_report *report) {
+    if (report->since == CRON_NEVER || from < report->since) {
+        report->since = from;
+    }
+
+    int policy = job->flags & CRON_CATCHUP_MASK;
+    if (!policy) {
+        return;
+    }
+    for (int i = 0; i < catchup_count; i++) {
+        if (catchups[i].job == index) {
+            return; // still making up an earlier gap, which is bound enough
+        }
+    }
+
+    // Count the runs to make up by jumping from fire time to fire time, not minute by minute
+    int runs = 1;
+    if (policy == CRON_CATCHUP_ALL) {
+        runs = 0;
+        for (time_t t = from; t != CRON_NEVER && t < until && runs < job->catchup_max; t = next_fire_time(job, t)) {
+            runs++;
+        }
+    }
+    if (runs == 0) {
+        return;
+    }
+
+    if (catchup_count == catchup_capacity) {
+        int capacity = catchup_capacity ? catchup_capacity * 2 : 16;
+        catchup_entry *grown = realloc(catchups, sizeof(catchup_entry) * (size_t)capacity);
+        if (!grown) {
+            log_msg("Failed to allocate memory for catch-up runs");
+            return;
         }
+        catchups = grown;
+        catchup_capacity = capacity;
+    }
+    catchup_entry *entry = &catchups[catchup_count++];
+    entry->job = index;
+    entry->next = from;
+    entry->until = until;
+    entry->left = runs;
+
+    if (report->catching_up < CATCHUP_REPORT_MAX) {
+        char since[32];
+        char msg[128];
+        format_minute(from, since, sizeof(since));
+        snprintf(msg, sizeof(msg), "Job #%d missed fire times since %s, making up %d run%s", index, since, runs,
+                 runs == 1 ? "" : "s");
+        log_msg(msg);
+    }
+    report->catching_up++;
+}
 
-        if (paused) {
+/**
+ * Jobs of the index that had fire times in [from, until), minutes it was not
+ * evaluated in: from is only the union schedule's guess, so the report starts
+ * at the first real one. Caller must hold jobs_lock.
+ */
+static void catch_up_indexed(time_t from, time_t until, missed_report *report) {
+    for (int slot = 0; slot < due_jobs.used; slot++) {
+        int index = due_jobs.slot_job[slot];
+        if (index < 0) {
             continue;
         }
+        cron_job *job = &crontab->jobs[index];
+        time_t first = next_fire_time(job, from - 1);
+        if (first == CRON_NEVER || first >= until) {
+            continue;
+        }
+        if (job->flags & CRON_CATCHUP_MASK) {
+            catch_up(job, index, first, until, report);
+        } else if (report->since == CRON_NEVER || first < report->since) {
+            report->since = first;
+        }
+    }
+}
+
+static void report_missed(const missed_report *report) {
+    char since[32];
+    char until[32];
+    char msg[256];
+    format_minute(report->since, since, sizeof(since));
+    format_minute(report->until, until, sizeof(until));
+
+    if (report->catching_up > CATCHUP_REPORT_MAX) {
+        snprintf(msg, sizeof(msg), "%d more jobs making up missed runs not listed",
+                 report->catching_up - CATCHUP_REPORT_MAX);
+        log_msg(msg);
+    }
+    snprintf(msg, sizeof(msg),
+             "Scheduler missed fire times from %s to %s (paused, suspended or clock change): "
+             "%d jobs catching up, other missed fire times skipped",
+             since, until, report->catching_up);
+    log_msg(msg);
+}
 
-        time_t now = time(NULL);
-        struct tm *current_time = localtime(&now);
+/**
+ * Pop every job whose fire time has come and re-arm it with its next fire time.
+ * Cost is proportional to the number of due jobs, not to the table size.
+ * Caller must hold jobs_lock.
+ */
+static void run_due_jobs(time_t now) {
+    time_t minute_start = now - now % 60;
+    runqueue_entry entry;
+    missed_report report = {CRON_NEVER, minute_start, 0};
 
-        if (!current_time) {
+    while (runqueue_peek(&run_queue, &entry) && entry.when <= now) {
+        runqueue_pop(&run_queue, &entry);
+        if (entry.job >= crontab->count) {
             continue;
         }
 
-        int current_minute = current_time->tm_min;
+        cron_job *job = &crontab->jobs[entry.job];
+        time_t rearm_from = entry.when;
+
+        if (entry.when >= minute_start) {
+            if (should_execute_job(job, now)) {
+                launch_job(job, entry.job, entry.when, RUN_SCHEDULED);
+            }
+        } else {
+            // Fire time passed while paused, suspended or behind a clock jump: leave it
+            // to the job's catch-up policy, and let the job still fire in the current minute
+            catch_up(job, entry.job, entry.when, minute_start, &report);
+            rearm_from = minute_start - 1;
+        }
+
+        time_t next = next_fire_time(job, rearm_from);
+        if (next != CRON_NEVER) {
+            runqueue_update(&run_queue, entry.job, next);
+        }
+        status_set_next(entry.job, next);
+    }
+
+    // A late or resumed tick evaluates the current minute; the ones skipped go to catch-up, like the queue above
+    if (index_next != CRON_NEVER && index_next <= now) {
+        if (index_next < minute_start) {
+            catch_up_indexed(index_next, minute_start, &report);
+        }
+        run_indexed_jobs(minute_start, now);
+        index_next = due_index_next(&due_jobs, minute_start);
+    }
+
+    // Only when some job really had a fire time in the gap
+    if (report.since != CRON_NEVER) {
+        report_missed(&report);
+    }
+    // Backwards, as a finished entry is replaced by the last one
+    for (int i = catchup_count - 1; i >= 0; i--) {
+        launch_catch_up(i);
+    }
+}
+
+// Re-arm every job of the current table. Caller must hold jobs_lock.
+static void reschedule_jobs(time_t now) {
+    int count = crontab ? crontab->count : 0;
+    for (int i = 0; i < count; i++) {
+        if (job_slots && job_slots[i] >= 0) {
+            status_set_next(i, STATUS_NEXT_FROM_SCHEDULE);
+            continue;
+        }
+        time_t next = next_fire_time(&crontab->jobs[i], now);
+        status_set_next(i, next);
+        if (next != CRON_NEVER) {
+            runqueue_update(&run_queue, i, next);
+        } else {
+            runqueue_remove(&run_queue, i);
+        }
+    }
 
-        if (current_minute != last_minute) {
-            last_minute = current_minute;
+    // Drop entries of jobs that no longer exist
+    for (int i = count; i < run_queue.pos_capacity; i++) {
+        runqueue_remove(&run_queue, i);
+    }
 
-            EnterCriticalSection(&jobs_lock);
+    index_next = due_index_next(&due_jobs, now);
+}
 
-            for (int i = 0; i < job_count; i++) {
-                cron_job *job = &jobs[i];
+typedef struct {
+    job_table *base;   // live table when the reload started, referenced
+    job_table *next;   // freshly parsed table, referenced
+    int *map;          // for each job of next, its index in base or -1
+    time_t *next_fire; // first fire time of every unmatched job
+    int matched;
+    int unchanged; // the file still had base's content, nothing to publish
+} reload_plan;
 
-                if (should_execute_job(job, current_time, now)) {
-                    job->is_running = 1;
+/**
+ * Diff next against base and schedule the new jobs. Only reads fields of base
+ * that never change after loading, so it runs off the scheduler thread.
+ * @return 0 on success, -1 if out of memory
+ */
+static int prepare_reload(reload_plan *plan) {
+    int count = plan->next->count;
+    plan->map = malloc(sizeof(int) * (size_t)(count > 0 ? count : 1));
+    plan->next_fire = malloc(sizeof(time_t) * (size_t)(count > 0 ? count : 1));
+    if (!plan->map || !plan->next_fire) {
+        return -1;
+    }
 
-                    job_execution_data *data = malloc(sizeof(job_execution_data));
-                    if (data) {
-                        strncpy(data->command, job->command, sizeof(data->command) - 1);
-                        data->command[sizeof(data->command) - 1] = '\0';
-                        data->job_index = i;
-                        data->scheduled_time = now;
+    if (plan->base) {
+        plan->matched = job_table_match(plan->base, plan->next, plan->map);
+    } else {
+        for (int i = 0; i < count; i++) {
+            plan->map[i] = -1;
+        }
+    }
 
-                        uintptr_t thread = _beginthread(execute_job_worker, 0, data);
-                        if ((int)thread == -1) {
-                            log_msg("Failed to create job execution thread");
-                            job->is_running = 0;
-                            free(data);
-                        }
-                    } else {
-                        log_msg("Failed to allocate memory for job execution");
-                        job->is_running = 0;
-                    }
-                }
+    time_t now = clock_now();
+    for (int i = 0; i < count; i++) {
+        if (plan->map[i] < 0) {
+            plan->next_fire[i] = next_fire_time(&plan->next->jobs[i], now);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Install plan->next as the live table: carry run state and queued fire times
+ * of unchanged jobs over, rebuild the run queue in one pass and swap the table
+ * pointer. O(jobs) with no parsing, so the scheduler barely notices.
+ * Runs on the scheduler thread; takes the plan's reference on next.
+ */
+static void publish_reload(reload_plan *plan) {
+    job_table *next = plan->next;
+    job_table *old = crontab;
+    int carry = old && old == plan->base;
+    time_t now = clock_now();
+
+    wcron_mutex_lock(&jobs_lock);
+
+    if (carry) {
+        old->forward = malloc(sizeof(int) * (size_t)(old->count > 0 ? old->count : 1));
+        if (old->forward) {
+            for (int j = 0; j < old->count; j++) {
+                old->forward[j] = -1;
+            }
+        }
+    }
+
+    runqueue_entry *entries = malloc(sizeof(runqueue_entry) * (size_t)(next->count > 0 ? next->count : 1));
+    int queued = 0;
+
+    // Kept jobs keep their index slot; without the slot array nothing stays indexed
+    int *slots = malloc(sizeof(int) * (size_t)(next->count > 0 ? next->count : 1));
+    if (!carry || !slots) {
+        due_index_clear(&due_jobs);
+        free(job_slots);
+        job_slots = NULL;
+    }
+
+    for (int i = 0; i < next->count; i++) {
+        cron_job *job = &next->jobs[i];
+        int j = carry ? plan->map[i] : -1;
+        int slot = -1;
+        time_t when = CRON_NEVER;
+
+        if (j >= 0) {
+            job->last_run = old->jobs[j].last_run;
+            // A run still going is only tracked across the swap if its completion can be forwarded
+            if (old->forward) {
+                job->is_running = old->jobs[j].is_running;
+                old->forward[j] = i;
+            }
+
+            slot = job_slots ? job_slots[j] : -1;
+            if (slot >= 0) {
+                job_slots[j] = -1; // taken over, not to be removed below
+                due_index_move(&due_jobs, slot, i);
+            } else if (!runqueue_get(&run_queue, j, &when)) {
+                // Never fires, or was indexed before the index had to be dropped
+                when = next_fire_time(job, now);
+            }
+        } else {
+            when = plan->next_fire[i];
+            if (slots && due_index_wants(job)) {
+                slot = due_index_add(&due_jobs, job, i);
+            }
+        }
+
+        if (slots) {
+            slots[i] = slot;
+        }
+        if (slot < 0 && entries && when != CRON_NEVER) {
+            entries[queued].when = when;
+            entries[queued].job = i;
+            queued++;
+        }
+    }
+
+    // Owed catch-up runs follow their jobs into the new table
+    int owed = 0;
+    for (int i = 0; i < catchup_count; i++) {
+        int j = catchups[i].job;
+        int to = old && old->forward && j < old->count ? old->forward[j] : -1;
+        if (to >= 0) {
+            catchups[owed] = catchups[i];
+            catchups[owed].job = to;
+            owed++;
+        }
+    }
+    catchup_count = owed;
+
+    // Whatever still holds a slot was removed from the crontab
+    for (int j = 0; job_slots && j < old->count; j++) {
+        if (job_slots[j] >= 0) {
+            due_index_remove(&due_jobs, job_slots[j], &old->jobs[j]);
+        }
+    }
+    free(job_slots);
+    job_slots = slots;
+
+    if (old) {
+        job_table_acquire(next);
+        old->successor = next;
+    }
+    __atomic_store_n(&crontab, next, __ATOMIC_RELEASE);
+
+    // Jobs carried over keep their status record; the fire times known here fill in the rest
+    status_reload(next, carry ? plan->map : NULL);
+    for (int k = 0; entries && k < queued; k++) {
+        status_set_next(entries[k].job, entries[k].when);
+    }
+    // Indexed jobs are not queued by fire time; readers of the status table work theirs out
+    for (int i = 0; slots && i < next->count; i++) {
+        if (slots[i] >= 0) {
+            status_set_next(i, STATUS_NEXT_FROM_SCHEDULE);
+        }
+    }
+
+    if (!entries || runqueue_build(&run_queue, entries, queued) != 0) {
+        log_msg("Failed to rebuild run queue, rescheduling every job");
+        runqueue_clear(&run_queue);
+        reschedule_jobs(now);
+    }
+
+    // Keep a pending evaluation: the deadline may have fired without being handled yet
+    time_t next_eval = due_index_next(&due_jobs, now);
+    if (index_next != CRON_NEVER && (next_eval == CRON_NEVER || index_next < next_eval)) {
+        next_eval = index_next;
+    }
+    index_next = next_eval;
+
+    wcron_mutex_unlock(&jobs_lock);
+
+    metrics_gauge_set(METRIC_JOBS, next->count);
+    if (old) {
+        metrics_count(METRIC_RELOADS);
+        metrics_keep_jobs(next->hashes, next->count);
+    }
+    free(entries);
+    plan->next = NULL;
+    if (old) {
+        job_table_release(old);
+    }
+}
+
+static void free_reload_plan(reload_plan *plan) {
+    if (plan->base) {
+        job_table_release(plan->base);
+    }
+    if (plan->next) {
+        job_table_release(plan->next);
+    }
+    free(plan->map);
+    free(plan->next_fire);
+    memset(plan, 0, sizeof(*plan));
+}
+
+void replace_job_table(job_table *table) {
+    reload_plan plan;
+    memset(&plan, 0, sizeof(plan));
+    plan.next = table;
+    plan.base = crontab;
+    if (plan.base) {
+        job_table_acquire(plan.base);
+    }
+
+    if (prepare_reload(&plan) == 0) {
+        publish_reload(&plan);
+    } else {
+        log_msg("Failed to allocate memory for crontab reload");
+    }
+    free_reload_plan(&plan);
+}
+
+#define SCHEDULER_MAX_WATCHES 32
+
+// Everything the scheduler sleeps on besides running children; the entry pointer is the loop tag
+static scheduler_watch_entry watches[SCHEDULER_MAX_WATCHES];
+static wcron_timer deadline_timer;
+static wcron_event control_event;
+static int scheduler_running;
+
+// Control channel, written by any thread and applied on the scheduler thread
+static int reload_requested;
+static int pause_requested;
+
+// Background reload, driven from the scheduler thread
+static reload_plan reload_result;
+static wcron_thread reload_worker;
+static wcron_event reload_event;
+static int reload_active;
+static int reload_again; // requested while a reload was running
+static unsigned reload_seq;
+static scheduler_reload_report last_reload;
+static scheduler_reload_fn reload_listener;
+
+// Editors save in bursts (truncate and write, or write a temp file and rename it over)
+#define CRONTAB_SETTLE_MS 200
+
+static wcron_file_watch *crontab_watch;
+static wcron_timer settle_timer;
+
+// Wall clock minus the boot clock at the last deadline; it only moves when the clock is set
+static int64_t clock_offset_ms;
+
+// Wakeups in the current clock hour, for the hourly log line; scheduler thread only
+static uint64_t wakeups_hour_count;
+static time_t wakeups_hour;
+
+int scheduler_watch(wcron_handle handle, scheduler_watch_fn fn, void *arg) {
+    for (int i = 0; i < SCHEDULER_MAX_WATCHES; i++) {
+        if (!watches[i].used) {
+            if (wcron_loop_add(scheduler_loop, handle, &watches[i]) != 0) {
+                return -1;
+            }
+            watches[i].handle = handle;
+            watches[i].fn = fn;
+            watches[i].arg = arg;
+            watches[i].used = 1;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void scheduler_unwatch(wcron_handle handle) {
+    for (int i = 0; i < SCHEDULER_MAX_WATCHES; i++) {
+        if (watches[i].used && watches[i].handle == handle) {
+            wcron_loop_remove(scheduler_loop, handle);
+            watches[i].used = 0;
+            return;
+        }
+    }
+}
+
+void scheduler_request_reload(void) {
+    __atomic_store_n(&reload_requested, 1, __ATOMIC_RELEASE);
+    wcron_event_set(control_event);
+}
+
+void scheduler_pause(int pause) {
+    __atomic_store_n(&pause_requested, pause ? 1 : 0, __ATOMIC_RELEASE);
+    wcron_event_set(control_event);
+}
+
+// Count one wakeup; the finished hour is logged lazily so reporting never wakes the daemon
+static void count_wakeup(time_t now) {
+    time_t hour = now / 3600;
+    time_t finished = wakeups_hour;
+    uint64_t finished_count = wakeups_hour_count;
+    if (hour != wakeups_hour) {
+        wakeups_hour = hour;
+        wakeups_hour_count = 0;
+    }
+    wakeups_hour_count++;
+    metrics_count(METRIC_WAKEUPS);
+
+    if (hour != finished && finished_count > 0) {
+        char label[32];
+        char msg[128];
+        struct tm tm;
+        tz_localtime(finished * 3600, &tm);
+        strftime(label, sizeof(label), "%Y-%m-%d %H:00", &tm);
+        snprintf(msg, sizeof(msg), "Scheduler woke %llu times in the hour from %s", (unsigned long long)finished_count,
+                 label);
+        log_msg(msg);
+    }
+}
+
+// Earliest queued fire time, indexed minute or jitter release; CRON_NEVER while paused or idle
+static time_t next_deadline(void) {
+    runqueue_entry entry;
+    time_t when = CRON_NEVER;
+
+    wcron_mutex_lock(&jobs_lock);
+    if (!paused) {
+        if (runqueue_peek(&run_queue, &entry)) {
+            when = entry.when;
+        }
+        if (index_next != CRON_NEVER && (when == CRON_NEVER || index_next < when)) {
+            when = index_next;
+        }
+        if (delayed_count > 0 && (when == CRON_NEVER || delayed[0]->release < when)) {
+            when = delayed[0]->release;
+        }
+    }
+    wcron_mutex_unlock(&jobs_lock);
+    return when;
+}
+
+// Point the one-shot timer at the next deadline, or disarm it
+static void arm_deadline(void) {
+    time_t when = next_deadline();
+    if (when == CRON_NEVER) {
+        wcron_timer_cancel(deadline_timer);
+    } else if (wcron_timer_set_at(deadline_timer, when) != 0) {
+        log_msg("Failed to set scheduler timer");
+    }
+}
+
+/**
+ * How far the wall clock was set since the last call, in milliseconds (positive:
+ * forward). Suspend advances both clocks alike, so it does not count.
+ */
+static int64_t clock_jump_ms(void) {
+    int64_t offset = wcron_realtime_ms() - (int64_t)wcron_boot_ms();
+    int64_t jump = offset - clock_offset_ms;
+    clock_offset_ms = offset;
+    return jump;
+}
+
+static void log_clock_jump(int64_t jump_ms) {
+    metrics_count(METRIC_CLOCK_JUMPS);
+    long long seconds = (jump_ms < 0 ? -jump_ms : jump_ms) / 1000;
+    char msg[128];
+    snprintf(msg, sizeof(msg), "System clock jumped %s by %lldh %02lldm %02llds", jump_ms < 0 ? "back" : "forward",
+             seconds / 3600, seconds / 60 % 60, seconds % 60);
+    log_msg(msg);
+}
+
+// Start what is due at now, or work the schedule out again after the clock was set back
+static void run_tick(time_t now, int set_back) {
+    wcron_mutex_lock(&jobs_lock);
+    if (set_back) {
+        reschedule_jobs(now);
+    } else if (!paused) {
+        run_due_jobs(now);
+    }
+    if (!paused) {
+        release_delayed(now);
+    }
+    wcron_mutex_unlock(&jobs_lock);
+}
+
+static void on_deadline(wcron_handle handle, void *arg) {
+    (void)arg;
+    uint64_t tick_us = wcron_monotonic_us();
+    // Not time(): on Linux it reads a coarse clock that can still show the second before the
+    // timer's expiry, and the deadline would then fire again and again until it caught up
+    time_t now = clock_now();
+    int clock_changed = wcron_timer_ack(handle);
+    int64_t jump = clock_jump_ms();
+
+    if (jump >= CLOCK_JUMP_MIN_MS || jump <= -CLOCK_JUMP_MIN_MS) {
+        log_clock_jump(jump);
+    }
+
+    // Queued times stay right when the clock moves forward: what it skipped is a gap
+    // for catch-up. Set back, they lie too far ahead and are computed again.
+    int set_back = jump <= -CLOCK_JUMP_MIN_MS || (clock_changed && jump <= 0);
+    run_tick(now, set_back);
+
+    if (set_back) {
+        log_msg("System clock set back, job schedule recomputed");
+    }
+    metrics_observe(METRIC_TICK, wcron_monotonic_us() - tick_us);
+}
+
+// Parse and diff the crontab off the scheduler thread, then wake it to publish
+static void reload_thread(void *param) {
+    reload_plan *plan = (reload_plan *)param;
+    char crontab_path[WCRON_PATH_MAX_SIZE];
+
+    if (get_crontab_path(crontab_path, sizeof(crontab_path))) {
+        plan->next = job_table_load(crontab_path, plan->base);
+    }
+    if (plan->next && plan->next == plan->base) {
+        job_table_release(plan->next);
+        plan->next = NULL;
+        plan->unchanged = 1;
+    } else if (plan->next && prepare_reload(plan) != 0) {
+        log_msg("Failed to allocate memory for crontab reload");
+        job_table_release(plan->next);
+        plan->next = NULL;
+    }
+
+    wcron_event_set(reload_event);
+}
+
+// Record how reload number reload_seq ended
+static void record_reload(scheduler_reload_result result, const reload_plan *plan) {
+    memset(&last_reload, 0, sizeof(last_reload));
+    last_reload.seq = reload_seq;
+    last_reload.result = result;
+    last_reload.jobs = crontab ? crontab->count : 0;
+    last_reload.problems = crontab ? crontab->problems : 0;
+    if (result == SCHEDULER_RELOAD_LOADED) {
+        last_reload.jobs = plan->next->count;
+        last_reload.problems = plan->next->problems;
+        last_reload.unchanged = plan->matched;
+        last_reload.added = plan->next->count - plan->matched;
+        last_reload.removed = plan->base ? plan->base->count - plan->matched : 0;
+    }
+}
+
+static void notify_reload(void) {
+    if (reload_listener) {
+        reload_listener(&last_reload);
+    }
+}
+
+static void start_reload(const char *reason) {
+    if (reload_active) {
+        reload_again = 1;
+        return;
+    }
+
+    log_msg(reason);
+    reload_seq++;
+
+    memset(&reload_result, 0, sizeof(reload_result));
+    reload_result.base = crontab;
+    if (crontab) {
+        job_table_acquire(crontab);
+    }
+
+    if (wcron_thread_start(&reload_worker, reload_thread, &reload_result) != 0) {
+        log_msg("Failed to start crontab reload thread");
+        free_reload_plan(&reload_result);
+        record_reload(SCHEDULER_RELOAD_FAILED, NULL);
+        notify_reload();
+        return;
+    }
+    reload_active = 1;
+}
+
+static void on_reload_done(wcron_handle handle, void *arg) {
+    (void)arg;
+    wcron_event_reset(handle);
+
+    wcron_thread_join(reload_worker);
+    reload_active = 0;
+
+    if (reload_result.next) {
+        char msg[128];
+        int total = reload_result.next->count;
+        int removed = reload_result.base ? reload_result.base->count - reload_result.matched : 0;
+        snprintf(msg, sizeof(msg), "Loaded %d jobs from crontab (%d unchanged, %d new, %d removed)", total,
+                 reload_result.matched, total - reload_result.matched, removed);
+        // Counted before publishing, which hands the new table over
+        record_reload(SCHEDULER_RELOAD_LOADED, &reload_result);
+        publish_reload(&reload_result);
+        log_msg(msg);
+    } else if (reload_result.unchanged) {
+        log_msg("Crontab content unchanged, keeping current jobs");
+        record_reload(SCHEDULER_RELOAD_UNCHANGED, NULL);
+    } else {
+        log_msg("Failed to load crontab, keeping current jobs");
+        record_reload(SCHEDULER_RELOAD_FAILED, NULL);
+    }
+    free_reload_plan(&reload_result);
+    notify_reload();
+
+    if (reload_again) {
+        reload_again = 0;
+        start_reload("Reloading crontab");
+    }
+}
+
+static void on_crontab_changed(wcron_handle handle, void *arg) {
+    (void)handle;
+    (void)arg;
+    // Each event restarts the settle timer, so a burst of writes costs one reload
+    if (wcron_file_watch_ack(crontab_watch) && wcron_timer_set_after(settle_timer, CRONTAB_SETTLE_MS) != 0) {
+        log_msg("Failed to set crontab settle timer");
+    }
+}
+
+static void on_crontab_settled(wcron_handle handle, void *arg) {
+    (void)arg;
+    wcron_timer_ack(handle);
+    start_reload("Crontab changed on disk, reloading");
+}
+
+// Reload on its own when crontab.txt is edited; without a watch, reloads stay manual
+static void watch_crontab(void) {
+    char crontab_path[WCRON_PATH_MAX_SIZE];
+    if (!get_crontab_path(crontab_path, sizeof(crontab_path))) {
+        return;
+    }
+
+    crontab_watch = wcron_file_watch_create(crontab_path);
+    if (!crontab_watch) {
+        log_msg("Failed to watch crontab for changes, use 'wcrontab reload' after editing");
+        return;
+    }
+    if (wcron_timer_create(&settle_timer) != 0) {
+        log_msg("Failed to create crontab settle timer");
+        wcron_file_watch_destroy(crontab_watch);
+        crontab_watch = NULL;
+        return;
+    }
+
+    scheduler_watch(wcron_file_watch_handle(crontab_watch), on_crontab_changed, NULL);
+    scheduler_watch(settle_timer, on_crontab_settled, NULL);
+}
+
+static void unwatch_crontab(void) {
+    if (!crontab_watch) {
+        return;
+    }
+    scheduler_unwatch(wcron_file_watch_handle(crontab_watch));
+    scheduler_unwatch(settle_timer);
+    wcron_file_watch_destroy(crontab_watch);
+    wcron_timer_destroy(settle_timer);
+    crontab_watch = NULL;
+}
+
+static void apply_pause(int pause) {
+    if (pause == paused) {
+        return;
+    }
+    wcron_mutex_lock(&jobs_lock);
+    paused = pause;
+    admit_waiting();
+    wcron_mutex_unlock(&jobs_lock);
+    metrics_gauge_set(METRIC_PAUSED, pause);
+    status_set_paused(pause);
+    log_msg(pause ? "Cron service paused" : "Cron service resumed");
+}
+
+static void on_control(wcron_handle handle, void *arg) {
+    (void)arg;
+    // Reset before reading so a request posted meanwhile leaves the event set
+    wcron_event_reset(handle);
+
+    if (__atomic_exchange_n(&reload_requested, 0, __ATOMIC_ACQ_REL)) {
+        start_reload("Reloading crontab");
+    }
+
+    apply_pause(__atomic_load_n(&pause_requested, __ATOMIC_ACQUIRE));
+}
+
+unsigned scheduler_reload(void) {
+    if (reload_active) {
+        // The running reload may have read the file before the request: the next one covers it
+        reload_again = 1;
+        return reload_seq + 1;
+    }
+    start_reload("Reloading crontab");
+    return reload_seq;
+}
+
+void scheduler_last_reload(scheduler_reload_report *report) {
+    *report = last_reload;
+}
+
+void scheduler_on_reload(scheduler_reload_fn fn) {
+    reload_listener = fn;
+}
+
+void scheduler_set_paused(int pause) {
+    // Also the requested state, or the next control event would undo it
+    __atomic_store_n(&pause_requested, pause ? 1 : 0, __ATOMIC_RELEASE);
+    apply_pause(pause ? 1 : 0);
+}
+
+int scheduler_run_now(int job) {
+    int r = -1;
+    wcron_mutex_lock(&jobs_lock);
+    if (crontab && job >= 0 && job < crontab->count) {
+        r = 1;
+        if (!crontab->jobs[job].is_running) {
+            launch_job(&crontab->jobs[job], job, clock_now(), RUN_MANUAL);
+            r = 0;
+        }
+    }
+    wcron_mutex_unlock(&jobs_lock);
+    return r;
+}
+
+void scheduler_get_status(scheduler_status *status) {
+    status->paused = paused;
+    status->next_fire = next_deadline();
+    status->runs = runs_active;
+}
+
+static void describe_run(const job_run *run, scheduler_run_info *info) {
+    info->job = live_index(run);
+    info->hash = run->table->hashes[run->job_index];
+    info->command = run->command;
+    info->scheduled = run->scheduled_time;
+    info->catch_up = run->kind == RUN_CATCHUP;
+    info->manual = run->kind == RUN_MANUAL;
+    // A launcher may be starting it right now; the pid is only read once the start is published
+    info->started_ms = __atomic_load_n(&run->running_since_ms, __ATOMIC_ACQUIRE);
+    info->pid = info->started_ms ? (long)run->process.pid : 0;
+}
+
+void scheduler_list_runs(scheduler_run_fn fn, void *arg) {
+    for (run_slab *slab = run_slabs; slab; slab = slab->next) {
+        for (int i = 0; i < RUN_SLAB_SIZE; i++) {
+            const job_run *run = &slab->runs[i];
+            if (!run->active) {
+                continue;
             }
 
-            LeaveCriticalSection(&jobs_lock);
+            scheduler_run_info info;
+            describe_run(run, &info);
+            fn(&info, arg);
         }
     }
+}
+
+static void on_stop(wcron_handle handle, void *arg) {
+    (void)handle;
+    (void)arg;
+    log_msg("Scheduler received stop signal");
+    scheduler_running = 0;
+}
+
+/**
+ * Scheduler event loop. Sleeps until the next queued fire time or until one of
+ * the watched handles (stop, control channel, signals, children) is ready, so
+ * an idle daemon does not wake up between jobs.
+ */
+void scheduler_thread(void *param) {
+    (void)param;
+
+    log_msg("Scheduler thread started");
+
+    scheduler_running = 1;
+    while (scheduler_running) {
+        arm_deadline();
+
+        void *tag;
+        int r = wcron_loop_wait(scheduler_loop, -1, &tag);
+        if (r < 0) {
+            log_msg("Scheduler wait failed");
+            break;
+        }
+        if (r == 0) {
+            continue;
+        }
 
-    CancelWaitableTimer(timer);
-    CloseHandle(timer);
-    DeleteCriticalSection(&jobs_lock);
+        count_wakeup(clock_now());
+
+        scheduler_watch_entry *watch = (scheduler_watch_entry *)tag;
+        watch->fn(watch->handle, watch->arg);
+    }
 
     log_msg("Scheduler thread stopped");
 }
 
+// Launch pacing settings from the environment; both off by default
+static void read_pacing(void) {
+    const char *value = getenv("WCRON_JITTER");
+    if (value && *value) {
+        jitter_window = (unsigned)strtoul(value, NULL, 10);
+    }
+
+    value = getenv("WCRON_MAX_RUNNING");
+    if (value && *value) {
+        max_running = (int)strtol(value, NULL, 10);
+        max_running = max_running < 0 ? 0 : max_running;
+    }
+
+    if (jitter_window > 0 || max_running > 0) {
+        char cap[32] = "no cap on running jobs";
+        if (max_running > 0) {
+            snprintf(cap, sizeof(cap), "at most %d jobs at once", max_running);
+        }
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Launch pacing: jitter window %u s, %s", jitter_window, cap);
+        log_msg(msg);
+    }
+}
+
+// Job state shared by the daemon and simulations
+static void init_schedule(void) {
+    wcron_mutex_init(&jobs_lock);
+    read_pacing();
+
+    if (runqueue_init(&run_queue, 0) != 0 || due_index_init(&due_jobs, 0) != 0) {
+        log_msg("Failed to allocate job run queue");
+    }
+}
+
 void init_job_system(void) {
-    for (int i = 0; i < WCRON_MAX_JOBS; i++) {
-        cron_job *job = &jobs[i];
-        if (job) {
-            job->is_running = 0;
-            job->last_run = 0;
+    init_schedule();
+
+    scheduler_loop = wcron_loop_create();
+    if (!scheduler_loop) {
+        log_msg("Failed to create scheduler event loop");
+        return;
+    }
+    if (wcron_timer_create(&deadline_timer) != 0 || wcron_event_create(&control_event) != 0) {
+        log_msg("Failed to create scheduler timer");
+        return;
+    }
+
+    clock_jump_ms();
+    scheduler_watch(stop_event, on_stop, NULL);
+    scheduler_watch(deadline_timer, on_deadline, NULL);
+    scheduler_watch(control_event, on_control, NULL);
+
+    wcron_mutex_init(&launch_lock);
+    wcron_mutex_init(&handoff_lock);
+    if (wcron_sem_init(&launch_sem, 0) != 0 || wcron_event_create(&handoff_event) != 0) {
+        log_msg("Failed to create job launcher queue");
+        return;
+    }
+    scheduler_watch(handoff_event, on_handoff, NULL);
+
+    if (wcron_event_create(&reload_event) != 0) {
+        log_msg("Failed to create reload event");
+        return;
+    }
+    scheduler_watch(reload_event, on_reload_done, NULL);
+    watch_crontab();
+
+    for (int i = 0; i < LAUNCHER_THREADS; i++) {
+        if (wcron_thread_start(&launchers[launcher_count], launcher_thread, NULL) != 0) {
+            log_msg("Failed to create job launcher thread");
+            break;
         }
+        launcher_count++;
+    }
+}
+
+// Let the launchers drain their queue, then join them
+static void stop_launchers(void) {
+    wcron_mutex_lock(&launch_lock);
+    launchers_stopping = 1;
+    wcron_mutex_unlock(&launch_lock);
+
+    for (int i = 0; i < launcher_count; i++) {
+        wcron_sem_post(&launch_sem);
+    }
+    for (int i = 0; i < launcher_count; i++) {
+        wcron_thread_join(launchers[i]);
     }
+    launcher_count = 0;
 }
 
 void shutdown_job_system(void) {
     log_msg("Shutting down job system");
 
-    Sleep(5000);
+    // Past this point the loop only sees runs end: the launchers are about to go, so no fire time, reload or
+    // control request may start anything
+    scheduler_unwatch(stop_event);
+    scheduler_unwatch(deadline_timer);
+    wcron_timer_cancel(deadline_timer);
+    scheduler_unwatch(control_event);
+    scheduler_unwatch(reload_event);
+    unwatch_crontab();
+    if (reload_active) {
+        wcron_thread_join(reload_worker);
+        reload_active = 0;
+        free_reload_plan(&reload_result);
+    }
+
+    // Runs still held back by jitter or the admission queue never start
+    wcron_mutex_lock(&jobs_lock);
+    int dropped = 0;
+    while (delayed_count > 0 || admit_head) {
+        job_run *run;
+        if (delayed_count > 0) {
+            run = delay_pop();
+        } else {
+            run = admit_head;
+            admit_head = run->next;
+        }
+        int index = live_index(run);
+        if (index >= 0) {
+            crontab->jobs[index].is_running = 0;
+            status_set_running(index, 0);
+        }
+        job_table_release(run->table);
+        run_release(run);
+        metrics_gauge_add(METRIC_QUEUED, -1);
+        dropped++;
+    }
+    admit_tail = NULL;
+    free(delayed);
+    delayed = NULL;
+    delayed_capacity = 0;
+    wcron_mutex_unlock(&jobs_lock);
+
+    if (dropped > 0) {
+        char msg[96];
+        snprintf(msg, sizeof(msg), "%d queued runs dropped at shutdown", dropped);
+        log_msg(msg);
+    }
+
+    stop_launchers();
+
+    // Keep reaping for up to 5 seconds so short jobs can finish cleanly
+    uint64_t deadline = wcron_monotonic_ms() + 5000;
+    while (runs_active > 0) {
+        uint64_t now = wcron_monotonic_ms();
+        void *tag;
+        if (now >= deadline || wcron_loop_wait(scheduler_loop, (int)(deadline - now), &tag) <= 0) {
+            break;
+        }
+        scheduler_watch_entry *watch = (scheduler_watch_entry *)tag;
+        watch->fn(watch->handle, watch->arg);
+    }
 
-    EnterCriticalSection(&jobs_lock);
+    wcron_mutex_lock(&jobs_lock);
 
-    for (int i = 0; i < job_count; i++) {
-        if (jobs[i].is_running) {
+    for (int i = 0; crontab && i < crontab->count; i++) {
+        if (crontab->jobs[i].is_running) {
             char msg[128];
             snprintf(msg, sizeof(msg), "Warning: Job #%d still running during shutdown", i);
             log_msg(msg);
         }
     }
 
-    LeaveCriticalSection(&jobs_lock);
+    runqueue_free(&run_queue);
+    due_index_free(&due_jobs);
+    free(job_slots);
+    job_slots = NULL;
+    free(catchups);
+    catchups = NULL;
+    catchup_count = 0;
+    catchup_capacity = 0;
+
+    wcron_mutex_unlock(&jobs_lock);
+
+    wcron_loop_destroy(scheduler_loop);
+    if (child_watch != WCRON_NO_HANDLE) {
+        wcron_handle_close(child_watch);
+        child_watch = WCRON_NO_HANDLE;
+    }
+    free(early_exits);
+    early_exits = NULL;
+    early_count = 0;
+    early_capacity = 0;
+    wcron_timer_destroy(deadline_timer);
+    wcron_event_destroy(control_event);
+    wcron_event_destroy(handoff_event);
+    wcron_event_destroy(reload_event);
+    wcron_sem_destroy(&launch_sem);
+    wcron_mutex_destroy(&launch_lock);
+    wcron_mutex_destroy(&handoff_lock);
+    scheduler_loop = NULL;
+
+    // Runs still going keep their records and tables; the process is about to exit anyway
+    if (runs_active == 0) {
+        run_pool_free();
+        job_table_release(crontab);
+        crontab = NULL;
+    }
+    wcron_mutex_destroy(&jobs_lock);
+}
+
+void scheduler_set_clock(scheduler_clock_fn clock) {
+    clock_ms = clock;
+}
+
+void scheduler_sim_init(scheduler_spawn_fn spawn, void *arg) {
+    sim_spawn = spawn;
+    sim_arg = arg;
+    init_schedule();
+}
+
+time_t scheduler_next_deadline(void) {
+    return next_deadline();
+}
+
+void scheduler_sim_tick(void) {
+    run_tick(clock_now(), 0);
+}
+
+void scheduler_sim_finish(struct job_run *run, int exit_code) {
+    run->exit_code = exit_code;
+    int64_t elapsed = clock_ms() - run->start_wall_ms;
+    settle_run(run, exit_code, elapsed > 0 ? (uint32_t)elapsed : 0);
 }
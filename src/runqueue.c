@@ -0,0 +1,190 @@
+#include "wcron/runqueue.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void heap_set(runqueue *q, int slot, runqueue_entry entry) {
+    q->heap[slot] = entry;
+    q->pos[entry.job] = slot;
+}
+
+static void sift_up(runqueue *q, int slot) {
+    runqueue_entry entry = q->heap[slot];
+
+    while (slot > 0) {
+        int parent = (slot - 1) / 2;
+        if (q->heap[parent].when <= entry.when) {
+            break;
+        }
+        heap_set(q, slot, q->heap[parent]);
+        slot = parent;
+    }
+    heap_set(q, slot, entry);
+}
+
+static void sift_down(runqueue *q, int slot) {
+    runqueue_entry entry = q->heap[slot];
+
+    while (1) {
+        int child = slot * 2 + 1;
+        if (child >= q->count) {
+            break;
+        }
+        if (child + 1 < q->count && q->heap[child + 1].when < q->heap[child].when) {
+            child++;
+        }
+        if (entry.when <= q->heap[child].when) {
+            break;
+        }
+        heap_set(q, slot, q->heap[child]);
+        slot = child;
+    }
+    heap_set(q, slot, entry);
+}
+
+static int grow_jobs(runqueue *q, int job) {
+    if (job < q->pos_capacity) {
+        return 0;
+    }
+
+    int capacity = q->pos_capacity ? q->pos_capacity : 64;
+    while (capacity <= job) {
+        capacity *= 2;
+    }
+
+    int *pos = realloc(q->pos, sizeof(int) * (size_t)capacity);
+    runqueue_entry *heap = realloc(q->heap, sizeof(runqueue_entry) * (size_t)capacity);
+    if (pos) {
+        q->pos = pos;
+    }
+    if (heap) {
+        q->heap = heap;
+    }
+    if (!pos || !heap) {
+        return -1;
+    }
+
+    for (int i = q->pos_capacity; i < capacity; i++) {
+        q->pos[i] = -1;
+    }
+    q->pos_capacity = capacity;
+    q->capacity = capacity;
+    return 0;
+}
+
+int runqueue_init(runqueue *q, int job_capacity) {
+    memset(q, 0, sizeof(*q));
+    if (job_capacity > 0) {
+        return grow_jobs(q, job_capacity - 1);
+    }
+    return 0;
+}
+
+void runqueue_free(runqueue *q) {
+    free(q->heap);
+    free(q->pos);
+    memset(q, 0, sizeof(*q));
+}
+
+void runqueue_clear(runqueue *q) {
+    for (int i = 0; i < q->count; i++) {
+        q->pos[q->heap[i].job] = -1;
+    }
+    q->count = 0;
+}
+
+int runqueue_build(runqueue *q, const runqueue_entry *entries, int count) {
+    runqueue_clear(q);
+
+    int max_job = -1;
+    for (int i = 0; i < count; i++) {
+        if (entries[i].job > max_job) {
+            max_job = entries[i].job;
+        }
+    }
+    // grow_jobs() sizes heap and pos together, so this covers both
+    if (grow_jobs(q, max_job > count - 1 ? max_job : count - 1) != 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        heap_set(q, i, entries[i]);
+    }
+    q->count = count;
+
+    // Floyd's heap construction
+    for (int slot = count / 2 - 1; slot >= 0; slot--) {
+        sift_down(q, slot);
+    }
+    return 0;
+}
+
+int runqueue_update(runqueue *q, int job, time_t when) {
+    if (job < 0 || grow_jobs(q, job) != 0) {
+        return -1;
+    }
+
+    int slot = q->pos[job];
+    if (slot < 0) {
+        slot = q->count++;
+        heap_set(q, slot, (runqueue_entry){when, job});
+        sift_up(q, slot);
+        return 0;
+    }
+
+    time_t old = q->heap[slot].when;
+    q->heap[slot].when = when;
+    if (when < old) {
+        sift_up(q, slot);
+    } else if (when > old) {
+        sift_down(q, slot);
+    }
+    return 0;
+}
+
+void runqueue_remove(runqueue *q, int job) {
+    if (job < 0 || job >= q->pos_capacity || q->pos[job] < 0) {
+        return;
+    }
+
+    int slot = q->pos[job];
+    q->pos[job] = -1;
+    q->count--;
+
+    if (slot == q->count) {
+        return;
+    }
+
+    // Move the last entry into the hole and restore heap order around it
+    runqueue_entry moved = q->heap[q->count];
+    heap_set(q, slot, moved);
+    if (slot > 0 && moved.when < q->heap[(slot - 1) / 2].when) {
+        sift_up(q, slot);
+    } else {
+        sift_down(q, slot);
+    }
+}
+
+int runqueue_get(const runqueue *q, int job, time_t *when) {
+    if (job < 0 || job >= q->pos_capacity || q->pos[job] < 0) {
+        return 0;
+    }
+    *when = q->heap[q->pos[job]].when;
+    return 1;
+}
+
+int runqueue_peek(const runqueue *q, runqueue_entry *out) {
+    if (q->count == 0) {
+        return 0;
+    }
+    *out = q->heap[0];
+    return 1;
+}
+
+int runqueue_pop(runqueue *q, runqueue_entry *out) {
+    if (q->count == 0) {
+        return 0;
+    }
+    *out = q->heap[0];
+    runqueue_remove(q, out->job);
+    return 1;
+}
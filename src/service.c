@@ -1,19 +1,16 @@
 #include "wcron/service.h"
-#include "minwindef.h"
+#include "wcron/journal.h"
 #include "wcron/parser.h"
+#include "wcron/platform.h"
 #include "wcron/runner.h"
-#include <process.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
-#include <unistd.h>
 
-cron_job jobs[WCRON_MAX_JOBS];
-int job_count = 0; // Number of jobs loaded from crontab.txt
+job_table *crontab; // Jobs loaded from crontab.txt, replaced as a whole on reload
 int paused = 0;
-SERVICE_STATUS service_status;
-SERVICE_STATUS_HANDLE service_status_handle;
-HANDLE stop_event;
+wcron_event stop_event;
 
 // Template when creating a new crontab file
 const char *DEFAULT_CRONTAB_TEMPLATE =
@@ -45,46 +42,14 @@ const char *DEFAULT_CRONTAB_TEMPLATE =
     "# NOTE: Lines starting with # are comments and will be ignored.\n"
     "\n";
 
-void log_msg(const char *msg) {
-    char log_path[MAX_PATH];
-    char exe_dir[MAX_PATH];
-
-    // Get executable directory
-    if (__dirname(exe_dir, sizeof(exe_dir)) == 0) {
-        return;
-    }
-
-    int result = snprintf(log_path, sizeof(log_path), "%s\\wcron.log", exe_dir);
-    if (result >= (int)sizeof(log_path) || result < 0) {
-        return;
-    }
-
-    FILE *f = fopen(log_path, "a");
-    if (!f)
-        return;
-
-    time_t t = time(NULL);
-    struct tm *tm = localtime(&t);
-    fprintf(f, "[%04d-%02d-%02d %02d:%02d:%02d] %s\n", tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday, tm->tm_hour,
-            tm->tm_min, tm->tm_sec, msg);
-    fclose(f);
-}
-
 void show_logs() {
-    char log_path[MAX_PATH];
-    char exe_dir[MAX_PATH];
+    char log_path[WCRON_PATH_MAX_SIZE];
 
-    // Get executable directory
-    if (__dirname(exe_dir, sizeof(exe_dir)) == 0) {
+    if (!get_log_path(log_path, sizeof(log_path))) {
         printf("Failed to get executable directory\n");
         return;
     }
 
-    int result = snprintf(log_path, sizeof(log_path), "%s\\wcron.log", exe_dir);
-    if (result >= (int)sizeof(log_path) || result < 0) {
-        return;
-    }
-
     FILE *f = fopen(log_path, "r");
     if (!f) {
         printf("No log file found at: %s\n", log_path);
@@ -99,334 +64,269 @@ void show_logs() {
     fclose(f);
 }
 
-int __dirname(char *buffer, size_t length) {
-    DWORD len = GetModuleFileName(NULL, buffer, (DWORD)length);
-    if (len == 0) {
+int parse_local_time(const char *value, time_t *t) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    char sep;
+    int fields = sscanf(value, "%d-%d-%d%c%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &sep, &tm.tm_hour,
+                        &tm.tm_min, &tm.tm_sec);
+    if (fields != 3 && (fields < 6 || (sep != ' ' && sep != 'T'))) {
         return 0;
     }
 
-    char *last_slash = strrchr(buffer, '\\');
-    if (last_slash) {
-        *last_slash = '\0';
-    }
-
-    return 1;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1;
+    *t = mktime(&tm);
+    return *t != (time_t)-1;
 }
 
-int __filename(char *buffer, size_t length) {
-    DWORD len = GetModuleFileName(NULL, buffer, (DWORD)length);
-    if (len == 0) {
-        return 0;
+/**
+ * Parse a --since value: an absolute local time as parse_local_time() takes it,
+ * or an age such as 30m, 12h or 7d
+ * @return 1 if parsed, 0 otherwise
+ */
+static int parse_since(const char *value, int64_t *since_ms) {
+    long amount;
+    char unit, extra;
+    if (sscanf(value, "%ld%c%c", &amount, &unit, &extra) == 2 && amount >= 0) {
+        long seconds = unit == 's' ? 1 : unit == 'm' ? 60 : unit == 'h' ? 3600 : unit == 'd' ? 86400 : 0;
+        if (seconds) {
+            *since_ms = ((int64_t)time(NULL) - (int64_t)amount * seconds) * 1000;
+            return 1;
+        }
     }
 
-    // Find last backslash to get filename
-    char *last_slash = strrchr(buffer, '\\');
-    if (last_slash) {
-        char *filename = last_slash + 1;
-        memmove(buffer, filename, strlen(filename) + 1);
+    time_t t;
+    if (!parse_local_time(value, &t)) {
+        return 0;
     }
-
+    *since_ms = (int64_t)t * 1000;
     return 1;
 }
 
-int get_crontab_path(char *buffer, size_t size) {
-    char dir[MAX_PATH];
-    if (!__dirname(dir, MAX_PATH))
-        return 0;
-    int res = snprintf(buffer, size, "%s%s%s", dir, DIRECTORY_SEPARATOR, "crontab.txt");
-    return (res > 0 && res < (int)size);
-}
-
-void load_jobs() {
-    char crontab_path[MAX_PATH];
-    if (!get_crontab_path(crontab_path, sizeof(crontab_path))) {
-        perror("Failed to get crontab path");
-        return;
+int show_run_history(int argc, char *argv[]) {
+    journal_query query;
+    int job = -1;
+    query.by_job = 0;
+    query.job_hash = 0;
+    query.since_ms = 0;
+    query.failed_only = 0;
+    query.tail = 0;
+
+    for (int i = 0; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--failed") == 0) {
+            query.failed_only = 1;
+        } else if (strcmp(argv[i], "--job") == 0 && value) {
+            job = atoi(value);
+            i++;
+        } else if (strcmp(argv[i], "--tail") == 0 && value) {
+            query.tail = atol(value);
+            i++;
+        } else if (strcmp(argv[i], "--since") == 0 && value) {
+            if (!parse_since(value, &query.since_ms)) {
+                fprintf(stderr, "Error: Invalid --since value '%s'\n", value);
+                return 1;
+            }
+            i++;
+        } else {
+            fprintf(stderr, "Error: Unknown logs option '%s'\n", argv[i]);
+            printf("Usage: wcrontab logs [--job N] [--since TIME] [--failed] [--tail N]\n");
+            return 1;
+        }
     }
 
-    FILE *fp = fopen(crontab_path, "r");
-    if (!fp) {
-        return;
+    char journal_path[WCRON_PATH_MAX_SIZE];
+    if (!get_journal_path(journal_path, sizeof(journal_path))) {
+        printf("Failed to get executable directory\n");
+        return 1;
+    }
+
+    if (job >= 0) {
+        // Runs carry their line's hash, so they stay with the job when lines above it are added or removed
+        char crontab_path[WCRON_PATH_MAX_SIZE];
+        job_table *table = get_crontab_path(crontab_path, sizeof(crontab_path)) ? job_table_load(crontab_path, NULL)
+                                                                                 : NULL;
+        if (!table || job >= table->count) {
+            printf("No job #%d in the crontab\n", job);
+            job_table_release(table);
+            return 1;
+        }
+        query.by_job = 1;
+        query.job_hash = table->hashes[job];
+        job_table_release(table);
     }
 
-    char line[512];
-    job_count = 0;
+    long printed = journal_print(journal_path, &query);
+    if (printed < 0) {
+        printf("No run journal found at: %s\n", journal_path);
+        return 1;
+    }
+    if (printed == 0) {
+        printf("(no matching runs)\n");
+    }
+    return 0;
+}
 
-    while (fgets(line, sizeof(line), fp) && job_count < WCRON_MAX_JOBS) {
-        // Skip comments and empty lines
-        if (line[0] == '#' || line[0] == '\n') {
-            continue;
-        }
+int show_job_output(int job) {
+    char crontab_path[WCRON_PATH_MAX_SIZE];
+    char output_dir[WCRON_PATH_MAX_SIZE];
+    if (!get_crontab_path(crontab_path, sizeof(crontab_path)) || !get_output_dir(output_dir, sizeof(output_dir))) {
+        printf("Failed to get executable directory\n");
+        return 1;
+    }
 
-        if (parse_cron_line(line, &jobs[job_count]) == 0) {
-            job_count++;
-        }
+    // Output files are named after the job's crontab line, so look it up in the current crontab
+    job_table *table = job_table_load(crontab_path, NULL);
+    if (!table || job < 0 || job >= table->count) {
+        printf("No job #%d in the crontab\n", job);
+        job_table_release(table);
+        return 1;
     }
 
-    fclose(fp);
-}
+    char path[WCRON_PATH_MAX_SIZE + 32];
+    snprintf(path, sizeof(path), "%s%s%016llx.log", output_dir, DIRECTORY_SEPARATOR,
+             (unsigned long long)table->hashes[job]);
+    printf("=== Output of job #%d: %s ===\n", job, table->jobs[job].command);
+    job_table_release(table);
 
-/**
- * Create a crontab file with the default template
- * @param path Path of the file to create
- * @return 1 if created successfully, 0 otherwise
- */
-int create_default_crontab(const char *path) {
-    FILE *fp = fopen(path, "w");
-    if (!fp) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        printf("(no output recorded)\n");
         return 0;
     }
-
-    fputs(DEFAULT_CRONTAB_TEMPLATE, fp);
-    fclose(fp);
-    return 1;
+    char buffer[4096];
+    size_t n;
+    char last = '\n';
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        fwrite(buffer, 1, n, stdout);
+        last = buffer[n - 1];
+    }
+    fclose(f);
+    if (last != '\n') {
+        printf("\n");
+    }
+    return 0;
 }
 
-/**
- * Open the editor with safe path validation
- * @param crontab_path Path of the crontab file
- * @return 1 if opened successfully, 0 otherwise
- */
-int open_editor_safely(const char *crontab_path) {
-    // Review path for invalid characters
-    if (strchr(crontab_path, '\"') != NULL || strchr(crontab_path, '&') != NULL) {
-        fprintf(stderr, "Error: Invalid characters in crontab path\n");
+int __dirname(char *buffer, size_t length) {
+    if (wcron_executable_path(buffer, length) != 0) {
         return 0;
     }
 
-    // Use CreateProcess for greater security
-    STARTUPINFO si;
-    PROCESS_INFORMATION pi;
-
-    ZeroMemory(&si, sizeof(si));
-    si.cb = sizeof(si);
-    ZeroMemory(&pi, sizeof(pi));
-
-    // Build command safely
-    char cmd[MAX_PATH * 2];
-    snprintf(cmd, sizeof(cmd), "notepad.exe \"%s\"", crontab_path);
-
-    // Create process
-    if (!CreateProcess(NULL,  // No module name (use command line)
-                       cmd,   // Command line
-                       NULL,  // Process handle not inheritable
-                       NULL,  // Thread handle not inheritable
-                       FALSE, // Set handle inheritance to FALSE
-                       0,     // No creation flags
-                       NULL,  // Use parent's environment block
-                       NULL,  // Use parent's starting directory
-                       &si,   // Pointer to STARTUPINFO structure
-                       &pi)   // Pointer to PROCESS_INFORMATION structure
-    ) {
-        fprintf(stderr, "Failed to open editor (error %lu)\n", GetLastError());
-        return 0;
+    char *last_slash = strrchr(buffer, DIRECTORY_SEPARATOR_CHAR);
+    if (last_slash) {
+        *last_slash = '\0';
     }
 
-    // Wait for the editor to close
-    WaitForSingleObject(pi.hProcess, INFINITE);
-
-    // Close handles
-    CloseHandle(pi.hProcess);
-    CloseHandle(pi.hThread);
-
     return 1;
 }
 
-// ============================ WIN32 API IMPLEMENTATION ============================
-void WINAPI ServiceCtrlHandler(DWORD control) {
-    switch (control) {
-    case SERVICE_CONTROL_STOP:
-        service_status.dwCurrentState = SERVICE_STOPPED;
-        SetServiceStatus(service_status_handle, &service_status);
-        SetEvent(stop_event);
-        break;
-    case SERVICE_CONTROL_PAUSE:
-        paused = 1;
-        service_status.dwCurrentState = SERVICE_PAUSED;
-        SetServiceStatus(service_status_handle, &service_status);
-        break;
-    case SERVICE_CONTROL_CONTINUE:
-        paused = 0;
-        service_status.dwCurrentState = SERVICE_RUNNING;
-        SetServiceStatus(service_status_handle, &service_status);
-        break;
-    case 128: // custom reload
-        load_jobs();
-        break;
-    default:
-        break;
+int __filename(char *buffer, size_t length) {
+    if (wcron_executable_path(buffer, length) != 0) {
+        return 0;
     }
-}
 
-void WINAPI ServiceMain(DWORD dwArgc, LPTSTR *lpszArgv) {
-    (void)dwArgc;
-    (void)lpszArgv;
-
-    service_status_handle = RegisterServiceCtrlHandler(WCRON_SERVICE_NAME, ServiceCtrlHandler);
-    if (!service_status_handle) {
-        printf("Failed to register service control handler: %lu\n", GetLastError());
-        return;
+    // Find last separator to get filename
+    char *last_slash = strrchr(buffer, DIRECTORY_SEPARATOR_CHAR);
+    if (last_slash) {
+        char *filename = last_slash + 1;
+        memmove(buffer, filename, strlen(filename) + 1);
     }
 
-    service_status.dwServiceType = SERVICE_WIN32_OWN_PROCESS;
-    service_status.dwCurrentState = SERVICE_START_PENDING;
-    service_status.dwControlsAccepted = SERVICE_ACCEPT_STOP | SERVICE_ACCEPT_PAUSE_CONTINUE;
-    service_status.dwWin32ExitCode = 0;
-    service_status.dwServiceSpecificExitCode = 0;
-    service_status.dwCheckPoint = 0;
-    service_status.dwWaitHint = 0;
-
-    SetServiceStatus(service_status_handle, &service_status);
-
-    load_jobs();
-    init_job_system();
-
-    stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
-    _beginthread(scheduler_thread, 0, NULL);
-
-    service_status.dwCurrentState = SERVICE_RUNNING;
-    SetServiceStatus(service_status_handle, &service_status);
-
-    log_msg("Cron service started successfully");
-    WaitForSingleObject(stop_event, INFINITE);
-    log_msg("Cron service stopping");
-    shutdown_job_system();
-
-    CloseHandle(stop_event);
+    return 1;
 }
 
-void InstallService() {
-    SC_HANDLE scm = OpenSCManager(NULL, NULL, SC_MANAGER_CREATE_SERVICE);
-    if (!scm) {
-        printf("Failed to open service manager: %lu\n", GetLastError());
-        return;
-    }
-
-    char exe_path[MAX_PATH];
-    DWORD len = GetModuleFileName(NULL, exe_path, MAX_PATH);
-    if (len == 0) {
-        printf("Failed to get module path: %lu\n", GetLastError());
-        CloseServiceHandle(scm);
-        return;
-    }
-
-    char exec_path[WCRON_PATH_MAX_SIZE];
-    int result = snprintf(exec_path, sizeof(exec_path), "\"%s\" service", exe_path);
-    if (result >= (int)sizeof(exec_path) || result < 0) {
-        printf("Failed to construct executable path: buffer too small\n");
-        CloseServiceHandle(scm);
-        return;
-    }
-
-    SC_HANDLE service =
-        CreateService(scm, WCRON_SERVICE_NAME, "Cron Service", SERVICE_ALL_ACCESS, SERVICE_WIN32_OWN_PROCESS,
-                      SERVICE_DEMAND_START, SERVICE_ERROR_NORMAL, exec_path, NULL, NULL, NULL, NULL, NULL);
-    if (!service) {
-        printf("Failed to install service: %ld\n", GetLastError());
-    } else {
-        printf("Service installed successfully.\n");
-    }
-
-    CloseServiceHandle(scm);
+int get_crontab_path(char *buffer, size_t size) {
+    char dir[WCRON_PATH_MAX_SIZE];
+    if (!__dirname(dir, sizeof(dir)))
+        return 0;
+    int res = snprintf(buffer, size, "%s%s%s", dir, DIRECTORY_SEPARATOR, "crontab.txt");
+    return (res > 0 && res < (int)size);
 }
 
-void UninstallService() {
-    SC_HANDLE scm = OpenSCManager(NULL, NULL, SC_MANAGER_ALL_ACCESS);
-    if (!scm) {
-        printf("Failed to open service manager: %lu\n", GetLastError());
-        return;
-    }
+int get_log_path(char *buffer, size_t size) {
+    char dir[WCRON_PATH_MAX_SIZE];
+    if (!__dirname(dir, sizeof(dir)))
+        return 0;
+    int res = snprintf(buffer, size, "%s%s%s", dir, DIRECTORY_SEPARATOR, "wcron.log");
+    return (res > 0 && res < (int)size);
+}
 
-    SC_HANDLE service = OpenService(scm, WCRON_SERVICE_NAME, DELETE);
-    if (service) {
-        DeleteService(service);
-        CloseServiceHandle(service);
-    }
-    CloseServiceHandle(scm);
+int get_journal_path(char *buffer, size_t size) {
+    char dir[WCRON_PATH_MAX_SIZE];
+    if (!__dirname(dir, sizeof(dir)))
+        return 0;
+    int res = snprintf(buffer, size, "%s%s%s", dir, DIRECTORY_SEPARATOR, "wcron.journal");
+    return (res > 0 && res < (int)size);
 }
 
-void StartCronService() {
-    SC_HANDLE scm = OpenSCManager(NULL, NULL, SC_MANAGER_ALL_ACCESS);
-    if (!scm) {
-        printf("Failed to open service manager: %lu\n", GetLastError());
-        return;
-    }
+int get_metrics_dir(char *buffer, size_t size) {
+    char dir[WCRON_PATH_MAX_SIZE];
+    if (!__dirname(dir, sizeof(dir)))
+        return 0;
+    int res = snprintf(buffer, size, "%s%s%s", dir, DIRECTORY_SEPARATOR, "metrics");
+    return (res > 0 && res < (int)size);
+}
 
-    SC_HANDLE service = OpenService(scm, WCRON_SERVICE_NAME, SERVICE_START);
-    if (service) {
-        if (!StartService(service, 0, NULL)) {
-            printf("Failed to start service: %lu\n", GetLastError());
-        } else {
-            printf("Service started successfully.\n");
-        }
-        CloseHandle(service);
-    } else {
-        printf("Failed to open service: %lu\n", GetLastError());
-    }
-    CloseServiceHandle(scm);
+int get_control_path(char *buffer, size_t size) {
+    char dir[WCRON_PATH_MAX_SIZE];
+    if (!__dirname(dir, sizeof(dir)))
+        return 0;
+    int res = snprintf(buffer, size, "%s%s%s", dir, DIRECTORY_SEPARATOR, "wcron.sock");
+    return (res > 0 && res < (int)size);
 }
 
-void StopCronService() {
-    SC_HANDLE scm = OpenSCManager(NULL, NULL, SC_MANAGER_ALL_ACCESS);
-    if (!scm) {
-        printf("Failed to open service manager: %lu\n", GetLastError());
-        return;
-    }
+int get_status_path(char *buffer, size_t size) {
+    char dir[WCRON_PATH_MAX_SIZE];
+    if (!__dirname(dir, sizeof(dir)))
+        return 0;
+    int res = snprintf(buffer, size, "%s%s%s", dir, DIRECTORY_SEPARATOR, "wcron.status");
+    return (res > 0 && res < (int)size);
+}
 
-    SC_HANDLE service = OpenService(scm, WCRON_SERVICE_NAME, SERVICE_STOP);
-    if (service) {
-        SERVICE_STATUS status;
-        ControlService(service, SERVICE_CONTROL_STOP, &status);
-        CloseServiceHandle(service);
-    }
-    CloseServiceHandle(scm);
+int get_output_dir(char *buffer, size_t size) {
+    char dir[WCRON_PATH_MAX_SIZE];
+    if (!__dirname(dir, sizeof(dir)))
+        return 0;
+    int res = snprintf(buffer, size, "%s%s%s", dir, DIRECTORY_SEPARATOR, "output");
+    return (res > 0 && res < (int)size);
 }
 
-void PauseCronService() {
-    SC_HANDLE scm = OpenSCManager(NULL, NULL, SC_MANAGER_ALL_ACCESS);
-    if (!scm) {
-        printf("Failed to open service manager: %lu\n", GetLastError());
+void load_jobs() {
+    char crontab_path[WCRON_PATH_MAX_SIZE];
+    if (!get_crontab_path(crontab_path, sizeof(crontab_path))) {
+        perror("Failed to get crontab path");
         return;
     }
 
-    SC_HANDLE service = OpenService(scm, WCRON_SERVICE_NAME, SERVICE_PAUSE_CONTINUE);
-    if (service) {
-        SERVICE_STATUS status;
-        ControlService(service, SERVICE_CONTROL_PAUSE, &status);
-        CloseServiceHandle(service);
-    }
-    CloseServiceHandle(scm);
-}
-
-void ResumeCronService() {
-    SC_HANDLE scm = OpenSCManager(NULL, NULL, SC_MANAGER_ALL_ACCESS);
-    if (!scm) {
-        printf("Failed to open service manager: %lu\n", GetLastError());
+    job_table *table = job_table_load(crontab_path, NULL);
+    if (!table) {
+        log_msg("Failed to load crontab, keeping current jobs");
         return;
     }
 
-    SC_HANDLE service = OpenService(scm, WCRON_SERVICE_NAME, SERVICE_PAUSE_CONTINUE);
-    if (service) {
-        SERVICE_STATUS status;
-        ControlService(service, SERVICE_CONTROL_CONTINUE, &status);
-        CloseServiceHandle(service);
-    }
+    char msg[64];
+    snprintf(msg, sizeof(msg), "Loaded %d jobs from crontab", table->count);
+    log_msg(msg);
 
-    CloseServiceHandle(scm);
+    replace_job_table(table);
 }
 
-void ReloadCronService() {
-    SC_HANDLE scm = OpenSCManager(NULL, NULL, SC_MANAGER_ALL_ACCESS);
-    if (!scm) {
-        printf("Failed to open service manager: %lu\n", GetLastError());
-        return;
+/**
+ * Create a crontab file with the default template
+ * @param path Path of the file to create
+ * @return 1 if created successfully, 0 otherwise
+ */
+int create_default_crontab(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        return 0;
     }
 
-    SC_HANDLE service = OpenService(scm, WCRON_SERVICE_NAME, SERVICE_USER_DEFINED_CONTROL);
-    if (service) {
-        SERVICE_STATUS status;
-        ControlService(service, 128, &status); // custom code
-        CloseServiceHandle(service);
-    }
-    CloseServiceHandle(scm);
+    fputs(DEFAULT_CRONTAB_TEMPLATE, fp);
+    fclose(fp);
+    return 1;
 }
@@ -0,0 +1,319 @@
+#ifndef _WIN32
+
+#include "wcron/control.h"
+#include "wcron/journal.h"
+#include "wcron/metrics.h"
+#include "wcron/output.h"
+#include "wcron/platform.h"
+#include "wcron/runner.h"
+#include "wcron/service.h"
+#include "wcron/status.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+static int get_pidfile_path(char *buffer, size_t size) {
+    char dir[WCRON_PATH_MAX_SIZE];
+    if (!__dirname(dir, sizeof(dir)))
+        return 0;
+    int res = snprintf(buffer, size, "%s%s%s", dir, DIRECTORY_SEPARATOR, "wcron.pid");
+    return (res > 0 && res < (int)size);
+}
+
+static void write_pidfile(void) {
+    char path[WCRON_PATH_MAX_SIZE];
+    if (!get_pidfile_path(path, sizeof(path))) {
+        return;
+    }
+
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        log_msg("Failed to write pid file");
+        return;
+    }
+    fprintf(fp, "%ld\n", (long)getpid());
+    fclose(fp);
+}
+
+static void remove_pidfile(void) {
+    char path[WCRON_PATH_MAX_SIZE];
+    if (get_pidfile_path(path, sizeof(path))) {
+        unlink(path);
+    }
+}
+
+// Pid of the running daemon, or 0 if none
+static pid_t read_service_pid(void) {
+    char path[WCRON_PATH_MAX_SIZE];
+    if (!get_pidfile_path(path, sizeof(path))) {
+        return 0;
+    }
+
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return 0;
+    }
+
+    long pid = 0;
+    if (fscanf(fp, "%ld", &pid) != 1) {
+        pid = 0;
+    }
+    fclose(fp);
+
+    if (pid <= 0 || kill((pid_t)pid, 0) != 0) {
+        return 0;
+    }
+    return (pid_t)pid;
+}
+
+static void signal_service(int signo, const char *done_msg) {
+    pid_t pid = read_service_pid();
+    if (!pid) {
+        printf("Service is not running.\n");
+        return;
+    }
+
+    if (kill(pid, signo) != 0) {
+        printf("Failed to signal service (pid %ld): %s\n", (long)pid, strerror(errno));
+        return;
+    }
+    printf("%s\n", done_msg);
+}
+
+/**
+ * Ask the daemon through its control socket, which reports the outcome; a
+ * daemon without one gets the signal instead.
+ */
+static void control_service(const char *request, int signo, const char *done_msg) {
+    char path[WCRON_PATH_MAX_SIZE];
+    if (get_control_path(path, sizeof(path)) && control_request(path, request) >= 0) {
+        return;
+    }
+    signal_service(signo, done_msg);
+}
+
+/**
+ * Open the editor with safe path validation
+ * @param crontab_path Path of the crontab file
+ * @return 1 if opened successfully, 0 otherwise
+ */
+int open_editor_safely(const char *crontab_path) {
+    const char *editor = getenv("VISUAL");
+    if (!editor || !*editor) {
+        editor = getenv("EDITOR");
+    }
+    if (!editor || !*editor) {
+        editor = "vi";
+    }
+
+    // The path is passed as $1, never interpolated into the shell command
+    char cmd[WCRON_PATH_MAX_SIZE];
+    int r = snprintf(cmd, sizeof(cmd), "%s \"$1\"", editor);
+    if (r <= 0 || r >= (int)sizeof(cmd)) {
+        fprintf(stderr, "Error: Editor command too long\n");
+        return 0;
+    }
+
+    char *argv[] = {"/bin/sh", "-c", cmd, "sh", (char *)crontab_path, NULL};
+    pid_t pid;
+    if (posix_spawn(&pid, "/bin/sh", NULL, NULL, argv, environ) != 0) {
+        fprintf(stderr, "Failed to open editor '%s'\n", editor);
+        return 0;
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+
+    return 1;
+}
+
+// Control signals arrive on the scheduler loop through the signalfd
+static void on_control_signal(wcron_handle sfd, void *arg) {
+    (void)arg;
+    struct signalfd_siginfo si;
+
+    while (read(sfd, &si, sizeof(si)) == (ssize_t)sizeof(si)) {
+        switch (si.ssi_signo) {
+        case SIGTERM:
+        case SIGINT:
+            wcron_event_set(stop_event);
+            break;
+        case SIGHUP:
+            scheduler_request_reload();
+            break;
+        case SIGUSR1:
+            scheduler_pause(1);
+            break;
+        case SIGUSR2:
+            scheduler_pause(0);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+int run_service(void) {
+    // Control requests arrive as signals, read synchronously through a signalfd
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGHUP);
+    sigaddset(&mask, SIGUSR1);
+    sigaddset(&mask, SIGUSR2);
+
+    // Block before any thread starts so every thread inherits the mask. SIGCHLD too: where job processes have no
+    // pidfd, the scheduler learns of their exit from a signalfd of its own
+    sigset_t blocked = mask;
+    sigaddset(&blocked, SIGCHLD);
+    if (pthread_sigmask(SIG_BLOCK, &blocked, NULL) != 0) {
+        fprintf(stderr, "Failed to block control signals\n");
+        return 1;
+    }
+
+    int sfd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (sfd < 0) {
+        fprintf(stderr, "Failed to create signalfd: %s\n", strerror(errno));
+        return 1;
+    }
+
+    if (wcron_event_create(&stop_event) != 0) {
+        fprintf(stderr, "Failed to create stop event\n");
+        close(sfd);
+        return 1;
+    }
+
+    log_config config;
+    log_config_defaults(&config);
+    if (log_start(&config) != 0) {
+        fprintf(stderr, "Failed to start log writer, logging synchronously\n");
+    }
+
+    char journal_path[WCRON_PATH_MAX_SIZE];
+    if (get_journal_path(journal_path, sizeof(journal_path))) {
+        journal_open(journal_path);
+    }
+
+    char output_dir[WCRON_PATH_MAX_SIZE];
+    if (get_output_dir(output_dir, sizeof(output_dir))) {
+        output_init(output_dir);
+    }
+
+    char metrics_dir[WCRON_PATH_MAX_SIZE];
+    if (get_metrics_dir(metrics_dir, sizeof(metrics_dir))) {
+        metrics_start(metrics_dir);
+    }
+
+    char status_path[WCRON_PATH_MAX_SIZE];
+    if (get_status_path(status_path, sizeof(status_path))) {
+        status_open(status_path);
+    }
+
+    write_pidfile();
+    init_job_system();
+    load_jobs();
+
+    if (scheduler_watch(sfd, on_control_signal, NULL) != 0) {
+        log_msg("Failed to watch control signals");
+    }
+
+    char control_path[WCRON_PATH_MAX_SIZE];
+    if (get_control_path(control_path, sizeof(control_path))) {
+        control_start(control_path);
+    }
+
+    log_msg("Cron service started successfully");
+
+    // The scheduler loop runs on the main thread and returns once stop_event is set
+    scheduler_thread(NULL);
+
+    log_msg("Cron service stopping");
+    control_stop();
+    scheduler_unwatch(sfd);
+    shutdown_job_system();
+
+    wcron_event_destroy(stop_event);
+    close(sfd);
+    remove_pidfile();
+    status_close();
+    metrics_stop();
+    output_shutdown();
+    journal_close();
+    log_stop();
+    return 0;
+}
+
+void InstallService() {
+    printf("No service manager registration is needed on this platform.\n");
+    printf("Use 'wcrontab start' to run the daemon, or run 'wcrontab service' from a systemd unit.\n");
+}
+
+void UninstallService() {
+    printf("No service manager registration to remove on this platform.\n");
+}
+
+void StartCronService() {
+    pid_t running = read_service_pid();
+    if (running) {
+        printf("Service already running (pid %ld).\n", (long)running);
+        return;
+    }
+
+    char exe_path[WCRON_PATH_MAX_SIZE];
+    if (wcron_executable_path(exe_path, sizeof(exe_path)) != 0) {
+        printf("Failed to get executable path\n");
+        return;
+    }
+
+    // Detach into a new session with stdio on /dev/null
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID);
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    char *argv[] = {exe_path, "service", NULL};
+    pid_t pid;
+    int r = posix_spawn(&pid, exe_path, &actions, &attr, argv, environ);
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    if (r != 0) {
+        printf("Failed to start service: %s\n", strerror(r));
+    } else {
+        printf("Service started successfully (pid %ld).\n", (long)pid);
+    }
+}
+
+void StopCronService() {
+    signal_service(SIGTERM, "Service stop requested.");
+}
+
+void PauseCronService() {
+    control_service("pause", SIGUSR1, "Service paused.");
+}
+
+void ResumeCronService() {
+    control_service("resume", SIGUSR2, "Service resumed.");
+}
+
+void ReloadCronService() {
+    control_service("reload", SIGHUP, "Reload requested.");
+}
+
+#endif // _WIN32
@@ -0,0 +1,314 @@
+#ifdef _WIN32
+
+#include "wcron/journal.h"
+#include "wcron/metrics.h"
+#include "wcron/output.h"
+#include "wcron/runner.h"
+#include "wcron/service.h"
+#include "wcron/status.h"
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+static SERVICE_STATUS service_status;
+static SERVICE_STATUS_HANDLE service_status_handle;
+
+/**
+ * Open the editor with safe path validation
+ * @param crontab_path Path of the crontab file
+ * @return 1 if opened successfully, 0 otherwise
+ */
+int open_editor_safely(const char *crontab_path) {
+    // Review path for invalid characters
+    if (strchr(crontab_path, '\"') != NULL || strchr(crontab_path, '&') != NULL) {
+        fprintf(stderr, "Error: Invalid characters in crontab path\n");
+        return 0;
+    }
+
+    // Use CreateProcess for greater security
+    STARTUPINFO si;
+    PROCESS_INFORMATION pi;
+
+    ZeroMemory(&si, sizeof(si));
+    si.cb = sizeof(si);
+    ZeroMemory(&pi, sizeof(pi));
+
+    // Build command safely
+    char cmd[MAX_PATH * 2];
+    snprintf(cmd, sizeof(cmd), "notepad.exe \"%s\"", crontab_path);
+
+    // Create process
+    if (!CreateProcess(NULL,  // No module name (use command line)
+                       cmd,   // Command line
+                       NULL,  // Process handle not inheritable
+                       NULL,  // Thread handle not inheritable
+                       FALSE, // Set handle inheritance to FALSE
+                       0,     // No creation flags
+                       NULL,  // Use parent's environment block
+                       NULL,  // Use parent's starting directory
+                       &si,   // Pointer to STARTUPINFO structure
+                       &pi)   // Pointer to PROCESS_INFORMATION structure
+    ) {
+        fprintf(stderr, "Failed to open editor (error %lu)\n", GetLastError());
+        return 0;
+    }
+
+    // Wait for the editor to close
+    WaitForSingleObject(pi.hProcess, INFINITE);
+
+    // Close handles
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+
+    return 1;
+}
+
+static void WINAPI ServiceCtrlHandler(DWORD control) {
+    switch (control) {
+    case SERVICE_CONTROL_STOP:
+        service_status.dwCurrentState = SERVICE_STOPPED;
+        SetServiceStatus(service_status_handle, &service_status);
+        wcron_event_set(stop_event);
+        break;
+    case SERVICE_CONTROL_PAUSE:
+        scheduler_pause(1);
+        service_status.dwCurrentState = SERVICE_PAUSED;
+        SetServiceStatus(service_status_handle, &service_status);
+        break;
+    case SERVICE_CONTROL_CONTINUE:
+        scheduler_pause(0);
+        service_status.dwCurrentState = SERVICE_RUNNING;
+        SetServiceStatus(service_status_handle, &service_status);
+        break;
+    case 128: // custom reload
+        scheduler_request_reload();
+        break;
+    default:
+        break;
+    }
+}
+
+// The ServiceMain function is responsible for initializing the service and handling service control requests.
+static void WINAPI ServiceMain(DWORD dwArgc, LPTSTR *lpszArgv) {
+    (void)dwArgc;
+    (void)lpszArgv;
+
+    service_status_handle = RegisterServiceCtrlHandler(WCRON_SERVICE_NAME, ServiceCtrlHandler);
+    if (!service_status_handle) {
+        printf("Failed to register service control handler: %lu\n", GetLastError());
+        return;
+    }
+
+    service_status.dwServiceType = SERVICE_WIN32_OWN_PROCESS;
+    service_status.dwCurrentState = SERVICE_START_PENDING;
+    service_status.dwControlsAccepted = SERVICE_ACCEPT_STOP | SERVICE_ACCEPT_PAUSE_CONTINUE;
+    service_status.dwWin32ExitCode = 0;
+    service_status.dwServiceSpecificExitCode = 0;
+    service_status.dwCheckPoint = 0;
+    service_status.dwWaitHint = 0;
+
+    SetServiceStatus(service_status_handle, &service_status);
+
+    log_config config;
+    log_config_defaults(&config);
+    log_start(&config);
+
+    char journal_path[WCRON_PATH_MAX_SIZE];
+    if (get_journal_path(journal_path, sizeof(journal_path))) {
+        journal_open(journal_path);
+    }
+
+    char output_dir[WCRON_PATH_MAX_SIZE];
+    if (get_output_dir(output_dir, sizeof(output_dir))) {
+        output_init(output_dir);
+    }
+
+    char metrics_dir[WCRON_PATH_MAX_SIZE];
+    if (get_metrics_dir(metrics_dir, sizeof(metrics_dir))) {
+        metrics_start(metrics_dir);
+    }
+
+    char status_path[WCRON_PATH_MAX_SIZE];
+    if (get_status_path(status_path, sizeof(status_path))) {
+        status_open(status_path);
+    }
+
+    wcron_event_create(&stop_event);
+    init_job_system();
+    load_jobs();
+
+    wcron_thread scheduler;
+    if (wcron_thread_start(&scheduler, scheduler_thread, NULL) != 0) {
+        log_msg("Failed to start scheduler thread");
+        wcron_event_destroy(stop_event);
+        status_close();
+        metrics_stop();
+        output_shutdown();
+        journal_close();
+        log_stop();
+        return;
+    }
+
+    service_status.dwCurrentState = SERVICE_RUNNING;
+    SetServiceStatus(service_status_handle, &service_status);
+
+    log_msg("Cron service started successfully");
+    wcron_thread_join(scheduler);
+    log_msg("Cron service stopping");
+    shutdown_job_system();
+
+    wcron_event_destroy(stop_event);
+    status_close();
+    metrics_stop();
+    output_shutdown();
+    journal_close();
+    log_stop();
+}
+
+int run_service(void) {
+    SERVICE_TABLE_ENTRY st[] = {{WCRON_SERVICE_NAME, ServiceMain}, {NULL, NULL}};
+    if (!StartServiceCtrlDispatcher(st)) {
+        fprintf(stderr, "Failed to start service (error %lu)\n", GetLastError());
+        return 1;
+    }
+
+    return 0;
+}
+
+void InstallService() {
+    SC_HANDLE scm = OpenSCManager(NULL, NULL, SC_MANAGER_CREATE_SERVICE);
+    if (!scm) {
+        printf("Failed to open service manager: %lu\n", GetLastError());
+        return;
+    }
+
+    char exe_path[MAX_PATH];
+    DWORD len = GetModuleFileName(NULL, exe_path, MAX_PATH);
+    if (len == 0) {
+        printf("Failed to get module path: %lu\n", GetLastError());
+        CloseServiceHandle(scm);
+        return;
+    }
+
+    char exec_path[WCRON_PATH_MAX_SIZE];
+    int result = snprintf(exec_path, sizeof(exec_path), "\"%s\" service", exe_path);
+    if (result >= (int)sizeof(exec_path) || result < 0) {
+        printf("Failed to construct executable path: buffer too small\n");
+        CloseServiceHandle(scm);
+        return;
+    }
+
+    SC_HANDLE service =
+        CreateService(scm, WCRON_SERVICE_NAME, "Cron Service", SERVICE_ALL_ACCESS, SERVICE_WIN32_OWN_PROCESS,
+                      SERVICE_DEMAND_START, SERVICE_ERROR_NORMAL, exec_path, NULL, NULL, NULL, NULL, NULL);
+    if (!service) {
+        printf("Failed to install service: %ld\n", GetLastError());
+    } else {
+        printf("Service installed successfully.\n");
+    }
+
+    CloseServiceHandle(scm);
+}
+
+void UninstallService() {
+    SC_HANDLE scm = OpenSCManager(NULL, NULL, SC_MANAGER_ALL_ACCESS);
+    if (!scm) {
+        printf("Failed to open service manager: %lu\n", GetLastError());
+        return;
+    }
+
+    SC_HANDLE service = OpenService(scm, WCRON_SERVICE_NAME, DELETE);
+    if (service) {
+        DeleteService(service);
+        CloseServiceHandle(service);
+    }
+    CloseServiceHandle(scm);
+}
+
+void StartCronService() {
+    SC_HANDLE scm = OpenSCManager(NULL, NULL, SC_MANAGER_ALL_ACCESS);
+    if (!scm) {
+        printf("Failed to open service manager: %lu\n", GetLastError());
+        return;
+    }
+
+    SC_HANDLE service = OpenService(scm, WCRON_SERVICE_NAME, SERVICE_START);
+    if (service) {
+        if (!StartService(service, 0, NULL)) {
+            printf("Failed to start service: %lu\n", GetLastError());
+        } else {
+            printf("Service started successfully.\n");
+        }
+        CloseHandle(service);
+    } else {
+        printf("Failed to open service: %lu\n", GetLastError());
+    }
+    CloseServiceHandle(scm);
+}
+
+void StopCronService() {
+    SC_HANDLE scm = OpenSCManager(NULL, NULL, SC_MANAGER_ALL_ACCESS);
+    if (!scm) {
+        printf("Failed to open service manager: %lu\n", GetLastError());
+        return;
+    }
+
+    SC_HANDLE service = OpenService(scm, WCRON_SERVICE_NAME, SERVICE_STOP);
+    if (service) {
+        SERVICE_STATUS status;
+        ControlService(service, SERVICE_CONTROL_STOP, &status);
+        CloseServiceHandle(service);
+    }
+    CloseServiceHandle(scm);
+}
+
+void PauseCronService() {
+    SC_HANDLE scm = OpenSCManager(NULL, NULL, SC_MANAGER_ALL_ACCESS);
+    if (!scm) {
+        printf("Failed to open service manager: %lu\n", GetLastError());
+        return;
+    }
+
+    SC_HANDLE service = OpenService(scm, WCRON_SERVICE_NAME, SERVICE_PAUSE_CONTINUE);
+    if (service) {
+        SERVICE_STATUS status;
+        ControlService(service, SERVICE_CONTROL_PAUSE, &status);
+        CloseServiceHandle(service);
+    }
+    CloseServiceHandle(scm);
+}
+
+void ResumeCronService() {
+    SC_HANDLE scm = OpenSCManager(NULL, NULL, SC_MANAGER_ALL_ACCESS);
+    if (!scm) {
+        printf("Failed to open service manager: %lu\n", GetLastError());
+        return;
+    }
+
+    SC_HANDLE service = OpenService(scm, WCRON_SERVICE_NAME, SERVICE_PAUSE_CONTINUE);
+    if (service) {
+        SERVICE_STATUS status;
+        ControlService(service, SERVICE_CONTROL_CONTINUE, &status);
+        CloseServiceHandle(service);
+    }
+
+    CloseServiceHandle(scm);
+}
+
+void ReloadCronService() {
+    SC_HANDLE scm = OpenSCManager(NULL, NULL, SC_MANAGER_ALL_ACCESS);
+    if (!scm) {
+        printf("Failed to open service manager: %lu\n", GetLastError());
+        return;
+    }
+
+    SC_HANDLE service = OpenService(scm, WCRON_SERVICE_NAME, SERVICE_USER_DEFINED_CONTROL);
+    if (service) {
+        SERVICE_STATUS status;
+        ControlService(service, 128, &status); // custom code
+        CloseServiceHandle(service);
+    }
+    CloseServiceHandle(scm);
+}
+
+#endif // _WIN32
@@ -0,0 +1,260 @@
+#include "wcron/simulate.h"
+#include "wcron/jobtable.h"
+#include "wcron/parser.h"
+#include "wcron/platform.h"
+#include "wcron/runner.h"
+#include "wcron/service.h"
+#include "wcron/tz.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_MAX_SUSPENDS 16
+
+typedef struct {
+    time_t from;
+    time_t until;
+} sim_window;
+
+typedef struct {
+    int64_t end_ms;
+    struct job_run *run;
+} sim_run;
+
+typedef struct {
+    time_t from;
+    time_t to;
+    unsigned run_seconds;
+    int quiet;
+    sim_window suspends[SIM_MAX_SUSPENDS];
+    int suspend_count;
+
+    // Runs going, in the order they end: all last run_seconds
+    sim_run *running;
+    size_t first;
+    size_t count;
+    size_t capacity;
+    int out_of_memory;
+
+    uint64_t runs;
+    uint64_t catch_up_runs;
+    uint64_t ticks;
+    uint64_t tick_us;
+    uint64_t tick_max_us;
+} simulation;
+
+// The virtual clock
+static int64_t now_ms;
+
+static int64_t virtual_clock(void) {
+    return now_ms;
+}
+
+static void format_time(time_t t, const char *format, char *buffer, size_t size) {
+    struct tm tm;
+    tz_localtime(t, &tm);
+    strftime(buffer, size, format, &tm);
+}
+
+static int push_running(simulation *sim, struct job_run *run) {
+    if (sim->first + sim->count == sim->capacity) {
+        if (sim->first > 0) {
+            memmove(sim->running, sim->running + sim->first, sim->count * sizeof(sim_run));
+            sim->first = 0;
+        } else {
+            size_t capacity = sim->capacity ? sim->capacity * 2 : 64;
+            sim_run *grown = realloc(sim->running, capacity * sizeof(sim_run));
+            if (!grown) {
+                return -1;
+            }
+            sim->running = grown;
+            sim->capacity = capacity;
+        }
+    }
+    sim->running[sim->first + sim->count].end_ms = now_ms + (int64_t)sim->run_seconds * 1000;
+    sim->running[sim->first + sim->count].run = run;
+    sim->count++;
+    return 0;
+}
+
+// Stub spawner: print the start and let the run end run_seconds later
+static void on_spawn(struct job_run *run, const scheduler_run_info *info, void *arg) {
+    simulation *sim = (simulation *)arg;
+    sim->runs++;
+    if (info->catch_up) {
+        sim->catch_up_runs++;
+    }
+
+    if (!sim->quiet) {
+        char start[32], scheduled[32];
+        format_time((time_t)(now_ms / 1000), "%Y-%m-%d %H:%M:%S", start, sizeof(start));
+        format_time(info->scheduled, "%Y-%m-%d %H:%M", scheduled, sizeof(scheduled));
+        printf("%s #%d %s %s %s\n", start, info->job, info->catch_up ? "catch-up" : "scheduled", scheduled,
+               info->command);
+    }
+
+    if (push_running(sim, run) != 0) {
+        sim->out_of_memory = 1; // the job stays running; the simulation stops after this tick
+    }
+}
+
+// When a tick due at `at` happens: deadlines inside a suspend window wait for its end
+static int64_t wake_time(const simulation *sim, int64_t at) {
+    int moved = 1;
+    while (moved) {
+        moved = 0;
+        for (int i = 0; i < sim->suspend_count; i++) {
+            if (at >= (int64_t)sim->suspends[i].from * 1000 && at < (int64_t)sim->suspends[i].until * 1000) {
+                at = (int64_t)sim->suspends[i].until * 1000;
+                moved = 1;
+            }
+        }
+    }
+    return at;
+}
+
+/**
+ * Drive the scheduler from sim->from to sim->to: end the runs and fire the
+ * deadlines in time order, a run ending at a deadline first since its job may
+ * fire again then.
+ */
+static void run_simulation(simulation *sim) {
+    int64_t end_ms = (int64_t)sim->to * 1000;
+
+    while (!sim->out_of_memory) {
+        time_t deadline = scheduler_next_deadline();
+        int64_t at = INT64_MAX;
+        if (deadline != CRON_NEVER) {
+            at = wake_time(sim, (int64_t)deadline * 1000);
+            at = at < now_ms ? now_ms : at;
+            at = at > end_ms ? INT64_MAX : at;
+        }
+
+        if (sim->count > 0 && sim->running[sim->first].end_ms <= at && sim->running[sim->first].end_ms <= end_ms) {
+            sim_run done = sim->running[sim->first++];
+            sim->count--;
+            if (done.end_ms > now_ms) {
+                now_ms = done.end_ms;
+            }
+            scheduler_sim_finish(done.run, 0);
+            continue;
+        }
+        if (at == INT64_MAX) {
+            break;
+        }
+
+        now_ms = at;
+        uint64_t tick_us = wcron_monotonic_us();
+        scheduler_sim_tick();
+        tick_us = wcron_monotonic_us() - tick_us;
+        sim->ticks++;
+        sim->tick_us += tick_us;
+        sim->tick_max_us = tick_us > sim->tick_max_us ? tick_us : sim->tick_max_us;
+    }
+}
+
+static void print_usage(void) {
+    printf("Usage: wcrontab simulate --from TIME --to TIME [--crontab FILE] [--run-time SECONDS]\n"
+           "                         [--suspend FROM UNTIL]... [--quiet]\n");
+}
+
+static int parse_time_option(const char *name, const char *value, time_t *t) {
+    if (!parse_local_time(value, t)) {
+        fprintf(stderr, "Error: Invalid %s value '%s'\n", name, value);
+        return 0;
+    }
+    return 1;
+}
+
+int simulate_command(int argc, char *argv[]) {
+    static simulation sim;
+    char crontab_path[WCRON_PATH_MAX_SIZE] = "";
+    int have_from = 0, have_to = 0;
+
+    for (int i = 0; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--quiet") == 0) {
+            sim.quiet = 1;
+        } else if (strcmp(argv[i], "--from") == 0 && value) {
+            if (!parse_time_option("--from", value, &sim.from)) {
+                return 1;
+            }
+            have_from = 1;
+            i++;
+        } else if (strcmp(argv[i], "--to") == 0 && value) {
+            if (!parse_time_option("--to", value, &sim.to)) {
+                return 1;
+            }
+            have_to = 1;
+            i++;
+        } else if (strcmp(argv[i], "--crontab") == 0 && value) {
+            snprintf(crontab_path, sizeof(crontab_path), "%s", value);
+            i++;
+        } else if (strcmp(argv[i], "--run-time") == 0 && value) {
+            sim.run_seconds = (unsigned)strtoul(value, NULL, 10);
+            i++;
+        } else if (strcmp(argv[i], "--suspend") == 0 && value && i + 2 < argc) {
+            if (sim.suspend_count == SIM_MAX_SUSPENDS) {
+                fprintf(stderr, "Error: At most %d --suspend spans\n", SIM_MAX_SUSPENDS);
+                return 1;
+            }
+            sim_window *window = &sim.suspends[sim.suspend_count++];
+            if (!parse_time_option("--suspend", value, &window->from) ||
+                !parse_time_option("--suspend", argv[i + 2], &window->until)) {
+                return 1;
+            }
+            i += 2;
+        } else {
+            fprintf(stderr, "Error: Unknown simulate option '%s'\n", argv[i]);
+            print_usage();
+            return 1;
+        }
+    }
+
+    if (!have_from || !have_to || sim.to <= sim.from) {
+        print_usage();
+        return 1;
+    }
+    if (!crontab_path[0] && !get_crontab_path(crontab_path, sizeof(crontab_path))) {
+        fprintf(stderr, "Error: Failed to get crontab path\n");
+        return 1;
+    }
+
+    // Nothing simulated belongs in the service's log
+    log_set_path("");
+
+    now_ms = (int64_t)sim.from * 1000;
+    scheduler_set_clock(virtual_clock);
+    scheduler_sim_init(on_spawn, &sim);
+
+    job_table *table = job_table_load(crontab_path, NULL);
+    if (!table) {
+        fprintf(stderr, "Error: Failed to load %s\n", crontab_path);
+        return 1;
+    }
+    int jobs = table->count;
+    int problems = table->problems;
+    replace_job_table(table);
+
+    uint64_t started_us = wcron_monotonic_us();
+    run_simulation(&sim);
+    uint64_t elapsed_us = wcron_monotonic_us() - started_us;
+    fflush(stdout);
+
+    char from[32], to[32];
+    format_time(sim.from, "%Y-%m-%d %H:%M", from, sizeof(from));
+    format_time(sim.to, "%Y-%m-%d %H:%M", to, sizeof(to));
+    fprintf(stderr, "Simulated %s to %s: %d jobs (%d lines rejected), %llu ticks, %llu runs (%llu catch-up)\n", from,
+            to, jobs, problems, (unsigned long long)sim.ticks, (unsigned long long)sim.runs,
+            (unsigned long long)sim.catch_up_runs);
+    fprintf(stderr, "Tick cost: %.2f us average, %llu us max; %.3f s in ticks, %.3f s in all\n",
+            sim.ticks ? (double)sim.tick_us / (double)sim.ticks : 0.0, (unsigned long long)sim.tick_max_us,
+            (double)sim.tick_us / 1e6, (double)elapsed_us / 1e6);
+    if (sim.out_of_memory) {
+        fprintf(stderr, "Error: Out of memory, simulation stopped early\n");
+        return 1;
+    }
+    return 0;
+}
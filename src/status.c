@@ -0,0 +1,338 @@
+#include "wcron/status.h"
+#include "wcron/log.h"
+#include "wcron/platform.h"
+#include "wcron/tz.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Records start on a cache line of their own
+#define STATUS_HEADER_SIZE 64
+#define STATUS_MIN_CAPACITY 64
+// Reader attempts before giving up on a daemon that keeps rewriting the table
+#define STATUS_READ_TRIES 1000
+
+// Writer side, scheduler thread only
+static char status_path[1024];
+static wcron_mapping mapping;
+static status_header *header;
+static status_record *records;
+
+static void write_begin(uint32_t *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(uint32_t *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+static size_t file_size(uint32_t capacity) {
+    return STATUS_HEADER_SIZE + (size_t)capacity * sizeof(status_record);
+}
+
+static int map_status(uint32_t capacity) {
+    if (wcron_map_shared(status_path, file_size(capacity), &mapping) != 0) {
+        header = NULL;
+        records = NULL;
+        return -1;
+    }
+    header = (status_header *)mapping.data;
+    records = (status_record *)((char *)mapping.data + STATUS_HEADER_SIZE);
+    return 0;
+}
+
+int status_open(const char *path) {
+    size_t len = strlen(path);
+    if (len >= sizeof(status_path)) {
+        return -1;
+    }
+    memcpy(status_path, path, len + 1);
+
+    if (map_status(STATUS_MIN_CAPACITY) != 0) {
+        char msg[1100];
+        snprintf(msg, sizeof(msg), "Cannot map job status file %s", path);
+        log_msg(msg);
+        return -1;
+    }
+
+    // A file left by an older daemon is taken over whole; its size may exceed what was asked for
+    uint32_t seq = header->magic == STATUS_MAGIC ? header->seq | 1 : 1;
+    __atomic_store_n(&header->seq, seq, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    header->magic = STATUS_MAGIC;
+    header->version = STATUS_VERSION;
+    header->header_size = STATUS_HEADER_SIZE;
+    header->record_size = sizeof(status_record);
+    header->flags = 0;
+    header->capacity = (uint32_t)((mapping.size - STATUS_HEADER_SIZE) / sizeof(status_record));
+    header->count = 0;
+    header->pid = wcron_current_pid();
+    header->started_ms = wcron_realtime_ms();
+    header->reload_ms = 0;
+    write_end(&header->seq);
+    return 0;
+}
+
+void status_close(void) {
+    if (!header) {
+        return;
+    }
+    write_begin(&header->seq);
+    header->flags |= STATUS_STOPPED;
+    write_end(&header->seq);
+    wcron_unmap_file(&mapping);
+    header = NULL;
+    records = NULL;
+}
+
+// Grow the file to hold count records. The header's seq must be odd.
+static int status_grow(uint32_t count) {
+    uint32_t capacity = header->capacity;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    wcron_unmap_file(&mapping);
+    if (map_status(capacity) != 0) {
+        log_msg("Cannot grow job status file, job status is no longer published");
+        return -1;
+    }
+    header->capacity = (uint32_t)((mapping.size - STATUS_HEADER_SIZE) / sizeof(status_record));
+    return 0;
+}
+
+void status_reload(const job_table *table, const int *map) {
+    if (!header) {
+        return;
+    }
+
+    uint32_t old_count = header->count;
+    status_record *old = map && old_count ? malloc(old_count * sizeof(status_record)) : NULL;
+    if (old) {
+        memcpy(old, records, old_count * sizeof(status_record));
+    }
+
+    write_begin(&header->seq);
+    uint32_t count = (uint32_t)table->count;
+    if (count > header->capacity && status_grow(count) != 0) {
+        free(old);
+        return; // header is gone with the mapping, readers see the odd seq of a daemon that stopped publishing
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        const cron_job *job = &table->jobs[i];
+        int from = old ? map[i] : -1;
+        status_record next;
+        if (from >= 0 && (uint32_t)from < old_count) {
+            next = old[from];
+        } else {
+            memset(&next, 0, sizeof(next));
+            next.next_fire = -1;
+        }
+
+        next.seq = records[i].seq + 2;
+        next.hash = table->hashes[i];
+        next.flags = (next.flags & STATUS_JOB_RAN) | (job->is_running ? STATUS_JOB_RUNNING : 0);
+        next.last_run = (int64_t)job->last_run;
+        next.minutes = job->minutes;
+        next.hours = job->hours;
+        next.days = job->days;
+        next.months = job->months;
+        next.daysofweek = job->daysofweek;
+        next.schedule_flags = job->flags;
+        strncpy(next.command, job->command, sizeof(next.command) - 1);
+        next.command[sizeof(next.command) - 1] = '\0';
+        records[i] = next;
+    }
+    header->count = count;
+    header->reload_ms = wcron_realtime_ms();
+    write_end(&header->seq);
+    free(old);
+}
+
+static status_record *job_record(int job) {
+    return header && job >= 0 && (uint32_t)job < header->count ? &records[job] : NULL;
+}
+
+void status_set_next(int job, time_t next) {
+    status_record *record = job_record(job);
+    // Unchanged values are not written: an idle daemon leaves the pages clean
+    if (record && record->next_fire != (int64_t)next) {
+        write_begin(&record->seq);
+        record->next_fire = (int64_t)next;
+        write_end(&record->seq);
+    }
+}
+
+void status_set_running(int job, int running) {
+    status_record *record = job_record(job);
+    if (record) {
+        write_begin(&record->seq);
+        record->flags = running ? record->flags | STATUS_JOB_RUNNING : record->flags & ~STATUS_JOB_RUNNING;
+        write_end(&record->seq);
+    }
+}
+
+void status_run_finished(int job, time_t last_run, int exit_code, int64_t start_ms, uint32_t duration_ms) {
+    status_record *record = job_record(job);
+    if (record) {
+        write_begin(&record->seq);
+        record->flags = (record->flags & ~STATUS_JOB_RUNNING) | STATUS_JOB_RAN;
+        record->last_run = (int64_t)last_run;
+        record->last_exit = exit_code;
+        record->last_start_ms = start_ms;
+        record->last_duration_ms = duration_ms;
+        write_end(&record->seq);
+    }
+}
+
+void status_set_paused(int paused) {
+    if (header) {
+        write_begin(&header->seq);
+        header->flags = paused ? header->flags | STATUS_PAUSED : header->flags & ~STATUS_PAUSED;
+        write_end(&header->seq);
+    }
+}
+
+// Seqlock read of one record; 0 when the copy is consistent
+static int read_record(const status_record *record, status_record *copy) {
+    for (int tries = 0; tries < STATUS_READ_TRIES; tries++) {
+        uint32_t seq = __atomic_load_n(&record->seq, __ATOMIC_ACQUIRE);
+        if (!(seq & 1)) {
+            memcpy(copy, record, sizeof(*copy));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&record->seq, __ATOMIC_RELAXED) == seq) {
+                return 0;
+            }
+        }
+        // A record is written in a few stores; still odd after a while means a writer died mid-update
+        if (tries >= 8) {
+            wcron_sleep_ms(1);
+        }
+    }
+    return -1;
+}
+
+/**
+ * Copy the header and every record consistently out of the mapped file
+ * @return 0 on success, -1 if the daemon kept changing the layout
+ */
+static int read_status(const wcron_mapping *map, status_header *head, status_record **out) {
+    const status_header *shared = (const status_header *)map->data;
+    const status_record *shared_records = (const status_record *)((const char *)map->data + STATUS_HEADER_SIZE);
+    uint32_t room = (uint32_t)((map->size - STATUS_HEADER_SIZE) / sizeof(status_record));
+
+    for (int tries = 0; tries < STATUS_READ_TRIES; tries++) {
+        uint32_t seq = __atomic_load_n(&shared->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            wcron_sleep_ms(1);
+            continue;
+        }
+        memcpy(head, shared, sizeof(*head));
+
+        // The daemon may have grown the file after it was mapped here
+        uint32_t count = head->count < room ? head->count : room;
+        status_record *copy = count ? malloc(count * sizeof(status_record)) : NULL;
+        if (count && !copy) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            if (read_record(&shared_records[i], &copy[i]) != 0) {
+                free(copy);
+                return -1;
+            }
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shared->seq, __ATOMIC_RELAXED) == seq) {
+            head->count = count;
+            *out = copy;
+            return 0;
+        }
+        free(copy);
+    }
+    return -1;
+}
+
+// The record's next fire time, worked out from its schedule where the daemon leaves that to readers
+static int64_t record_next_fire(const status_record *record, const status_header *head, time_t now) {
+    if (record->next_fire != STATUS_NEXT_FROM_SCHEDULE) {
+        return record->next_fire;
+    }
+    if (head->flags & STATUS_STOPPED) {
+        return -1;
+    }
+
+    cron_job job;
+    memset(&job, 0, sizeof(job));
+    job.minutes = record->minutes;
+    job.hours = record->hours;
+    job.days = record->days;
+    job.months = record->months;
+    job.daysofweek = record->daysofweek;
+    job.flags = record->schedule_flags;
+    job.kind = CRON_KIND_GENERIC;
+    time_t next = next_fire_time(&job, now);
+    return next == CRON_NEVER ? -1 : (int64_t)next;
+}
+
+static void format_ms(int64_t ms, char *buffer, size_t size) {
+    struct tm tm;
+    tz_localtime((time_t)(ms / 1000), &tm);
+    strftime(buffer, size, "%Y-%m-%d %H:%M", &tm);
+}
+
+int status_print(const char *path) {
+    wcron_mapping map;
+    if (wcron_map_file(path, &map) != 0) {
+        return -1;
+    }
+
+    const status_header *shared = (const status_header *)map.data;
+    if (map.size < STATUS_HEADER_SIZE || shared->magic != STATUS_MAGIC || shared->version != STATUS_VERSION ||
+        shared->header_size != STATUS_HEADER_SIZE || shared->record_size != sizeof(status_record)) {
+        wcron_unmap_file(&map);
+        return -1;
+    }
+
+    status_header head;
+    status_record *jobs = NULL;
+    int r = read_status(&map, &head, &jobs);
+    wcron_unmap_file(&map);
+    if (r != 0) {
+        fprintf(stderr, "Error: The job status could not be read consistently\n");
+        return -2;
+    }
+
+    char started[32], reloaded[32];
+    format_ms(head.started_ms, started, sizeof(started));
+    format_ms(head.reload_ms, reloaded, sizeof(reloaded));
+    const char *state = (head.flags & STATUS_STOPPED) ? "stopped" : (head.flags & STATUS_PAUSED) ? "paused" : "running";
+    printf("Service %s (pid %lld, started %s), %u jobs loaded %s\n", state, (long long)head.pid, started, head.count,
+           reloaded);
+    if (head.flags & STATUS_STOPPED) {
+        printf("Jobs as they were when the service stopped:\n");
+    }
+    printf("%-6s %-8s %-16s %5s %11s  %-16s  %s\n", "JOB", "STATE", "LAST START", "EXIT", "DURATION", "NEXT FIRE",
+           "COMMAND");
+
+    time_t now = time(NULL);
+    for (uint32_t i = 0; i < head.count; i++) {
+        const status_record *job = &jobs[i];
+        char last[32] = "-", next[32] = "-", exit_code[16] = "-", duration[24] = "-";
+        int64_t next_fire = record_next_fire(job, &head, now);
+        if (next_fire >= 0) {
+            format_ms(next_fire * 1000, next, sizeof(next));
+        }
+        if (job->flags & STATUS_JOB_RAN) {
+            format_ms(job->last_start_ms, last, sizeof(last));
+            snprintf(exit_code, sizeof(exit_code), "%d", job->last_exit);
+            snprintf(duration, sizeof(duration), "%lu ms", (unsigned long)job->last_duration_ms);
+        }
+        printf("#%-5u %-8s %-16s %5s %11s  %-16s  %s\n", i, (job->flags & STATUS_JOB_RUNNING) ? "running" : "idle",
+               last, exit_code, duration, next, job->command);
+    }
+    free(jobs);
+    return 0;
+}
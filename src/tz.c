@@ -0,0 +1,234 @@
+#include "wcron/tz.h"
+#include <stddef.h>
+#include <string.h>
+
+#define TZ_SLOTS 4
+#define TZ_DAY 86400
+// A span is probed out from the instant that missed the cache in steps no two transitions fit in, up to this far
+#define TZ_PROBE_STEP (2 * TZ_DAY)
+#define TZ_PROBE_MAX (4 * TZ_DAY)
+
+// [start, end) shares one UTC offset
+typedef struct {
+    unsigned seq; // odd while the slot is written
+    time_t start;
+    time_t end;
+    long offset;
+    struct tm sample; // a conversion inside the span: isdst, and the zone name and offset where struct tm has them
+} tz_span;
+
+static tz_span spans[TZ_SLOTS];
+static unsigned next_slot;
+
+static const int DAYS_BEFORE_MONTH[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+
+static void system_localtime(time_t t, struct tm *out) {
+#ifdef _WIN32
+    localtime_s(out, &t);
+#else
+    localtime_r(&t, out);
+#endif
+}
+
+// Days since 1970-01-01 of a Gregorian date, mon 0-11
+static long days_from_civil(int year, int mon, int mday) {
+    year -= mon < 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long yoe = year - era * 400;
+    long doy = (153 * (mon + (mon > 1 ? -2 : 10)) + 2) / 5 + mday - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static long offset_of(time_t t, const struct tm *tm) {
+    time_t civil = (time_t)days_from_civil(tm->tm_year + 1900, tm->tm_mon, tm->tm_mday) * TZ_DAY +
+                   tm->tm_hour * 3600 + tm->tm_min * 60 + tm->tm_sec;
+    return (long)(civil - t);
+}
+
+static long system_offset(time_t t) {
+    struct tm tm;
+    system_localtime(t, &tm);
+    return offset_of(t, &tm);
+}
+
+// Smallest instant in (lo, hi] whose offset differs from lo's, given that hi's does
+static time_t find_change(time_t lo, time_t hi, long offset) {
+    while (hi - lo > 1) {
+        time_t mid = lo + (hi - lo) / 2;
+        if (system_offset(mid) == offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return hi;
+}
+
+// The fields before the sample, enough for offsets
+#define TZ_SPAN_BOUNDS offsetof(tz_span, sample)
+
+// Seqlock read of the first `size` bytes of the span holding t; 0 if no slot has it
+static int cached_span(time_t t, tz_span *copy, size_t size) {
+    for (int i = 0; i < TZ_SLOTS; i++) {
+        const tz_span *span = &spans[i];
+        unsigned seq = __atomic_load_n(&span->seq, __ATOMIC_ACQUIRE);
+        if ((seq & 1) || t < span->start || t >= span->end) {
+            continue;
+        }
+        memcpy(copy, span, size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&span->seq, __ATOMIC_RELAXED) == seq && t >= copy->start && t < copy->end) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Probe the span around t and cache it, unless another thread is writing the slot it would take
+static void load_span(time_t t, tz_span *span) {
+    system_localtime(t, &span->sample);
+    span->offset = offset_of(t, &span->sample);
+
+    span->start = t - TZ_PROBE_MAX;
+    for (time_t step = TZ_PROBE_STEP; step <= TZ_PROBE_MAX; step += TZ_PROBE_STEP) {
+        long offset = system_offset(t - step);
+        if (offset != span->offset) {
+            span->start = find_change(t - step, t - step + TZ_PROBE_STEP, offset);
+            break;
+        }
+    }
+
+    span->end = t + TZ_PROBE_MAX;
+    for (time_t step = TZ_PROBE_STEP; step <= TZ_PROBE_MAX; step += TZ_PROBE_STEP) {
+        if (system_offset(t + step) != span->offset) {
+            span->end = find_change(t + step - TZ_PROBE_STEP, t + step, span->offset);
+            break;
+        }
+    }
+
+    tz_span *slot = &spans[__atomic_fetch_add(&next_slot, 1, __ATOMIC_RELAXED) % TZ_SLOTS];
+    unsigned seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+    if ((seq & 1) || !__atomic_compare_exchange_n(&slot->seq, &seq, seq + 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->start = span->start;
+    slot->end = span->end;
+    slot->offset = span->offset;
+    slot->sample = span->sample;
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void get_span(time_t t, tz_span *span, size_t size) {
+    if (!cached_span(t, span, size)) {
+        load_span(t, span);
+    }
+}
+
+void tz_localtime(time_t t, struct tm *out) {
+    tz_span span;
+    get_span(t, &span, sizeof(span));
+
+    // Civil date from days since the epoch (Howard Hinnant's algorithm)
+    time_t civil = t + span.offset;
+    long days = (long)(civil >= 0 ? civil / TZ_DAY : (civil - TZ_DAY + 1) / TZ_DAY);
+    long seconds = (long)(civil - (time_t)days * TZ_DAY);
+
+    long z = days + 719468;
+    long era = (z >= 0 ? z : z - 146096) / 146097;
+    long doe = z - era * 146097;
+    long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long mp = (5 * doy + 2) / 153;
+    int mon = (int)(mp < 10 ? mp + 2 : mp - 10); // 0-11
+    int year = (int)(yoe + era * 400) + (mon < 2);
+    int leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+
+    *out = span.sample;
+    out->tm_year = year - 1900;
+    out->tm_mon = mon;
+    out->tm_mday = (int)(doy - (153 * mp + 2) / 5 + 1);
+    out->tm_hour = (int)(seconds / 3600);
+    out->tm_min = (int)(seconds / 60 % 60);
+    out->tm_sec = (int)(seconds % 60);
+    out->tm_wday = (int)((days % 7 + 11) % 7); // 1970-01-01 was a Thursday
+    out->tm_yday = DAYS_BEFORE_MONTH[mon] + out->tm_mday - 1 + (leap && mon > 1);
+}
+
+long tz_offset(time_t t) {
+    tz_span span;
+    get_span(t, &span, TZ_SPAN_BOUNDS);
+    return span.offset;
+}
+
+int tz_resolve(time_t civil, time_t when[2]) {
+    // Common case: read with the offset of a cached span, civil falls more than a day inside it, so no other offset
+    // reads civil too
+    for (int i = 0; i < TZ_SLOTS; i++) {
+        tz_span span;
+        const tz_span *slot = &spans[i];
+        unsigned seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            continue;
+        }
+        memcpy(&span, slot, TZ_SPAN_BOUNDS);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        time_t t = civil - span.offset;
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq && t - TZ_DAY >= span.start &&
+            t + TZ_DAY < span.end) {
+            when[0] = t;
+            return 1;
+        }
+    }
+
+    // The offsets in force a day either side; at most one transition lies between
+    long early = tz_offset(civil - TZ_DAY);
+    long late = tz_offset(civil + TZ_DAY);
+
+    int n = 0;
+    if (tz_offset(civil - early) == early) {
+        when[n++] = civil - early;
+    }
+    if (late != early && tz_offset(civil - late) == late) {
+        when[n++] = civil - late;
+    }
+    if (n == 2 && when[1] < when[0]) {
+        time_t t = when[0];
+        when[0] = when[1];
+        when[1] = t;
+    }
+
+    if (n == 0) {
+        // Spring forward: read with the old offset civil lies past the jump, with the new one before it
+        time_t lo = civil - late;
+        time_t hi = civil - early;
+        when[0] = tz_transition(lo, hi);
+        if (when[0] == (time_t)-1) {
+            when[0] = hi;
+        }
+    }
+    return n;
+}
+
+time_t tz_transition(time_t from, time_t to) {
+    tz_span span;
+    get_span(from, &span, TZ_SPAN_BOUNDS);
+    if (to < span.end) {
+        return (time_t)-1;
+    }
+
+    long offset = span.offset;
+    if (to <= from || tz_offset(to) == offset) {
+        return (time_t)-1;
+    }
+    while (to - from > 1) {
+        time_t mid = from + (to - from) / 2;
+        if (tz_offset(mid) == offset) {
+            from = mid;
+        } else {
+            to = mid;
+        }
+    }
+    return to;
+}